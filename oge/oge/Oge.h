@@ -62,11 +62,75 @@ typedef short i16;          // short
 typedef int i32;            // int
 typedef long i64;           //
 
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#   define OGE_THREAD_LOCAL __declspec(thread)
+#   define OGE_ATOMIC_EXCHANGE(ptr, value)  _InterlockedExchange((volatile long*)(ptr), (long)(value))
+#   define OGE_ATOMIC_INCREMENT(ptr)        _InterlockedIncrement((volatile long*)(ptr))
+#   define OGE_ATOMIC_INCREMENT64(ptr)      _InterlockedIncrement64((volatile long long*)(ptr))
+#   define OGE_ATOMIC_EXCHANGE_POINTER(ptr, value) _InterlockedExchangePointer((void* volatile*)(ptr), (void*)(value))
+#   define OGE_ATOMIC_COMPARE_EXCHANGE64(ptr, expected, desired) _InterlockedCompareExchange64((volatile long long*)(ptr), (desired), (expected))
+#   define OGE_ATOMIC_RELEASE(ptr)          _InterlockedExchange((volatile long*)(ptr), 0)
+#   define OGE_ATOMIC_LOAD(ptr)             (*(ptr)) // volatile reads are atomic with /volatile:ms
+#   define OGE_ATOMIC_LOAD_ACQUIRE(ptr)     (*(ptr)) // and acquire, the volatile writes release
+#   define OGE_ATOMIC_STORE_RELEASE(ptr, value) (*(ptr) = (value))
+#   define OGE_CPU_PAUSE()                  _mm_pause()
+#   define OGE_MEMORY_BARRIER()             _mm_mfence()
+#else
+#   define OGE_THREAD_LOCAL __thread
+#   define OGE_ATOMIC_EXCHANGE(ptr, value)  __sync_lock_test_and_set((ptr), (value))
+#   define OGE_ATOMIC_INCREMENT(ptr)        __sync_add_and_fetch((ptr), 1)
+#   define OGE_ATOMIC_INCREMENT64(ptr)      __sync_add_and_fetch((ptr), 1)
+#   define OGE_ATOMIC_EXCHANGE_POINTER(ptr, value) __sync_lock_test_and_set((ptr), (value))
+#   define OGE_ATOMIC_COMPARE_EXCHANGE64(ptr, expected, desired) __sync_val_compare_and_swap((ptr), (expected), (desired))
+#   define OGE_ATOMIC_RELEASE(ptr)          __sync_lock_release((ptr)) // stores 0 with a release barrier
+#   define OGE_ATOMIC_LOAD(ptr)             __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#   define OGE_ATOMIC_LOAD_ACQUIRE(ptr)     __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#   define OGE_ATOMIC_STORE_RELEASE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#   if defined(__x86_64__) || defined(__i386__)
+#       define OGE_CPU_PAUSE()              __builtin_ia32_pause()
+#   else
+#       define OGE_CPU_PAUSE()
+#   endif
+#   define OGE_MEMORY_BARRIER()             __sync_synchronize()
+#endif
+
+// Minimal spin lock for short critical sections. 0 = unlocked
+static inline void OgeSpinLock(volatile long* lock)
+{
+    while (OGE_ATOMIC_EXCHANGE(lock, 1) != 0) {
+        while (OGE_ATOMIC_LOAD(lock) != 0)
+            OGE_CPU_PAUSE();
+    }
+}
+
+// The writes of the critical section are visible before the lock is seen free.
+// (__sync_lock_test_and_set is only an acquire barrier so it can't be used here.)
+static inline void OgeSpinUnlock(volatile long* lock)
+{
+    OGE_ATOMIC_RELEASE(lock);
+}
+
 #define OGE_VERSION "0.1"
 #define OGE_FRAMERATE 16 // ms between frames
 #define OGE_HALF_FRAMERATE 8
 
-#define OGE_USE_LEAK_CHECK 1
+#ifndef OGE_USE_LEAK_CHECK
+#   define OGE_USE_LEAK_CHECK 1
+#endif
+
+// Capture the call stack of each tracked allocation (needs OGE_USE_LEAK_CHECK).
+// Compile with frame pointers: -fno-omit-frame-pointer (GCC/Clang) or /Oy- (MSVC x86).
+#ifndef OGE_USE_STACK_CAPTURE
+#   define OGE_USE_STACK_CAPTURE 0
+#endif
+
+// Sampling heap profiler (needs OGE_USE_LEAK_CHECK). 0 = track every allocation.
+// Otherwise on average one allocation per OGE_MEMORY_SAMPLE_RATE bytes allocated is tracked,
+// i.e. only the sampled allocations get a call site, a call stack and a log entry.
+#ifndef OGE_MEMORY_SAMPLE_RATE
+#   define OGE_MEMORY_SAMPLE_RATE 0 // for example (512 * 1024)
+#endif
 #define LOG_NORMAL
 
 // Forward delcarations of structs to avoid many #includes
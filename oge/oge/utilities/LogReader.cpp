@@ -0,0 +1,618 @@
+/*
+ *  OGE Open Game Engine
+ *  Copyright (c) 2023 Steven Gay (lazalong@gmail.com)
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "LogReader.h"
+#include <stdlib.h> // qsort
+#include <string.h>
+
+#if defined(_MSC_VER)
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   include <windows.h> // CreateFileMapping
+#else
+#   include <fcntl.h>    // open
+#   include <sys/mman.h> // mmap
+#   include <sys/stat.h> // fstat
+#   include <unistd.h>   // close
+#endif
+
+// 64 bits offsets: the logs get bigger than 2GB
+#ifdef _MSC_VER
+#   define OGE_FSEEK(file, offset, origin) _fseeki64(file, offset, origin)
+#   define OGE_FTELL(file) _ftelli64(file)
+#else
+#   define OGE_FSEEK(file, offset, origin) fseeko(file, offset, origin)
+#   define OGE_FTELL(file) ftello(file)
+#endif
+
+static const char _emptyLog[1] = { 0 };
+
+// Map a whole file read only. Return NULL if it can't be opened.
+// An empty file returns a valid pointer and a size of 0.
+const char* OgeLogMapFile(const char* filename, size_t* size) {
+    *size = 0;
+#if defined(_MSC_VER)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return NULL;
+    }
+    if (fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return _emptyLog;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return NULL;
+
+    // The view keeps the mapping alive
+    const char* data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL)
+        return NULL;
+
+    *size = (size_t)fileSize.QuadPart;
+    return data;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        return _emptyLog;
+    }
+
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+    *size = (size_t)info.st_size;
+    return (const char*)data;
+#endif
+}
+
+void OgeLogUnmapFile(const char* data, size_t size) {
+    if (data == NULL || data == _emptyLog)
+        return;
+#if defined(_MSC_VER)
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+inline bool OgeLogIsRecordStart(const char* data, size_t size, size_t offset) {
+    static const char start[] = "{\"type\":";
+    return size - offset >= sizeof(start) - 1 && memcmp(data + offset, start, sizeof(start) - 1) == 0;
+}
+
+// Offset of the first record starting at or after 'offset', or size if there is none.
+// A record starts at the beginning of a line with {"type":
+size_t OgeLogFindRecordStart(const char* data, size_t size, size_t offset) {
+    if (offset >= size)
+        return size;
+
+    // Go to the start of the next line unless offset already is one
+    if (offset > 0 && data[offset - 1] != '\n') {
+        const char* eol = (const char*)memchr(data + offset, '\n', size - offset);
+        if (eol == NULL)
+            return size;
+        offset = (size_t)(eol - data) + 1;
+    }
+
+    while (offset < size) {
+        if (OgeLogIsRecordStart(data, size, offset))
+            return offset;
+        const char* eol = (const char*)memchr(data + offset, '\n', size - offset);
+        if (eol == NULL)
+            return size;
+        offset = (size_t)(eol - data) + 1;
+    }
+    return size;
+}
+
+// Read the records starting in [begin, end[. The chunks [0, a[, [a, b[, [b, size[
+// give each record once, whatever a and b are.
+void OgeLogReaderInit(OgeLogReader* reader, const char* data, size_t size, size_t begin, size_t end) {
+    reader->data = data;
+    reader->size = size;
+    reader->end = end < size ? end : size;
+    reader->position = OgeLogFindRecordStart(data, size, begin);
+}
+
+OgeLogAction OgeLogParseAction(const char* text, u32 length) {
+    switch (length) {
+    case 3:
+        if (memcmp(text, "add", 3) == 0) return OGE_ACTION_ADD;
+        if (memcmp(text, "del", 3) == 0) return OGE_ACTION_DEL;
+        if (memcmp(text, "clr", 3) == 0) return OGE_ACTION_CLR;
+        if (memcmp(text, "rem", 3) == 0) return OGE_ACTION_REM;
+        if (memcmp(text, "err", 3) == 0) return OGE_ACTION_ERR;
+        break;
+    case 6:
+        if (memcmp(text, "commit", 6) == 0) return OGE_ACTION_COMMIT;
+        break;
+    case 8:
+        if (memcmp(text, "decommit", 8) == 0) return OGE_ACTION_DECOMMIT;
+        break;
+    }
+    return OGE_ACTION_UNKNOWN;
+}
+
+// The logger writes the addresses with %ld so they can be negative
+u64 OgeLogFieldU64(const OgeLogField* field) {
+    const char* c = field->text;
+    const char* end = c + field->length;
+    bool negative = false;
+    u64 value = 0;
+
+    while (c < end && *c == ' ')
+        c++;
+    if (c < end && *c == '-') {
+        negative = true;
+        c++;
+    }
+    while (c < end && *c >= '0' && *c <= '9')
+        value = value * 10 + (u64)(*c++ - '0');
+    return negative ? (u64)(-(i64)value) : value;
+}
+
+// Value of a "name":"value" pair. It ends at the first quote followed by ',' or '}'
+// so a text with quotes inside is still read.
+inline const char* OgeLogParseValue(const char* c, const char* end, OgeLogField* field) {
+    field->text = c;
+    while (c < end) {
+        if (*c == '"') {
+            const char* next = c + 1;
+            while (next < end && *next == ' ')
+                next++;
+            if (next >= end || *next == ',' || *next == '}')
+                break;
+        }
+        c++;
+    }
+    field->length = (u32)(c - field->text);
+    return c < end ? c + 1 : end;
+}
+
+bool OgeLogReadRecord(OgeLogReader* reader, OgeLogRecord* record) {
+    size_t start = reader->position;
+    if (start >= reader->end)
+        return false;
+
+    const char* data = reader->data;
+    const char* c = data + start;
+    const char* eol = (const char*)memchr(c, '\n', reader->size - start);
+    const char* end = eol != NULL ? eol : data + reader->size;
+
+    memset(record, 0, sizeof(OgeLogRecord));
+    record->offset = start;
+
+    // {"type":"mem","p1":"10", ...
+    c += 8;
+    while (c < end && *c != '"')
+        c++;
+    c = OgeLogParseValue(c + 1, end, &record->typeName);
+
+    while (c < end) {
+        // Next "pN":"
+        while (c < end && *c != '"')
+            c++;
+        if (end - c < 6 || c[1] != 'p')
+            break;
+        int index = 0;
+        const char* d = c + 2;
+        while (d < end && *d >= '0' && *d <= '9')
+            index = index * 10 + (*d++ - '0');
+        if (end - d < 3 || d[0] != '"' || d[1] != ':' || d[2] != '"')
+            break;
+
+        OgeLogField field;
+        c = OgeLogParseValue(d + 3, end, &field);
+        if (index >= 1 && index <= OGE_LOG_RECORD_FIELDS)
+            record->fields[index - 1] = field;
+    }
+
+    const OgeLogField* type = &record->typeName;
+    if (type->length == 3 && memcmp(type->text, "mem", 3) == 0)
+        record->type = OGE_RECORD_MEM;
+    else if (type->length == 3 && memcmp(type->text, "log", 3) == 0)
+        record->type = OGE_RECORD_LOG;
+    else
+        record->type = OGE_RECORD_OTHER;
+
+    record->frame = (u32)OgeLogFieldU64(&record->fields[0]);
+    if (record->type == OGE_RECORD_MEM) {
+        record->allocator = (u16)OgeLogFieldU64(&record->fields[1]);
+        record->action = OgeLogParseAction(record->fields[2].text, record->fields[2].length);
+        record->address = OgeLogFieldU64(&record->fields[3]);
+        record->size = OgeLogFieldU64(&record->fields[4]);
+        record->sequence = OgeLogFieldU64(&record->fields[6]);
+        record->thread = (u32)OgeLogFieldU64(&record->fields[7]);
+    }
+
+    reader->position = eol != NULL ? OgeLogFindRecordStart(data, reader->size, (size_t)(eol - data) + 1) : reader->size;
+    return true;
+}
+
+//--------------- Binary traces ---------------------
+
+// Load a binary trace or the mem records of a JSON log
+bool OgeTraceLoad(OgeTrace* trace, const char* filename) {
+    memset(trace, 0, sizeof(OgeTrace));
+
+    size_t size;
+    const char* data = OgeLogMapFile(filename, &size);
+    if (data == NULL)
+        return false;
+
+    const OgeTraceHeader* header = (const OgeTraceHeader*)data;
+    if (size >= sizeof(OgeTraceHeader) && memcmp(header->magic, OGE_TRACE_MAGIC, 8) == 0) {
+        size_t recordSize = header->recordSize;
+        if (header->version != OGE_TRACE_VERSION || recordSize < sizeof(OgeTraceRecord)
+            || header->count > (size - sizeof(OgeTraceHeader)) / recordSize) {
+            OgeLogUnmapFile(data, size);
+            return false;
+        }
+
+        if (!OgeArenaCreate(&trace->arena, (size_t)header->count * sizeof(OgeTraceRecord) + 1)) {
+            OgeLogUnmapFile(data, size);
+            return false;
+        }
+        trace->records = (OgeTraceRecord*)trace->arena.base;
+        OgeArenaSetUsed(&trace->arena, (size_t)header->count * sizeof(OgeTraceRecord));
+
+        const char* src = data + sizeof(OgeTraceHeader);
+        if (recordSize == sizeof(OgeTraceRecord))
+            memcpy(trace->records, src, (size_t)header->count * sizeof(OgeTraceRecord));
+        else {
+            for (u64 i = 0; i < header->count; i++)
+                memcpy(&trace->records[i], src + i * recordSize, sizeof(OgeTraceRecord));
+        }
+        trace->count = header->count;
+        OgeLogUnmapFile(data, size);
+        return true;
+    }
+
+    // A mem record is more than 32 bytes of JSON
+    if (!OgeArenaCreate(&trace->arena, (size / 32 + 1) * sizeof(OgeTraceRecord))) {
+        OgeLogUnmapFile(data, size);
+        return false;
+    }
+    trace->records = (OgeTraceRecord*)trace->arena.base;
+
+    OgeLogReader reader;
+    OgeLogRecord record;
+    OgeLogReaderInit(&reader, data, size, 0, size);
+    while (OgeLogReadRecord(&reader, &record)) {
+        if (record.type != OGE_RECORD_MEM)
+            continue;
+        OgeTraceRecord* r = (OgeTraceRecord*)OgeArenaPush(&trace->arena, sizeof(OgeTraceRecord), 8);
+        if (r == NULL)
+            break;
+        r->address = record.address;
+        r->size = record.size;
+        r->frame = record.frame;
+        r->allocator = record.allocator;
+        r->action = (u8)record.action;
+        r->reserved = 0;
+        trace->count++;
+    }
+
+    OgeLogUnmapFile(data, size);
+    return true;
+}
+
+bool OgeTraceSave(const OgeTrace* trace, const char* filename) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL)
+        return false;
+
+    OgeTraceHeader header;
+    memcpy(header.magic, OGE_TRACE_MAGIC, 8);
+    header.version = OGE_TRACE_VERSION;
+    header.recordSize = sizeof(OgeTraceRecord);
+    header.count = trace->count;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && trace->count > 0)
+        ok = fwrite(trace->records, sizeof(OgeTraceRecord), (size_t)trace->count, file) == (size_t)trace->count;
+    return fclose(file) == 0 && ok;
+}
+
+void OgeTraceFree(OgeTrace* trace) {
+    OgeArenaDestroy(&trace->arena);
+    trace->records = NULL;
+    trace->count = 0;
+}
+
+typedef struct OgeTraceKey OgeTraceKey;
+
+struct OgeTraceKey
+{
+    u64 address;
+    u64 index;
+};
+
+inline int OgeTraceKeyCompare(const void* a, const void* b)
+{
+    const OgeTraceKey* ka = (const OgeTraceKey*)a;
+    const OgeTraceKey* kb = (const OgeTraceKey*)b;
+    if (ka->address != kb->address)
+        return ka->address < kb->address ? -1 : 1;
+    return ka->index < kb->index ? -1 : (ka->index > kb->index ? 1 : 0);
+}
+
+// Sort the add/del records by address then order: a block is live if the last
+// record of its address is an add.
+OgeHeapSnapshot* OgeTraceSnapshot(const OgeTrace* trace, u32 frame) {
+    OgeHeapSnapshot* snapshot = (OgeHeapSnapshot*)malloc(sizeof(OgeHeapSnapshot));
+    if (snapshot == NULL)
+        return NULL;
+    memset(snapshot, 0, sizeof(OgeHeapSnapshot));
+
+    size_t count = 0;
+    for (u64 i = 0; i < trace->count; i++) {
+        const OgeTraceRecord* r = &trace->records[i];
+        if (r->frame <= frame && r->action <= OGE_ACTION_DEL)
+            count++;
+    }
+
+    OgeTraceKey* keys = (OgeTraceKey*)malloc(sizeof(OgeTraceKey) * (count > 0 ? count : 1));
+    if (keys == NULL) {
+        free(snapshot);
+        return NULL;
+    }
+    size_t n = 0;
+    for (u64 i = 0; i < trace->count; i++) {
+        const OgeTraceRecord* r = &trace->records[i];
+        if (r->frame <= frame && r->action <= OGE_ACTION_DEL) {
+            keys[n].address = r->address;
+            keys[n].index = i;
+            n++;
+        }
+    }
+    qsort(keys, count, sizeof(OgeTraceKey), OgeTraceKeyCompare);
+
+    size_t live = 0;
+    for (size_t i = 0; i < count; i++)
+        if ((i + 1 == count || keys[i + 1].address != keys[i].address) && trace->records[keys[i].index].action == OGE_ACTION_ADD)
+            live++;
+
+    snapshot->blocks = (OgeSnapshotBlock*)malloc(sizeof(OgeSnapshotBlock) * (live > 0 ? live : 1));
+    if (snapshot->blocks == NULL) {
+        free(keys);
+        free(snapshot);
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const OgeTraceRecord* r = &trace->records[keys[i].index];
+        if ((i + 1 < count && keys[i + 1].address == keys[i].address) || r->action != OGE_ACTION_ADD)
+            continue;
+        OgeSnapshotBlock* block = &snapshot->blocks[snapshot->count++];
+        block->address = r->address;
+        block->size = r->size;
+        block->site = 0;
+        block->allocator = r->allocator;
+        snapshot->bytes += (size_t)r->size;
+    }
+
+    free(keys);
+    return snapshot;
+}
+
+void OgeTraceSnapshotFree(OgeHeapSnapshot* snapshot) {
+    if (snapshot == NULL)
+        return;
+    free(snapshot->blocks);
+    free(snapshot);
+}
+
+//--------------- Sidecar index ---------------------
+
+bool OgeLogIndexLoad(OgeLogIndex* index, const char* logFilename) {
+    memset(index, 0, sizeof(OgeLogIndex));
+
+    char indexName[1024];
+    int length = snprintf(indexName, sizeof(indexName), "%s.idx", logFilename);
+    if (length <= 0 || length >= (int)sizeof(indexName))
+        return false;
+
+    size_t size;
+    const char* data = OgeLogMapFile(indexName, &size);
+    if (data == NULL)
+        return false;
+
+    const OgeLogIndexHeader* header = (const OgeLogIndexHeader*)data;
+    if (size < sizeof(OgeLogIndexHeader) || memcmp(header->magic, OGE_LOG_INDEX_MAGIC, 8) != 0
+        || header->version != OGE_LOG_INDEX_VERSION || header->entrySize != sizeof(OgeLogIndexEntry)) {
+        OgeLogUnmapFile(data, size);
+        return false;
+    }
+
+    // The last entry is incomplete if the game crashed while writing it
+    index->header = header;
+    index->entries = (const OgeLogIndexEntry*)(data + sizeof(OgeLogIndexHeader));
+    index->count = (size - sizeof(OgeLogIndexHeader)) / sizeof(OgeLogIndexEntry);
+    index->data = data;
+    index->size = size;
+    return true;
+}
+
+void OgeLogIndexFree(OgeLogIndex* index) {
+    if (index->data != NULL)
+        OgeLogUnmapFile(index->data, index->size);
+    memset(index, 0, sizeof(OgeLogIndex));
+}
+
+// First entry of the frame: the frame entry comes before the checkpoints of the frame
+const OgeLogIndexEntry* OgeLogIndexFindFrame(const OgeLogIndex* index, u32 frame) {
+    u64 low = 0;
+    u64 high = index->count;
+    while (low < high) {
+        u64 middle = low + (high - low) / 2;
+        if (index->entries[middle].frame < frame)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low < index->count ? &index->entries[low] : NULL;
+}
+
+const OgeLogIndexEntry* OgeLogIndexFindRecord(const OgeLogIndex* index, u64 record) {
+    // Entry 'record' is the state after 'record' records, i.e. before the record nb 'record'
+    u64 low = 0;
+    u64 high = index->count;
+    while (low < high) {
+        u64 middle = low + (high - low) / 2;
+        if (index->entries[middle].record <= record)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low > 0 ? &index->entries[low - 1] : NULL;
+}
+
+//--------------- Live logs ---------------------
+
+bool OgeLogTailOpen(OgeLogTail* tail, const char* filename, bool fromEnd) {
+    memset(tail, 0, sizeof(OgeLogTail));
+    tail->file = fopen(filename, "rb");
+    if (tail->file == NULL)
+        return false;
+    tail->buffer = (char*)malloc(OGE_LOG_TAIL_BUFFER);
+    if (tail->buffer == NULL) {
+        OgeLogTailClose(tail);
+        return false;
+    }
+
+    if (fromEnd && OGE_FSEEK(tail->file, 0, SEEK_END) == 0) {
+        long long size = (long long)OGE_FTELL(tail->file);
+        if (size > 0) {
+            // Inside a line: its start is already written, the rest is dropped
+            OGE_FSEEK(tail->file, size - 1, SEEK_SET);
+            tail->skipping = fgetc(tail->file) != '\n';
+            tail->bufferOffset = (u64)size;
+        }
+    }
+    return true;
+}
+
+void OgeLogTailClose(OgeLogTail* tail) {
+    if (tail->file != NULL)
+        fclose(tail->file);
+    if (tail->buffer != NULL)
+        free(tail->buffer);
+    tail->file = NULL;
+    tail->buffer = NULL;
+}
+
+// Read what was appended to the file after the buffer. False if there is nothing new.
+static bool OgeLogTailRead(OgeLogTail* tail) {
+    // The partial line goes to the start of the buffer
+    if (tail->begin > 0) {
+        memmove(tail->buffer, tail->buffer + tail->begin, tail->end - tail->begin);
+        tail->bufferOffset += tail->begin;
+        tail->end -= tail->begin;
+        tail->begin = 0;
+    }
+    if (tail->end == OGE_LOG_TAIL_BUFFER) {
+        tail->skippedLines++;
+        tail->skipping = true;
+        tail->bufferOffset += tail->end;
+        tail->end = 0;
+    }
+
+    size_t read = fread(tail->buffer + tail->end, 1, OGE_LOG_TAIL_BUFFER - tail->end, tail->file);
+    if (read > 0) {
+        tail->end += read;
+        return true;
+    }
+
+    // At the end of the file: the next fread gets what the logger writes meanwhile.
+    // A file shorter than what was read was truncated by OgeLogOpenFile(): read it again.
+    clearerr(tail->file);
+    u64 position = tail->bufferOffset + tail->end;
+    if (OGE_FSEEK(tail->file, 0, SEEK_END) == 0 && (u64)OGE_FTELL(tail->file) < position) {
+        OGE_FSEEK(tail->file, 0, SEEK_SET);
+        tail->bufferOffset = 0;
+        tail->begin = 0;
+        tail->end = 0;
+        tail->skipping = false;
+        tail->restartCount++;
+        return true;
+    }
+    OGE_FSEEK(tail->file, (long long)position, SEEK_SET);
+    return false;
+}
+
+bool OgeLogTailNext(OgeLogTail* tail, OgeLogRecord* record) {
+    if (tail->file == NULL)
+        return false;
+
+    for (;;) {
+        char* start = tail->buffer + tail->begin;
+        const char* eol = (const char*)memchr(start, '\n', tail->end - tail->begin);
+        if (eol == NULL) {
+            if (tail->skipping)
+                tail->begin = tail->end;
+            if (!OgeLogTailRead(tail))
+                return false;
+            continue;
+        }
+
+        size_t lineStart = tail->begin;
+        size_t lineEnd = (size_t)(eol - tail->buffer) + 1;
+        tail->begin = lineEnd;
+        if (tail->skipping) {
+            tail->skipping = false;
+            continue;
+        }
+
+        // The other lines (the {"log":[ of a JSON log...) aren't records
+        OgeLogReader reader;
+        OgeLogReaderInit(&reader, tail->buffer, lineEnd, lineStart, lineEnd);
+        if (OgeLogReadRecord(&reader, record)) {
+            record->offset += (size_t)tail->bufferOffset;
+            tail->recordCount++;
+            return true;
+        }
+    }
+}
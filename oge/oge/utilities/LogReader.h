@@ -0,0 +1,258 @@
+#ifndef __LOG_READER_H__
+#define __LOG_READER_H__
+
+/*
+ *  OGE Open Game Engine
+ *  Copyright (c) 2023 Steven Gay (lazalong@gmail.com)
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+/*
+  Reader of the JSON logs written by the OGE_LOGTYPE_JSON and OGE_LOGTYPE_NDJSON loggers,
+  and of the compact binary traces made from them.
+
+  A JSON log has one record per line:
+
+    {"type":"mem","p1":"10", "p2":"0", "p3":"add", "p4":"101084", "p5":"1000", "p6":"main.cpp:12", "p7":"57", "p8":"2" },
+
+  The mem records are written in the order of the events whatever the thread (p8), so a block
+  is added before it is deleted and deleted before its address is reused. p7 numbers the events
+  of each thread: a gap means the tracker dropped events (full event buffer).
+
+  The reader doesn't use a generic JSON parser: it jumps from record start to
+  record start, so a file can be cut in chunks at any offset and each chunk
+  parsed by a different thread (see OgeLogReaderInit).
+
+  Usage:
+
+    size_t size;
+    const char* data = OgeLogMapFile("heap.json", &size);
+    OgeLogReader reader;
+    OgeLogRecord record;
+    OgeLogReaderInit(&reader, data, size, 0, size);
+    while (OgeLogReadRecord(&reader, &record))
+        if (record.type == OGE_RECORD_MEM) ...
+    OgeLogUnmapFile(data, size);
+
+  The strings of a record point into the mapped file and are NOT 0 terminated.
+
+  When the logger wrote a sidecar index ("heap.json.idx", see OGE_LOG_INDEX_INTERVAL)
+  a frame can be read without the records before it:
+
+    OgeLogIndex index;
+    if (OgeLogIndexLoad(&index, "heap.json")) {
+        const OgeLogIndexEntry* first = OgeLogIndexFindFrame(&index, 600);
+        const OgeLogIndexEntry* next = OgeLogIndexFindFrame(&index, 601);
+        if (first != NULL)
+            OgeLogReaderInit(&reader, data, size, first->offset, next != NULL ? next->offset : size);
+        // first->liveBytes[allocator] are the live bytes before the frame
+        OgeLogIndexFree(&index);
+    }
+
+  A log still being written (OGE_LOGTYPE_NDJSON) is followed with a fixed buffer:
+
+    OgeLogTail tail;
+    if (OgeLogTailOpen(&tail, "heap.ndjson", false)) {
+        for (;;) {
+            while (OgeLogTailNext(&tail, &record))
+                ...
+            // sleep, the game flushes every OGE_LOG_FLUSH_MS or calls OgeLogFlush()
+        }
+        OgeLogTailClose(&tail);
+    }
+*/
+
+#include "../Oge.h"
+#include "Logger.h"
+#include "Memory.h"
+#include <stddef.h>
+
+enum OgeLogRecordType
+{
+    OGE_RECORD_NONE = 0,
+    OGE_RECORD_LOG,     // text message
+    OGE_RECORD_MEM,     // allocation event
+    OGE_RECORD_OTHER,   // any other "type", the fields are still parsed
+};
+
+typedef enum OgeLogRecordType OgeLogRecordType;
+
+// Action of a mem record. The first four match OgeAllocAction.
+enum OgeLogAction
+{
+    OGE_ACTION_ADD = 0,
+    OGE_ACTION_DEL,
+    OGE_ACTION_COMMIT,
+    OGE_ACTION_DECOMMIT,
+    OGE_ACTION_CLR,     // old viewer actions
+    OGE_ACTION_REM,
+    OGE_ACTION_ERR,
+    OGE_ACTION_UNKNOWN,
+};
+
+typedef enum OgeLogAction OgeLogAction;
+
+#define OGE_LOG_RECORD_FIELDS 8 // p1 to p8
+
+typedef struct OgeLogField OgeLogField;
+
+struct OgeLogField
+{
+    const char* text;   // NOT 0 terminated
+    u32 length;
+};
+
+typedef struct OgeLogRecord OgeLogRecord;
+
+struct OgeLogRecord
+{
+    OgeLogRecordType type;
+    OgeLogAction action;    // mem records only
+    u16 allocator;          // mem: p2
+    u32 frame;              // p1
+    u64 address;            // mem: p4
+    u64 size;               // mem: p5
+    u64 sequence;           // mem: p7, in its thread. 0 for the records of LOGA and the older logs
+    u32 thread;             // mem: p8
+    size_t offset;          // of the record in the buffer
+    OgeLogField typeName;
+    OgeLogField fields[OGE_LOG_RECORD_FIELDS]; // fields[0] is p1
+};
+
+typedef struct OgeLogReader OgeLogReader;
+
+struct OgeLogReader
+{
+    const char* data;
+    size_t size;
+    size_t position;
+    size_t end;         // records starting at or after end belong to the next chunk
+};
+
+extern const char* OgeLogMapFile(const char* filename, size_t* size);
+extern void  OgeLogUnmapFile(const char* data, size_t size);
+extern size_t OgeLogFindRecordStart(const char* data, size_t size, size_t offset);
+extern void  OgeLogReaderInit(OgeLogReader* reader, const char* data, size_t size, size_t begin, size_t end);
+extern bool  OgeLogReadRecord(OgeLogReader* reader, OgeLogRecord* record);
+extern OgeLogAction OgeLogParseAction(const char* text, u32 length);
+extern u64   OgeLogFieldU64(const OgeLogField* field);
+
+//--------------- Binary traces ---------------------
+
+// A trace is the list of the mem records of a log, 24 bytes each, after a 24 bytes header.
+// It loads without parsing and keeps the replays deterministic.
+
+#define OGE_TRACE_MAGIC "OGETRACE"
+#define OGE_TRACE_VERSION 1
+
+typedef struct OgeTraceHeader OgeTraceHeader;
+
+struct OgeTraceHeader
+{
+    char magic[8];
+    u32 version;
+    u32 recordSize;
+    u64 count;
+};
+
+typedef struct OgeTraceRecord OgeTraceRecord;
+
+struct OgeTraceRecord
+{
+    u64 address;
+    u64 size;
+    u32 frame;
+    u16 allocator;
+    u8  action;         // OgeLogAction
+    u8  reserved;
+};
+
+typedef struct OgeTrace OgeTrace;
+
+// The records are in a virtual arena so a big log doesn't need to be counted first.
+struct OgeTrace
+{
+    OgeTraceRecord* records;
+    u64 count;
+    OgeVirtualArena arena;
+};
+
+extern bool  OgeTraceLoad(OgeTrace* trace, const char* filename);
+extern bool  OgeTraceSave(const OgeTrace* trace, const char* filename);
+extern void  OgeTraceFree(OgeTrace* trace);
+
+// Blocks live at the end of 'frame' (0xFFFFFFFF: end of the trace), sorted by address,
+// for OgeFragmentationCompute(). The sites are 0. Free it with OgeTraceSnapshotFree().
+extern OgeHeapSnapshot* OgeTraceSnapshot(const OgeTrace* trace, u32 frame);
+extern void  OgeTraceSnapshotFree(OgeHeapSnapshot* snapshot);
+
+//--------------- Sidecar index ---------------------
+
+// "<log>.idx" written by the logger. The entries are sorted by frame and by record.
+
+typedef struct OgeLogIndex OgeLogIndex;
+
+struct OgeLogIndex
+{
+    const OgeLogIndexHeader* header;
+    const OgeLogIndexEntry* entries;
+    u64 count;
+    const char* data;   // mapped file
+    size_t size;
+};
+
+// False if the index doesn't exist or has another version
+extern bool  OgeLogIndexLoad(OgeLogIndex* index, const char* logFilename);
+extern void  OgeLogIndexFree(OgeLogIndex* index);
+// Entry of the start of 'frame'. NULL after the last frame.
+extern const OgeLogIndexEntry* OgeLogIndexFindFrame(const OgeLogIndex* index, u32 frame);
+// Last entry at or before the record nb 'record' (counted from 0): the checkpoint to replay from
+extern const OgeLogIndexEntry* OgeLogIndexFindRecord(const OgeLogIndex* index, u64 record);
+
+//--------------- Live logs ---------------------
+
+// A tail reads the lines appended to a log since the last call, with the memory of its buffer
+// whatever the size of the log. A partial line at the end of the file waits for its end.
+
+#define OGE_LOG_TAIL_BUFFER (256 * 1024) // longer lines are skipped
+
+typedef struct OgeLogTail OgeLogTail;
+
+struct OgeLogTail
+{
+    FILE* file;
+    char* buffer;           // OGE_LOG_TAIL_BUFFER bytes
+    size_t begin;           // next line in the buffer
+    size_t end;             // bytes read in the buffer
+    u64 bufferOffset;       // file offset of buffer[0]
+    u64 recordCount;        // records returned
+    u64 skippedLines;       // lines longer than the buffer
+    u32 restartCount;       // the file got shorter: the logger opened it again
+    bool skipping;          // dropping the rest of a line
+};
+
+// fromEnd: only the lines written after the call are read
+extern bool  OgeLogTailOpen(OgeLogTail* tail, const char* filename, bool fromEnd);
+// Next complete record. False when there is nothing new for now: call it again later.
+// The strings of the record point into the buffer and are valid until the next call.
+extern bool  OgeLogTailNext(OgeLogTail* tail, OgeLogRecord* record);
+extern void  OgeLogTailClose(OgeLogTail* tail);
+
+#endif // __LOG_READER_H__
@@ -22,10 +22,23 @@
  */
 
 #include "Logger.h"
+#define OGE_MEMORY_IMPLEMENTATION // the allocator is compiled with the logger
 #include "Memory.h"
 #include <string.h>
 #include <time.h>
 
+#if defined(_MSC_VER)
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   include <windows.h> // CreateFileMapping
+#else
+#   include <fcntl.h>    // O_CREAT
+#   include <sys/mman.h> // shm_open, mmap
+#   include <sys/stat.h>
+#   include <unistd.h>   // ftruncate, getpid
+#endif
+
 #ifdef _MSC_VER
 #   pragma warning(push)
 //#   pragma warning(disable:4668) // '__cplusplus' is not defined as preprocessor macro, replacing with '0' for '#if/#elif'
@@ -33,6 +46,33 @@
 #   pragma warning(disable:26812) // C26812	The enum type 'OgeLogType' is unscoped. Prefer 'enum class' over 'enum'
 #endif
 
+// 64 bits offsets: the logs get bigger than 2GB
+#ifdef _MSC_VER
+#   define OGE_FTELL(file) _ftelli64(file)
+#else
+#   define OGE_FTELL(file) ftello(file)
+#endif
+
+// Milliseconds of a monotonic clock
+static u64 OgeLogMilliseconds() {
+#if defined(_MSC_VER)
+    return (u64)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000 + (u64)ts.tv_nsec / 1000000;
+#endif
+}
+
+// Flush of the NDJSON log once OGE_LOG_FLUSH_MS have passed since the last one.
+// Only the thread winning the exchange of flushTime flushes, the others go on writing.
+inline void OgeLogFlushCheck() {
+    long long now = (long long)OgeLogMilliseconds();
+    long long last = OGE_ATOMIC_LOAD(&_ogeLogger->flushTime);
+    if (now - last >= OGE_LOG_FLUSH_MS && OGE_ATOMIC_COMPARE_EXCHANGE64(&_ogeLogger->flushTime, last, now) == last)
+        fflush(_ogeLogger->logFile);
+}
+
 void* OgeCreateLogger(const char* filename, OgeLogType type, long maxLogCount, bool showOnConsole) {
     if (_ogeLogger != NULL) {
         printf("\nWARNING: Log Manager already created!\n");
@@ -50,6 +90,7 @@ void* OgeCreateLogger(const char* filename, OgeLogType type, long maxLogCount, b
 
     logger->logType = type;
     logger->logFile = NULL;
+    logger->indexFile = NULL;
     logger->logCount = 0;
     logger->maxLogCount = maxLogCount;
     logger->showOnConsole = showOnConsole;
@@ -57,15 +98,24 @@ void* OgeCreateLogger(const char* filename, OgeLogType type, long maxLogCount, b
 
     // Set the methods
     switch ((OgeLogType)type) {
+    case OGE_LOGTYPE_NDJSON:
+        _ogeLogger->Log = &OgeLogNDJSON;
+        _ogeLogger->LogAlloc = &OgeLogAllocNDJSON;
+        _ogeLogger->LogSummary = &OgeLogSummaryNDJSON;
+        _ogeLogger->LogHeader = &OgeLogHeaderNDJSON;
+        _ogeLogger->LogFooter = &OgeLogFooterNDJSON;
+        break;
     case OGE_LOGTYPE_JSON:
         _ogeLogger->Log = &OgeLogJSON;
         _ogeLogger->LogAlloc = &OgeLogAllocJSON;
+        _ogeLogger->LogSummary = &OgeLogSummaryJSON;
         _ogeLogger->LogHeader = &OgeLogHeaderJSON;
         _ogeLogger->LogFooter = &OgeLogFooterJSON;
         break;
     case OGE_LOGTYPE_HTML:
         _ogeLogger->Log = &OgeLogHTML;
         _ogeLogger->LogAlloc = &OgeLogAllocHTML;
+        _ogeLogger->LogSummary = &OgeLogSummaryHTML;
         _ogeLogger->LogHeader = &OgeLogHeaderHTML;
         _ogeLogger->LogFooter = &OgeLogFooterHTML;
         break;
@@ -73,6 +123,7 @@ void* OgeCreateLogger(const char* filename, OgeLogType type, long maxLogCount, b
     default:
         _ogeLogger->Log = &OgeLogText;
         _ogeLogger->LogAlloc = &OgeLogAllocText;
+        _ogeLogger->LogSummary = &OgeLogSummaryText;
         _ogeLogger->LogHeader = &OgeLogHeaderText;
         _ogeLogger->LogFooter = &OgeLogFooterText;
         break;
@@ -83,21 +134,82 @@ void* OgeCreateLogger(const char* filename, OgeLogType type, long maxLogCount, b
     return logger;
 }
 
-inline
-void OgeLogMessage(int level, const char* text, const char* file, int line) {
-    if (_ogeLogger->logCount >= _ogeLogger->maxLogCount) {
-        if (_ogeLogger->logCount == _ogeLogger->maxLogCount)
+// Index entry every OGE_LOG_INDEX_INTERVAL records
+inline void OgeLogCheckpoint() {
+#if OGE_LOG_INDEX_INTERVAL > 0
+    if (_ogeLogger->logCount % OGE_LOG_INDEX_INTERVAL == 0)
+        OgeLogWriteIndex(OGE_LOG_INDEX_CHECKPOINT);
+#endif
+}
+
+// True when maxLogCount is reached: the record is counted as dropped
+inline bool OgeLogLimitReached() {
+    if (_ogeLogger->logCount < _ogeLogger->maxLogCount)
+        return false;
+
+    if (_ogeLogger->logCount == _ogeLogger->maxLogCount) {
+        if (_ogeLogger->logType == OGE_LOGTYPE_NDJSON)
+            fprintf(_ogeLogger->logFile, "{\"type\":\"stop\",\"p1\":\"%lu\",\"p2\":\"Too many lines logged\"}\n", _ogeLogger->updateCount);
+        else
             fprintf(_ogeLogger->logFile, "ogeLogger: Logging stopped. Too many lines logged. <br>\n");
-        return;
     }
+    _ogeLogger->droppedRecords++;
+    return true;
+}
+
+void OgeLogMessage(int level, const char* text, const char* file, int line) {
+    if (OgeLogLimitReached())
+        return;
+    if (level >= OGE_LOG_ERROR && level <= OGE_LOG_VERBOSE)
+        _ogeLogger->levelRecords[level]++;
     _ogeLogger->logCount++;
     _ogeLogger->Log(level, text, file, line);
+    OgeLogCheckpoint();
 }
 
-inline
 void OgeLogAlloc(int allocator, const char* action, long address, long size, const char* file, int line) {
+    OgeLogAllocEvent(allocator, action, address, size, file, line, 0, 0);
+}
+
+void OgeLogAllocEvent(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread) {
+    bool isAdd = strcmp(action, "add") == 0;
+    bool isDel = strcmp(action, "del") == 0 || strcmp(action, "rem") == 0;
+    long long delta = 0;
+    if (isAdd || strcmp(action, "commit") == 0)
+        delta = size;
+    else if (isDel || strcmp(action, "decommit") == 0)
+        delta = -(long long)size;
+
+    // Live bytes of the index entries
+    if (allocator >= 0 && allocator < OGE_LOG_INDEX_ALLOCATORS)
+        _ogeLogger->liveBytes[allocator] += delta;
+
+    // Frame summary: the commits count in the live bytes, not as allocations
+    if (isAdd) {
+        _ogeLogger->frameAllocCount++;
+        _ogeLogger->frameAllocBytes += (u64)size;
+    }
+    else if (isDel) {
+        _ogeLogger->frameFreeCount++;
+        _ogeLogger->frameFreeBytes += (u64)size;
+    }
+    _ogeLogger->liveTotal += delta;
+    if (_ogeLogger->liveTotal > _ogeLogger->framePeakBytes)
+        _ogeLogger->framePeakBytes = _ogeLogger->liveTotal;
+
+    _ogeLogger->levelRecords[OGE_LOG_ALLOC]++;
+    _ogeLogger->logCount++;
+    _ogeLogger->LogAlloc(allocator, action, address, size, file, line, sequence, thread);
+    OgeLogCheckpoint();
+}
+
+void OgeLogSummary(const char* type, const char* const* values, int count) {
+    if (OgeLogLimitReached())
+        return;
+    _ogeLogger->levelRecords[OGE_TELEMETRY_SUMMARY]++;
     _ogeLogger->logCount++;
-    _ogeLogger->LogAlloc(allocator, action, address, size, file, line);
+    _ogeLogger->LogSummary(type, values, count);
+    OgeLogCheckpoint();
 }
 
 void  OgeLogMessageTest(bool test, int level, const char* text, const char* file, int line) {
@@ -108,14 +220,25 @@ void  OgeLogMessageTest(bool test, int level, const char* text, const char* file
 // Log frame & time
 // TODO break down in OgeLogUpdateText() etc
 void  OgeLogUpdate(float deltaTime, int frame) {
+    // Allocation events and allocator counters of the frame ending now
+    OgeMemoryFlushEvents();
+    OgeMemoryAllocatorFrame();
+    OgeTelemetryPublish(deltaTime, frame);
+    OgeMetricsFrame();
+
     if (_ogeLogger == 0)
         return;
 
+    OgeMemoryFragmentationFrame(_ogeLogger->updateCount);
+    OgeLogFrameSummary(deltaTime);
     _ogeLogger->updateCount++;
+    OgeLogWriteIndex(OGE_LOG_INDEX_FRAME);
+    if (_ogeLogger->logType == OGE_LOGTYPE_NDJSON)
+        OgeLogFlushCheck(); // the last records of a quiet frame
 
     // If too many lines logged
     if (_ogeLogger->logCount < _ogeLogger->maxLogCount) {
-        // Log frame time
+        // The frame record has the frame time, the HTML log also gets a separator
         if (_ogeLogger->logType == OGE_LOGTYPE_HTML)
         {
             fprintf(_ogeLogger->logFile, "<font style=\"FONT-FAMILY: \'Courier New\'\" size=2>\n");
@@ -123,13 +246,6 @@ void  OgeLogUpdate(float deltaTime, int frame) {
             fprintf(_ogeLogger->logFile, "Update: %d - DeltaTime: %f ms<br></font>\n", frame, deltaTime);
 
         }
-        else if (_ogeLogger->logType == OGE_LOGTYPE_JSON) {
-
-        }
-        else {
-            fprintf(_ogeLogger->logFile, "maxLogCount reached:  Too many lines logged...");
-            fprintf(_ogeLogger->logFile, "\n");
-        }
     }
     else if (_ogeLogger->logCount == _ogeLogger->maxLogCount) {
         if (_ogeLogger->logType == OGE_LOGTYPE_HTML) {
@@ -137,7 +253,7 @@ void  OgeLogUpdate(float deltaTime, int frame) {
             fprintf(_ogeLogger->logFile, "Max log count reached: stop logging...<br></font>\n");
 
         }
-        else if (_ogeLogger->logType == OGE_LOGTYPE_JSON) {
+        else if (_ogeLogger->logType == OGE_LOGTYPE_JSON || _ogeLogger->logType == OGE_LOGTYPE_NDJSON) {
 
         }
         else {
@@ -166,18 +282,573 @@ void  OgeLogOpenFile(const char* filename) {
     _ogeLogger->logFile = logfile;
 
     _ogeLogger->LogHeader();
+
+#if OGE_LOG_INDEX_INTERVAL > 0
+    // The offsets and live bytes are those of this file
+    memset(_ogeLogger->liveBytes, 0, sizeof(_ogeLogger->liveBytes));
+    _ogeLogger->liveTotal = 0;
+    _ogeLogger->framePeakBytes = 0;
+
+    char indexName[1024];
+    int length = snprintf(indexName, sizeof(indexName), "%s.idx", strlen(filename) == 0 ? "OgeLogFile" : filename);
+    bool device = strncmp(filename, "/dev/", 5) == 0; // no index for /dev/null
+    if (logfile != NULL && !device && length > 0 && length < (int)sizeof(indexName))
+        _ogeLogger->indexFile = fopen(indexName, "wb");
+
+    if (_ogeLogger->indexFile != NULL) {
+        OgeLogIndexHeader header;
+        memcpy(header.magic, OGE_LOG_INDEX_MAGIC, 8);
+        header.version = OGE_LOG_INDEX_VERSION;
+        header.entrySize = sizeof(OgeLogIndexEntry);
+        header.interval = OGE_LOG_INDEX_INTERVAL;
+        header.allocatorCount = OGE_LOG_INDEX_ALLOCATORS;
+        fwrite(&header, sizeof(header), 1, _ogeLogger->indexFile);
+
+        OgeLogWriteIndex(OGE_LOG_INDEX_FRAME);
+    }
+#endif
+}
+
+// The entries are written as they come so the index of a crashed game is still usable
+void OgeLogWriteIndex(OgeLogIndexKind kind) {
+    if (_ogeLogger->indexFile == NULL || _ogeLogger->logFile == NULL)
+        return;
+
+    OgeLogIndexEntry entry;
+    entry.offset = (u64)OGE_FTELL(_ogeLogger->logFile);
+    entry.record = _ogeLogger->logCount;
+    entry.frame = (u32)_ogeLogger->updateCount;
+    entry.kind = (u16)kind;
+    entry.reserved = 0;
+    memcpy(entry.liveBytes, _ogeLogger->liveBytes, sizeof(entry.liveBytes));
+    fwrite(&entry, sizeof(entry), 1, _ogeLogger->indexFile);
+}
+
+//--------------- Frame summaries ---------------------
+
+// Record of the frame ending, then the counters restart for the next frame
+void OgeLogFrameSummary(float deltaTime) {
+    OgeLogger* logger = _ogeLogger;
+    OgeFrameHistogramRecord(&logger->frameTimes, deltaTime > 0.0f ? (u64)((double)deltaTime * 1000.0 + 0.5) : 0);
+
+#if OGE_LOG_FRAME_SUMMARY
+    char text[14][32];
+    const char* values[14];
+    int count = 0;
+    snprintf(text[count++], 32, "%.3f", deltaTime);
+    snprintf(text[count++], 32, "%llu", (unsigned long long)logger->frameAllocCount);
+    snprintf(text[count++], 32, "%llu", (unsigned long long)logger->frameFreeCount);
+    snprintf(text[count++], 32, "%llu", (unsigned long long)logger->frameAllocBytes);
+    snprintf(text[count++], 32, "%llu", (unsigned long long)logger->frameFreeBytes);
+    snprintf(text[count++], 32, "%lld", logger->framePeakBytes);
+    snprintf(text[count++], 32, "%lld", logger->liveTotal);
+    for (int level = OGE_LOG_ERROR; level <= OGE_LOG_VERBOSE; level++)
+        snprintf(text[count++], 32, "%llu", (unsigned long long)(logger->levelRecords[level] - logger->frameLevelStart[level]));
+    for (int i = 0; i < count; i++)
+        values[i] = text[i];
+    if (logger->logFile != NULL)
+        OgeLogSummary("frame", values, count);
+#endif
+
+    logger->frameAllocCount = 0;
+    logger->frameFreeCount = 0;
+    logger->frameAllocBytes = 0;
+    logger->frameFreeBytes = 0;
+    logger->framePeakBytes = logger->liveTotal;
+    memcpy(logger->frameLevelStart, logger->levelRecords, sizeof(logger->frameLevelStart));
+}
+
+// frametime: frames, mean, min, p50, p90, p99, p99.9, max in ms
+void OgeLogFrameTimeSummary() {
+    const OgeFrameHistogram* histogram = &_ogeLogger->frameTimes;
+    if (histogram->count == 0)
+        return;
+
+    double ms[8];
+    ms[0] = (double)histogram->count;
+    ms[1] = histogram->sum / (double)histogram->count / 1000.0;
+    ms[2] = (double)histogram->min / 1000.0;
+    ms[3] = (double)OgeFrameHistogramPercentile(histogram, 50.0) / 1000.0;
+    ms[4] = (double)OgeFrameHistogramPercentile(histogram, 90.0) / 1000.0;
+    ms[5] = (double)OgeFrameHistogramPercentile(histogram, 99.0) / 1000.0;
+    ms[6] = (double)OgeFrameHistogramPercentile(histogram, 99.9) / 1000.0;
+    ms[7] = (double)histogram->max / 1000.0;
+
+    char text[8][32];
+    const char* values[8];
+    for (int i = 0; i < 8; i++) {
+        snprintf(text[i], sizeof(text[i]), i == 0 ? "%.0f" : "%.3f", ms[i]);
+        values[i] = text[i];
+    }
+    OgeLogSummary("frametime", values, 8);
+
+    if (_ogeLogger->showOnConsole)
+        printf("Frame times: %s frames, mean %s ms, min %s, p50 %s, p90 %s, p99 %s, p99.9 %s, max %s\n",
+            values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]);
+}
+
+// Values below 2 * SUB_BUCKETS have their own bucket. Above, the value has its highest bit at
+// 'shift' + log2(SUB_BUCKETS) and keeps SUB_BUCKETS steps of 1 << shift.
+inline u32 OgeFrameHistogramIndex(u64 value) {
+    if (value < 2 * OGE_FRAME_HISTOGRAM_SUB_BUCKETS)
+        return (u32)value;
+    u32 shift = 0;
+    while ((value >> shift) >= 2 * OGE_FRAME_HISTOGRAM_SUB_BUCKETS)
+        shift++;
+    if (shift > OGE_FRAME_HISTOGRAM_POWERS)
+        return OGE_FRAME_HISTOGRAM_SIZE - 1;
+    return shift * OGE_FRAME_HISTOGRAM_SUB_BUCKETS + (u32)(value >> shift);
+}
+
+// Highest value of a bucket
+inline u64 OgeFrameHistogramValue(u32 index) {
+    if (index < 2 * OGE_FRAME_HISTOGRAM_SUB_BUCKETS)
+        return index;
+    u32 shift = index / OGE_FRAME_HISTOGRAM_SUB_BUCKETS - 1;
+    u64 sub = index - shift * OGE_FRAME_HISTOGRAM_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void OgeFrameHistogramRecord(OgeFrameHistogram* histogram, u64 value) {
+    histogram->counts[OgeFrameHistogramIndex(value)]++;
+    if (histogram->count == 0 || value < histogram->min)
+        histogram->min = value;
+    if (value > histogram->max)
+        histogram->max = value;
+    histogram->count++;
+    histogram->sum += (double)value;
+}
+
+u64 OgeFrameHistogramPercentile(const OgeFrameHistogram* histogram, double percentile) {
+    if (histogram->count == 0)
+        return 0;
+    u64 rank = (u64)(percentile / 100.0 * (double)histogram->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    u64 seen = 0;
+    for (u32 i = 0; i < OGE_FRAME_HISTOGRAM_SIZE; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            u64 value = OgeFrameHistogramValue(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+// For the programs without frames: call it from a timer or a thread, see OGE_LOG_FLUSH_MS
+void  OgeLogFlush() {
+    OgeMemoryFlushEvents();
+    if (_ogeLogger == NULL || _ogeLogger->logFile == NULL)
+        return;
+
+    fflush(_ogeLogger->logFile);
+    OGE_ATOMIC_STORE_RELEASE(&_ogeLogger->flushTime, (long long)OgeLogMilliseconds());
 }
 
 // Close and free
 void  OgeLogCloseFile() {
     if (_ogeLogger != NULL && _ogeLogger->logFile != NULL) {
+        OgeMemoryFlushEvents();
+        OgeLogFrameTimeSummary();
+
         _ogeLogger->LogFooter();
 
         fclose(_ogeLogger->logFile);
         _ogeLogger->logFile = 0;
     }
+    if (_ogeLogger != NULL && _ogeLogger->indexFile != NULL) {
+        fclose(_ogeLogger->indexFile);
+        _ogeLogger->indexFile = NULL;
+    }
 
-    free(_ogeLogger);
+    // The allocator stops logging before the logger memory is freed
+    OgeLogger* logger = _ogeLogger;
+    _ogeLogger = NULL;
+    free(logger);
+}
+
+//--------------- Live telemetry ---------------------
+
+static OgeTelemetryBlock* _ogeTelemetry = NULL;
+static char _ogeTelemetryName[256];
+#if defined(_MSC_VER)
+static HANDLE _ogeTelemetryMapping = NULL;
+#endif
+
+bool OgeTelemetryOpen(const char* name) {
+    if (_ogeTelemetry != NULL)
+        OgeTelemetryClose();
+    if (name == NULL || strlen(name) == 0)
+        name = OGE_TELEMETRY_NAME;
+    if (strlen(name) >= sizeof(_ogeTelemetryName))
+        return false;
+
+    OgeTelemetryBlock* block = NULL;
+#if defined(_MSC_VER)
+    _ogeTelemetryMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)sizeof(OgeTelemetryBlock), name);
+    if (_ogeTelemetryMapping == NULL)
+        return false;
+    block = (OgeTelemetryBlock*)MapViewOfFile(_ogeTelemetryMapping, FILE_MAP_WRITE, 0, 0, sizeof(OgeTelemetryBlock));
+    if (block == NULL) {
+        CloseHandle(_ogeTelemetryMapping);
+        _ogeTelemetryMapping = NULL;
+        return false;
+    }
+#else
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, sizeof(OgeTelemetryBlock)) == 0)
+        block = (OgeTelemetryBlock*)mmap(NULL, sizeof(OgeTelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (block == NULL || block == (OgeTelemetryBlock*)MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+#endif
+
+    // The block of a previous run is reset: the sequence stays even
+    block->sequence = 0;
+    memset(&block->stats, 0, sizeof(block->stats));
+    block->version = OGE_TELEMETRY_VERSION;
+    block->size = sizeof(OgeTelemetryBlock);
+#if defined(_MSC_VER)
+    block->processId = (u32)GetCurrentProcessId();
+#else
+    block->processId = (u32)getpid();
+#endif
+    OGE_MEMORY_BARRIER();
+    memcpy(block->magic, OGE_TELEMETRY_MAGIC, 8); // last: a monitor only reads a filled block
+
+    strcpy(_ogeTelemetryName, name);
+    _ogeTelemetry = block;
+    return true;
+}
+
+// The monitors still attached keep their mapping, a new monitor won't find the block
+void OgeTelemetryClose() {
+    if (_ogeTelemetry == NULL)
+        return;
+#if defined(_MSC_VER)
+    UnmapViewOfFile(_ogeTelemetry);
+    CloseHandle(_ogeTelemetryMapping);
+    _ogeTelemetryMapping = NULL;
+#else
+    munmap(_ogeTelemetry, sizeof(OgeTelemetryBlock));
+    shm_unlink(_ogeTelemetryName);
+#endif
+    _ogeTelemetry = NULL;
+}
+
+// Called by OgeLogUpdate(). One writer: the thread ending the frames.
+void OgeTelemetryPublish(float deltaTime, int frame) {
+    OgeTelemetryBlock* block = _ogeTelemetry;
+    if (block == NULL)
+        return;
+
+    // Filled outside of the sequence lock so the readers rarely retry
+    OgeTelemetryStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.publishCount = block->stats.publishCount + 1;
+    stats.frame = (u64)(frame >= 0 ? frame : 0);
+    stats.deltaTime = deltaTime;
+    if (_ogeLogger != NULL) {
+        stats.logRecords = _ogeLogger->logCount;
+        stats.droppedRecords = _ogeLogger->droppedRecords;
+        memcpy(stats.levelRecords, _ogeLogger->levelRecords, sizeof(stats.levelRecords));
+    }
+    for (u16 i = 0; i < OGE_TELEMETRY_ALLOCATORS && i < OGE_MEMORY_MAX_ALLOCATORS; i++) {
+        OgeAllocatorStats allocator;
+        if (!OgeMemoryGetAllocatorStats(i, &allocator)) // no tracking without OGE_USE_LEAK_CHECK
+            break;
+        if (allocator.totalCount == 0 && allocator.name == NULL)
+            continue;
+        OgeTelemetryAllocator* entry = &stats.allocators[i];
+        if (allocator.name != NULL)
+            strncpy(entry->name, allocator.name, sizeof(entry->name) - 1);
+        entry->liveBytes = allocator.liveBytes;
+        entry->liveCount = allocator.liveCount;
+        entry->peakBytes = allocator.peakBytes;
+        entry->frameCount = allocator.frameCount;
+        entry->totalCount = allocator.totalCount;
+        entry->budget = allocator.budget;
+        stats.allocatorCount = i + 1;
+    }
+
+    block->sequence++;
+    OGE_MEMORY_BARRIER();
+    memcpy(&block->stats, &stats, sizeof(stats));
+    OGE_MEMORY_BARRIER();
+    block->sequence++;
+}
+
+const OgeTelemetryBlock* OgeTelemetryAttach(const char* name) {
+    if (name == NULL || strlen(name) == 0)
+        name = OGE_TELEMETRY_NAME;
+
+    const OgeTelemetryBlock* block = NULL;
+#if defined(_MSC_VER)
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (mapping == NULL)
+        return NULL;
+    block = (const OgeTelemetryBlock*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(OgeTelemetryBlock));
+    CloseHandle(mapping); // the view keeps the mapping
+    if (block == NULL)
+        return NULL;
+#else
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(OgeTelemetryBlock))
+        block = (const OgeTelemetryBlock*)mmap(NULL, sizeof(OgeTelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (block == NULL || block == (const OgeTelemetryBlock*)MAP_FAILED)
+        return NULL;
+#endif
+
+    if (memcmp(block->magic, OGE_TELEMETRY_MAGIC, 8) != 0 || block->version != OGE_TELEMETRY_VERSION
+        || block->size != sizeof(OgeTelemetryBlock)) {
+        OgeTelemetryDetach(block);
+        return NULL;
+    }
+    return block;
+}
+
+void OgeTelemetryDetach(const OgeTelemetryBlock* block) {
+    if (block == NULL)
+        return;
+#if defined(_MSC_VER)
+    UnmapViewOfFile(block);
+#else
+    munmap((void*)block, sizeof(OgeTelemetryBlock));
+#endif
+}
+
+bool OgeTelemetryRead(const OgeTelemetryBlock* block, OgeTelemetryStats* stats) {
+    for (int retry = 0; retry < 10000; retry++) {
+        u32 sequence = block->sequence;
+        if (sequence & 1) {
+            OGE_CPU_PAUSE();
+            continue;
+        }
+        OGE_MEMORY_BARRIER();
+        memcpy(stats, &block->stats, sizeof(OgeTelemetryStats));
+        OGE_MEMORY_BARRIER();
+        if (block->sequence == sequence)
+            return true;
+    }
+    return false;
+}
+
+//--------------- Metrics ---------------------
+
+typedef struct OgeMetricInfo OgeMetricInfo;
+
+struct OgeMetricInfo
+{
+    const char* name;
+    u32 metric;             // handle
+};
+
+// Written by OgeMetricRegister() under the lock; the count is published once the entry is filled
+static OgeMetricInfo _ogeMetrics[OGE_METRICS_MAX_VALUES + OGE_METRICS_MAX_HISTOGRAMS];
+static volatile long _ogeMetricCount;
+static volatile long _ogeMetricsLock;
+static u32 _ogeMetricValueSlots = 1;        // slot 0: overflow
+static u32 _ogeMetricHistogramSlots = 1;
+
+OGE_THREAD_LOCAL OgeMetricsThread* _ogeMetricsThread;
+static OgeMetricsThread* volatile _ogeMetricsThreads; // only ever grows so it can be read without lock
+
+// State of the last OgeMetricsFrame(): the frame values are the differences with the new sums
+static long long _ogeMetricTotals[OGE_METRICS_MAX_VALUES];
+static long long _ogeMetricLogged[OGE_METRICS_MAX_VALUES];  // last gauge value written
+static OgeMetricHistogramSlot _ogeMetricHistogramTotals[OGE_METRICS_MAX_HISTOGRAMS];
+static OgeMetricHistogramStats _ogeMetricHistogramFrames[OGE_METRICS_MAX_HISTOGRAMS];
+
+// Usually called by the initializer of a static: before main() and before any logger.
+// A name registered again gets the same handle.
+u32 OgeMetricRegister(const char* name, OgeMetricKind kind) {
+    OgeSpinLock(&_ogeMetricsLock);
+    u32 count = (u32)_ogeMetricCount;
+    for (u32 i = 0; i < count; i++) {
+        if (OGE_METRIC_KIND(_ogeMetrics[i].metric) == (u32)kind && strcmp(_ogeMetrics[i].name, name) == 0) {
+            OgeSpinUnlock(&_ogeMetricsLock);
+            return _ogeMetrics[i].metric;
+        }
+    }
+
+    u32 slot = 0;
+    if (kind == OGE_METRIC_HISTOGRAM) {
+        if (_ogeMetricHistogramSlots < OGE_METRICS_MAX_HISTOGRAMS)
+            slot = _ogeMetricHistogramSlots++;
+    }
+    else if (_ogeMetricValueSlots < OGE_METRICS_MAX_VALUES)
+        slot = _ogeMetricValueSlots++;
+
+    u32 metric = ((u32)kind << 24) | slot;
+    if (slot == 0)
+        printf("OgeMetricRegister: too many metrics, %s isn't logged (see OGE_METRICS_MAX_VALUES/HISTOGRAMS)\n", name);
+    else {
+        _ogeMetrics[count].name = name;
+        _ogeMetrics[count].metric = metric;
+        OGE_MEMORY_BARRIER();
+        _ogeMetricCount = (long)count + 1;
+    }
+    OgeSpinUnlock(&_ogeMetricsLock);
+    return metric;
+}
+
+OgeMetricsThread* OgeMetricsCreateThread() {
+    // Never freed: the first cache line boundary of the block is used. (calloc) isn't tracked.
+    char* block = (char*)(calloc)(1, sizeof(OgeMetricsThread) + OGE_MEMORY_CACHE_LINE - 1);
+    if (block == NULL)
+        return NULL;
+
+    OgeMetricsThread* thread = (OgeMetricsThread*)(((size_t)block + OGE_MEMORY_CACHE_LINE - 1) & ~(size_t)(OGE_MEMORY_CACHE_LINE - 1));
+    OgeSpinLock(&_ogeMetricsLock);
+    thread->next = _ogeMetricsThreads;
+    (void)OGE_ATOMIC_EXCHANGE_POINTER(&_ogeMetricsThreads, thread); // published once filled
+    OgeSpinUnlock(&_ogeMetricsLock);
+
+    _ogeMetricsThread = thread;
+    return thread;
+}
+
+// First record of a histogram by a thread
+OgeMetricHistogramSlot* OgeMetricsCreateHistogram(OgeMetricsThread* thread, u32 slot) {
+    OgeMetricHistogramSlot* histogram = (OgeMetricHistogramSlot*)(calloc)(1, sizeof(OgeMetricHistogramSlot));
+    if (histogram != NULL)
+        (void)OGE_ATOMIC_EXCHANGE_POINTER(&thread->histograms[slot], histogram);
+    return histogram;
+}
+
+long long OgeMetricValue(u32 metric) {
+    u32 slot = OGE_METRIC_SLOT(metric);
+    if (OGE_METRIC_KIND(metric) == OGE_METRIC_HISTOGRAM || slot >= OGE_METRICS_MAX_VALUES)
+        return 0;
+    long long value = 0;
+    for (OgeMetricsThread* thread = _ogeMetricsThreads; thread != NULL; thread = thread->next)
+        value += ((const volatile long long*)thread->values)[slot];
+    return value;
+}
+
+bool OgeMetricHistogramFrame(u32 metric, OgeMetricHistogramStats* stats) {
+    u32 slot = OGE_METRIC_SLOT(metric);
+    if (OGE_METRIC_KIND(metric) != OGE_METRIC_HISTOGRAM || slot >= OGE_METRICS_MAX_HISTOGRAMS)
+        return false;
+    *stats = _ogeMetricHistogramFrames[slot];
+    return stats->count > 0;
+}
+
+// Highest value of a bucket. The last one wraps to the u64 max.
+inline u64 OgeMetricHistogramValue(u32 index) {
+    if (index < 2 * OGE_METRIC_HISTOGRAM_SUB_BUCKETS)
+        return index;
+    u32 shift = index / OGE_METRIC_HISTOGRAM_SUB_BUCKETS - 1;
+    u64 sub = index - shift * OGE_METRIC_HISTOGRAM_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+// Stats of the values recorded since the last frame: the new sums of the threads minus the old ones
+static void OgeMetricHistogramMerge(u32 slot) {
+    u64 counts[OGE_METRIC_HISTOGRAM_SIZE];
+    u64 sum = 0;
+    memset(counts, 0, sizeof(counts));
+    for (OgeMetricsThread* thread = _ogeMetricsThreads; thread != NULL; thread = thread->next) {
+        const volatile OgeMetricHistogramSlot* histogram = thread->histograms[slot];
+        if (histogram == NULL)
+            continue;
+        sum += histogram->sum;
+        for (u32 i = 0; i < OGE_METRIC_HISTOGRAM_SIZE; i++)
+            counts[i] += histogram->counts[i];
+    }
+
+    OgeMetricHistogramSlot* total = &_ogeMetricHistogramTotals[slot];
+    OgeMetricHistogramStats* stats = &_ogeMetricHistogramFrames[slot];
+    memset(stats, 0, sizeof(OgeMetricHistogramStats));
+    u32 last = 0;
+    for (u32 i = 0; i < OGE_METRIC_HISTOGRAM_SIZE; i++) {
+        u64 count = counts[i] - total->counts[i];
+        total->counts[i] = counts[i];
+        counts[i] = count; // now the counts of the frame
+        if (count != 0) {
+            stats->count += count;
+            last = i;
+        }
+    }
+    u64 frameSum = sum - total->sum;
+    total->sum = sum;
+    if (stats->count == 0)
+        return;
+
+    stats->mean = (double)frameSum / (double)stats->count;
+    stats->max = OgeMetricHistogramValue(last);
+    const double percentiles[3] = { 50.0, 90.0, 99.0 };
+    u64* values[3] = { &stats->p50, &stats->p90, &stats->p99 };
+    u64 seen = 0;
+    u32 p = 0;
+    for (u32 i = 0; i <= last && p < 3; i++) {
+        seen += counts[i];
+        while (p < 3 && seen >= (u64)(percentiles[p] / 100.0 * (double)stats->count + 0.5))
+            *values[p++] = OgeMetricHistogramValue(i);
+    }
+}
+
+void OgeMetricsFrame() {
+    bool emit = OGE_LOG_METRICS && _ogeLogger != NULL && _ogeLogger->logFile != NULL;
+    u32 count = (u32)_ogeMetricCount;
+    char text[7][32];
+    const char* values[7];
+    for (int i = 0; i < 7; i++)
+        values[i] = text[i];
+
+    for (u32 m = 0; m < count; m++) {
+        const OgeMetricInfo* info = &_ogeMetrics[m];
+        u32 slot = OGE_METRIC_SLOT(info->metric);
+        values[0] = info->name;
+
+        switch (OGE_METRIC_KIND(info->metric)) {
+        case OGE_METRIC_COUNTER: {
+            long long total = OgeMetricValue(info->metric);
+            long long frame = total - _ogeMetricTotals[slot];
+            _ogeMetricTotals[slot] = total;
+            if (emit && frame != 0) {
+                snprintf(text[1], 32, "%lld", frame);
+                snprintf(text[2], 32, "%lld", total);
+                OgeLogSummary("counter", values, 3);
+            }
+            break;
+        }
+        case OGE_METRIC_GAUGE: {
+            long long value = OgeMetricValue(info->metric);
+            if (emit && value != _ogeMetricLogged[slot]) {
+                snprintf(text[1], 32, "%lld", value);
+                OgeLogSummary("gauge", values, 2);
+                _ogeMetricLogged[slot] = value;
+            }
+            break;
+        }
+        case OGE_METRIC_HISTOGRAM: {
+            OgeMetricHistogramMerge(slot);
+            const OgeMetricHistogramStats* stats = &_ogeMetricHistogramFrames[slot];
+            if (emit && stats->count > 0) {
+                snprintf(text[1], 32, "%llu", (unsigned long long)stats->count);
+                snprintf(text[2], 32, "%.1f", stats->mean);
+                snprintf(text[3], 32, "%llu", (unsigned long long)stats->p50);
+                snprintf(text[4], 32, "%llu", (unsigned long long)stats->p90);
+                snprintf(text[5], 32, "%llu", (unsigned long long)stats->p99);
+                snprintf(text[6], 32, "%llu", (unsigned long long)stats->max);
+                OgeLogSummary("histogram", values, 7);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
 }
 
 //--------------- Text File ---------------------
@@ -206,7 +877,20 @@ void OgeLogFooterText() {
     fprintf(_ogeLogger->logFile, "Log file closed.\n");
 }
 
-void OgeLogAllocText(int allocator, const char* action, long address, long size, const char* file, int line) {
+// mem: 10 0 add 101084 1000 57 2 main.cpp:12
+// Compact format read by the HeapLogViewer: the file:line is last as it can have spaces.
+// Frame, allocator, action, address, size, sequence, thread.
+void OgeLogAllocText(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread) {
+    fprintf(_ogeLogger->logFile, "mem: %lu %d %s %ld %ld %llu %u %s:%d\n", _ogeLogger->updateCount, allocator, action, address, size,
+        (unsigned long long)sequence, (unsigned)thread, file != NULL ? file : "", line);
+}
+
+// frag: 600 0 1500 ...
+void OgeLogSummaryText(const char* type, const char* const* values, int count) {
+    fprintf(_ogeLogger->logFile, "%s: %lu", type, _ogeLogger->updateCount);
+    for (int i = 0; i < count; i++)
+        fprintf(_ogeLogger->logFile, " %s", values[i]);
+    fprintf(_ogeLogger->logFile, "\n");
 }
 
 //--------------- HTML File ---------------------
@@ -258,10 +942,18 @@ void OgeLogFooterHTML() {
     fprintf(_ogeLogger->logFile, "</body>\n");;
 }
 
-void OgeLogAllocHTML(int allocator, const char* action, long address, long size, const char* file, int line) {
+void OgeLogAllocHTML(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread) {
      // TODO
 }
 
+void OgeLogSummaryHTML(const char* type, const char* const* values, int count) {
+    fprintf(_ogeLogger->logFile, "<font style=\"FONT-FAMILY: \'Courier New\'\" size=2>\n");
+    fprintf(_ogeLogger->logFile, "%s: %lu", type, _ogeLogger->updateCount);
+    for (int i = 0; i < count; i++)
+        fprintf(_ogeLogger->logFile, " %s", values[i]);
+    fprintf(_ogeLogger->logFile, "</font><br>\n");
+}
+
 //--------------- JSON File ---------------------
 
 void replaceChar(char* str, char orig, char rep) {
@@ -307,33 +999,7 @@ void OgeLogJSON(int level, const char* text, const char* file, int line) {
     sprintf(nb, "%d", _ogeLogger->updateCount);
     fprintf(_ogeLogger->logFile, nb);
     fprintf(_ogeLogger->logFile, "\", \"p2\":\""); // ", "p2":"
-    const char* tmp;
-    switch (level)
-    {
-    case 0:
-        tmp = "err";
-        break;
-    case 1:
-        tmp = "rel";
-        break;
-    case 2:
-        tmp = "log"; // normal
-        break;
-    case 3:
-        tmp = "dbg";
-        break;
-    case 4:
-        tmp = "info";
-        break;
-    case 5:
-        tmp = "verb";
-        break;
-    default:
-        tmp = "log";
-        break;
-    }
-
-    fprintf(_ogeLogger->logFile, tmp);
+    fprintf(_ogeLogger->logFile, OgeLogLevelName(level));
     fprintf(_ogeLogger->logFile, "\", \"p3\":\""); // ", "p3":"
 
     char str[100];
@@ -357,8 +1023,9 @@ void OgeLogFooterJSON() {
     fprintf(_ogeLogger->logFile, "\n]}\n");
 }
 
-//  {"type":"mem", "p1":"10", "p2":"0", "p3":"add" ,"p4":"101084", "p5":"10000000" },
-void OgeLogAllocJSON(int allocator, const char* action, long address, long size, const char* file, int line) {
+//  {"type":"mem", "p1":"10", "p2":"0", "p3":"add" ,"p4":"101084", "p5":"10000000", "p6":"main.cpp:12", "p7":"57", "p8":"2" },
+// p7 is the sequence of the event among all the threads, p8 the thread (0 for LOGA)
+void OgeLogAllocJSON(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread) {
 
     // This is the last part of the PREVIOUS line!
     if (_ogeLogger->logCount > 1)
@@ -367,25 +1034,164 @@ void OgeLogAllocJSON(int allocator, const char* action, long address, long size,
     char nb[50];
     fprintf(_ogeLogger->logFile, "{\"type\":\"mem\","); // {"type":"mem",
     fprintf(_ogeLogger->logFile, "\"p1\":\"");         // {"p1":"
-    fprintf(_ogeLogger->logFile, "" + _ogeLogger->updateCount);
+    sprintf(nb, "%lu", _ogeLogger->updateCount);
+    fprintf(_ogeLogger->logFile, nb);                   // Frame
     fprintf(_ogeLogger->logFile, "\", \"p2\":\"");      // ", "p2":"
     sprintf(nb, "%d", allocator);
     fprintf(_ogeLogger->logFile, nb);       // Memory Allocator Nb
     fprintf(_ogeLogger->logFile, "\", \"p3\":\"");      // ", "p3":"
     fprintf(_ogeLogger->logFile, action);               // Actions: add, clr, del, ..
     fprintf(_ogeLogger->logFile, "\", \"p4\":\"");      // ", "p4":"
-    sprintf(nb, "%d", address);
+    sprintf(nb, "%ld", address);
     fprintf(_ogeLogger->logFile, nb);
     fprintf(_ogeLogger->logFile, "\", \"p5\":\""); // ", "p5":"
-    sprintf(nb, "%d", size);
+    sprintf(nb, "%ld", size);
     fprintf(_ogeLogger->logFile, nb);
-    fprintf(_ogeLogger->logFile, "\" }");            // " }
-    
-    // TODO add file + line !!
+    fprintf(_ogeLogger->logFile, "\", \"p6\":\""); // ", "p6":"
+
+    char str[100];
+    strncpy(str, file != NULL ? file : "", sizeof(str) - 1);
+    str[sizeof(str) - 1] = '\0';
+    replaceChar(str, '\\', '/');
+    fprintf(_ogeLogger->logFile, "%s:%d", str, line); // file:line
+    fprintf(_ogeLogger->logFile, "\", \"p7\":\"%llu\", \"p8\":\"%u\" }", (unsigned long long)sequence, (unsigned)thread); // ", "p7":"57", "p8":"2" }
+}
+
+//  {"type":"frag", "p1":"600", "p2":"0", "p3":"1500", ... },
+void OgeLogSummaryJSON(const char* type, const char* const* values, int count) {
+
+    // This is the last part of the PREVIOUS line!
+    if (_ogeLogger->logCount > 1)
+        fprintf(_ogeLogger->logFile, ",\n");
+
+    fprintf(_ogeLogger->logFile, "{\"type\":\"%s\",\"p1\":\"%lu\"", type, _ogeLogger->updateCount); // Frame
+    for (int i = 0; i < count; i++)
+        fprintf(_ogeLogger->logFile, ", \"p%d\":\"%s\"", i + 2, values[i]);
+    fprintf(_ogeLogger->logFile, " }");
+}
+
+//--------------- NDJSON File ---------------------
+
+// Append 'text' to the record as the inside of a JSON string. The text is cut at the first
+// character whose escape doesn't fit before 'limit'. A path gets '/' separators.
+static void OgeLogAppendString(char* record, size_t* length, size_t limit, const char* text, bool path) {
+    static const char hex[] = "0123456789abcdef";
+    size_t n = *length;
+    for (const char* c = text != NULL ? text : ""; *c != '\0'; c++) {
+        unsigned char ch = (unsigned char)*c;
+        if (path && ch == '\\')
+            ch = '/';
+        if (ch == '"' || ch == '\\') {
+            if (n + 2 > limit)
+                break;
+            record[n++] = '\\';
+            record[n++] = (char)ch;
+        }
+        else if (ch < 0x20) {
+            if (n + 6 > limit)
+                break;
+            memcpy(record + n, "\\u00", 4);
+            record[n + 4] = hex[ch >> 4];
+            record[n + 5] = hex[ch & 15];
+            n += 6;
+        }
+        else {
+            if (n + 1 > limit)
+                break;
+            record[n++] = (char)ch;
+        }
+    }
+    *length = n;
+}
+
+// One fwrite per record: the stdio lock keeps the lines of two threads apart
+static void OgeLogWriteRecord(const char* record, size_t length) {
+    fwrite(record, 1, length, _ogeLogger->logFile);
+    OgeLogFlushCheck();
+}
+
+// {"type":"log","p1":"59","p2":"info","p3":"engine.cpp:563","p4":"Starting engine","p5":"-"}
+void OgeLogNDJSON(int level, const char* text, const char* file, int line) {
+    if (_ogeLogger->showOnConsole)
+        printf("%d : %s\n", level, text);
+
+    // The end of the record always fits after 'limit'
+    char record[OGE_LOG_LINE_SIZE];
+    size_t limit = sizeof(record) - 64;
+    size_t length = (size_t)snprintf(record, sizeof(record), "{\"type\":\"log\",\"p1\":\"%lu\",\"p2\":\"%s\",\"p3\":\"",
+        _ogeLogger->updateCount, OgeLogLevelName(level));
+    OgeLogAppendString(record, &length, limit, file, true);
+    length += (size_t)snprintf(record + length, sizeof(record) - length, ":%d\",\"p4\":\"", line);
+    OgeLogAppendString(record, &length, limit, text, false);
+    length += (size_t)snprintf(record + length, sizeof(record) - length, "\",\"p5\":\"-\"}\n");
+    OgeLogWriteRecord(record, length);
+}
+
+// {"type":"mem","p1":"10","p2":"0","p3":"add","p4":"101084","p5":"1000","p6":"main.cpp:12","p7":"57","p8":"2"}
+void OgeLogAllocNDJSON(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread) {
+    char record[512];
+    size_t limit = sizeof(record) - 80; // line, sequence and thread
+    size_t length = (size_t)snprintf(record, sizeof(record), "{\"type\":\"mem\",\"p1\":\"%lu\",\"p2\":\"%d\",\"p3\":\"%s\",\"p4\":\"%ld\",\"p5\":\"%ld\",\"p6\":\"",
+        _ogeLogger->updateCount, allocator, action, address, size);
+    OgeLogAppendString(record, &length, limit, file, true);
+    length += (size_t)snprintf(record + length, sizeof(record) - length, ":%d\",\"p7\":\"%llu\",\"p8\":\"%u\"}\n",
+        line, (unsigned long long)sequence, (unsigned)thread);
+    OgeLogWriteRecord(record, length);
+}
+
+// {"type":"frag","p1":"600","p2":"0","p3":"1500", ...}
+void OgeLogSummaryNDJSON(const char* type, const char* const* values, int count) {
+    char record[OGE_LOG_LINE_SIZE];
+    size_t limit = sizeof(record) - 16;
+    size_t length = (size_t)snprintf(record, sizeof(record), "{\"type\":\"%s\",\"p1\":\"%lu\"", type, _ogeLogger->updateCount);
+    for (int i = 0; i < count && length + 16 < limit; i++) {
+        length += (size_t)snprintf(record + length, sizeof(record) - length, ",\"p%d\":\"", i + 2);
+        OgeLogAppendString(record, &length, limit, values[i], false);
+        record[length++] = '"';
+    }
+    length += (size_t)snprintf(record + length, sizeof(record) - length, "}\n");
+    OgeLogWriteRecord(record, length);
+}
+
+// {"type":"start","p1":"0","p2":"0.1","p3":"Mon Jun 8 15:49:35 2020"}
+void OgeLogHeaderNDJSON() {
+    char date[64];
+    snprintf(date, sizeof(date), "%s", OgeLogGetDate());
+    date[strcspn(date, "\r\n")] = '\0';
+    fprintf(_ogeLogger->logFile, "{\"type\":\"start\",\"p1\":\"%lu\",\"p2\":\"%s\",\"p3\":\"%s\"}\n",
+        _ogeLogger->updateCount, OGE_VERSION, date);
+    fflush(_ogeLogger->logFile);
+    OGE_ATOMIC_STORE_RELEASE(&_ogeLogger->flushTime, (long long)OgeLogMilliseconds());
+}
+
+// {"type":"end","p1":"600"}: a reader knows the game closed the log
+void OgeLogFooterNDJSON() {
+    fprintf(_ogeLogger->logFile, "{\"type\":\"end\",\"p1\":\"%lu\"}\n", _ogeLogger->updateCount);
 }
 
 //------------------------------------------------
 
+// Level name of the log records
+const char* OgeLogLevelName(int level) {
+    switch (level) {
+    case OGE_LOG_ERROR:
+        return "err";
+    case OGE_LOG_RELEASE:
+        return "rel";
+    case OGE_LOG_NORMAL:
+        return "log";
+    case OGE_LOG_DEBUG:
+        return "dbg";
+    case OGE_LOG_INFO:
+        return "info";
+    case OGE_LOG_VERBOSE:
+        return "verb";
+    default:
+        break;
+    }
+    return "log";
+}
+
 // Return something like "Mon Jun 8 15:49:35 2020"
 const char* OgeLogGetDate() {
     struct tm* pTime;
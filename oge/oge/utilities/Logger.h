@@ -36,8 +36,6 @@
 #   endif
 #endif
 
-typedef enum OgeLogLevel OgeLogLevel;
-
 enum OgeLogLevel
 {
     OGE_LOG_ERROR = 1,
@@ -51,15 +49,316 @@ enum OgeLogLevel
     OGE_LOG_ALLOC,
 };
 
+typedef enum OgeLogLevel OgeLogLevel;
+
 enum OgeLogType
 {
     OGE_LOGTYPE_TEXT = 1,
     OGE_LOGTYPE_HTML,
     OGE_LOGTYPE_JSON,
+    OGE_LOGTYPE_NDJSON,     // one JSON record per line, valid and readable while the game runs
 };
 
 typedef enum OgeLogType OgeLogType;
 
+//--------------- NDJSON log ---------------------
+
+// OGE_LOGTYPE_NDJSON writes the records of OGE_LOGTYPE_JSON without the {"log":[ ]} around them:
+// each record is a whole line, written with one fwrite so two threads never mix their records.
+// A "start" record (p2 version, p3 date) opens the file and an "end" record closes it.
+// The first record written OGE_LOG_FLUSH_MS after the last flush flushes the log, and so does
+// OgeLogUpdate(). Nothing flushes a quiet log in between: a program without frames (a tool, a
+// server) calls OgeLogFlush() from a timer or a thread, so a reader tailing the file (OgeLogTailNext(),
+// samples/LogTail) sees the records with a bounded delay and a crash only loses the last ones.
+// 0 = flush each record.
+#ifndef OGE_LOG_FLUSH_MS
+#   define OGE_LOG_FLUSH_MS 100
+#endif
+
+#define OGE_LOG_LINE_SIZE 4096  // longer messages are cut
+
+//--------------- Sidecar index ---------------------
+
+// The logger writes "<log file>.idx" next to the log: one entry at the start of each frame
+// and one every OGE_LOG_INDEX_INTERVAL records, so a reader can seek to a frame or start
+// from a checkpoint instead of the first record. 0 = no index.
+#ifndef OGE_LOG_INDEX_INTERVAL
+#   define OGE_LOG_INDEX_INTERVAL 4096
+#endif
+
+#define OGE_LOG_INDEX_MAGIC "OGELOGIX"
+#define OGE_LOG_INDEX_VERSION 1
+#define OGE_LOG_INDEX_ALLOCATORS 16 // live bytes of the allocators 0 to 15, the others aren't counted
+
+enum OgeLogIndexKind
+{
+    OGE_LOG_INDEX_FRAME = 1,    // a frame starts: written by OgeLogUpdate()
+    OGE_LOG_INDEX_CHECKPOINT,   // every OGE_LOG_INDEX_INTERVAL records
+};
+
+typedef enum OgeLogIndexKind OgeLogIndexKind;
+
+typedef struct OgeLogIndexHeader OgeLogIndexHeader;
+
+struct OgeLogIndexHeader
+{
+    char magic[8];
+    u32 version;
+    u32 entrySize;
+    u32 interval;
+    u32 allocatorCount;
+};
+
+typedef struct OgeLogIndexEntry OgeLogIndexEntry;
+
+// State of the log after 'record' records. The next record starts at or after 'offset'
+// (the JSON separator comes first). The entries are in file order.
+struct OgeLogIndexEntry
+{
+    u64 offset;
+    u64 record;
+    u32 frame;
+    u16 kind;           // OgeLogIndexKind
+    u16 reserved;
+    long long liveBytes[OGE_LOG_INDEX_ALLOCATORS]; // sum of the add/commit minus del/decommit records
+};
+
+//--------------- Live telemetry ---------------------
+
+// OgeTelemetryOpen() publishes the counters of the logger and of the allocators in a named
+// shared memory block (shm_open on POSIX, a file mapping on Windows). OgeLogUpdate() rewrites
+// it at the end of each frame under a sequence lock, so a monitor of the same machine
+// (samples/TelemetryMonitor) reads it while the game runs, without pausing it or any file I/O.
+#define OGE_TELEMETRY_NAME "/oge_telemetry"
+#define OGE_TELEMETRY_MAGIC "OGETELEM"
+#define OGE_TELEMETRY_VERSION 1
+#define OGE_TELEMETRY_ALLOCATORS 16
+#define OGE_TELEMETRY_LEVELS 8      // records by OgeLogLevel, and the summary records in the free slot 0
+#define OGE_TELEMETRY_SUMMARY 0     // levelRecords slot of the summary records (i.e. "frag")
+
+static_assert(OGE_TELEMETRY_SUMMARY < OGE_LOG_ERROR, "the summary slot must not be a log level");
+static_assert(OGE_LOG_ALLOC < OGE_TELEMETRY_LEVELS, "a log level has no levelRecords slot");
+
+typedef struct OgeTelemetryAllocator OgeTelemetryAllocator;
+
+struct OgeTelemetryAllocator
+{
+    char name[24];
+    u64 liveBytes;
+    u64 liveCount;
+    u64 peakBytes;      // high-water mark of the live bytes
+    u64 frameCount;     // allocations during the last frame
+    u64 totalCount;
+    u64 budget;         // 0 = no budget
+};
+
+typedef struct OgeTelemetryStats OgeTelemetryStats;
+
+struct OgeTelemetryStats
+{
+    u64 publishCount;   // incremented by each OgeLogUpdate(): a monitor sees a stopped game
+    u64 frame;          // given to OgeLogUpdate()
+    float deltaTime;
+    u32 allocatorCount; // used entries of 'allocators'
+    u64 logRecords;
+    u64 droppedRecords; // refused once maxLogCount was reached, and allocation events lost
+    u64 levelRecords[OGE_TELEMETRY_LEVELS];
+    OgeTelemetryAllocator allocators[OGE_TELEMETRY_ALLOCATORS];
+};
+
+typedef struct OgeTelemetryBlock OgeTelemetryBlock;
+
+// Layout of the shared memory. A reader checks the magic, version and size before the stats.
+struct OgeTelemetryBlock
+{
+    char magic[8];
+    u32 version;
+    u32 size;               // sizeof(OgeTelemetryBlock)
+    u32 processId;
+    volatile u32 sequence;  // odd while the writer updates 'stats'
+    OgeTelemetryStats stats;
+};
+
+//--------------- Frame summaries ---------------------
+
+// At each OgeLogUpdate() the logger writes a "frame" record for the frame ending:
+//   p1 frame, p2 delta time (ms), p3 allocations, p4 frees, p5 bytes allocated, p6 bytes freed,
+//   p7 peak live bytes, p8 live bytes at the end, p9 to p14 records of the levels error to verbose
+// The live bytes are those of the allocation records (all the allocators, commit/decommit included),
+// in the order they reach the log. 0 = no frame record, the frame times are still measured.
+#ifndef OGE_LOG_FRAME_SUMMARY
+#   define OGE_LOG_FRAME_SUMMARY 1
+#endif
+
+// HDR style histogram of the frame times in microseconds: the values below 128us are exact,
+// then each power of 2 has 64 buckets, i.e. less than 1.6% error up to 2^32us.
+// OgeLogCloseFile() writes its percentiles in a "frametime" record.
+#define OGE_FRAME_HISTOGRAM_SUB_BUCKETS 64
+#define OGE_FRAME_HISTOGRAM_POWERS 25
+#define OGE_FRAME_HISTOGRAM_SIZE (2 * OGE_FRAME_HISTOGRAM_SUB_BUCKETS + OGE_FRAME_HISTOGRAM_POWERS * OGE_FRAME_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct OgeFrameHistogram OgeFrameHistogram;
+
+struct OgeFrameHistogram
+{
+    u64 counts[OGE_FRAME_HISTOGRAM_SIZE];
+    u64 count;
+    u64 min;
+    u64 max;
+    double sum;
+};
+
+//--------------- Metrics ---------------------
+
+// Named numbers of the hot code, instead of LOG strings parsed back out of the log:
+//   static const u32 _drawCalls = OgeMetricRegister("render.draw_calls", OGE_METRIC_COUNTER);
+//   static const u32 _cullTime = OgeMetricRegister("render.cull_ns", OGE_METRIC_HISTOGRAM);
+//   OgeCounterAdd(_drawCalls, 1);
+//   OgeHistogramRecord(_cullTime, end - start);
+// An update is an add in the metrics block of the calling thread (cache line aligned and only
+// written by its thread): no atomics, no lock. OgeLogUpdate() sums the blocks of all the threads
+// and writes a record for each metric that changed during the frame:
+//   "counter":   p1 frame, p2 name, p3 increment during the frame, p4 total
+//   "gauge":     p1 frame, p2 name, p3 value
+//   "histogram": p1 frame, p2 name, p3 count, p4 mean, p5 p50, p6 p90, p7 p99, p8 max (of the frame)
+// A gauge is the sum of the values of each thread: set it from one thread or use OgeGaugeAdd().
+// The histograms are log-linear like OgeFrameHistogram but with 16 buckets per power of 2
+// (less than 6.3% error) over the whole u64 range. The unit is the caller's (ns, ticks, bytes...).
+// The names are used as is in the log: no quotes. 0 = no metric record, the sums are still made.
+#ifndef OGE_LOG_METRICS
+#   define OGE_LOG_METRICS 1
+#endif
+
+#ifndef OGE_METRICS_MAX_VALUES
+#   define OGE_METRICS_MAX_VALUES 128      // counters and gauges
+#endif
+#ifndef OGE_METRICS_MAX_HISTOGRAMS
+#   define OGE_METRICS_MAX_HISTOGRAMS 32
+#endif
+
+#define OGE_METRIC_HISTOGRAM_SHIFT 4        // log2 of the sub buckets
+#define OGE_METRIC_HISTOGRAM_SUB_BUCKETS (1 << OGE_METRIC_HISTOGRAM_SHIFT)
+#define OGE_METRIC_HISTOGRAM_SIZE ((64 - OGE_METRIC_HISTOGRAM_SHIFT + 1) * OGE_METRIC_HISTOGRAM_SUB_BUCKETS)
+
+enum OgeMetricKind
+{
+    OGE_METRIC_COUNTER = 1,
+    OGE_METRIC_GAUGE,
+    OGE_METRIC_HISTOGRAM,
+};
+
+typedef enum OgeMetricKind OgeMetricKind;
+
+// A metric handle is its kind << 24 | its slot. The slot 0 of each kind takes the updates
+// of the metrics registered once the table was full, and is never written to the log.
+#define OGE_METRIC_SLOT(metric) ((metric) & 0xFFFFFF)
+#define OGE_METRIC_KIND(metric) ((metric) >> 24)
+
+typedef struct OgeMetricHistogramSlot OgeMetricHistogramSlot;
+
+// Running counts of one histogram for one thread
+struct OgeMetricHistogramSlot
+{
+    u64 sum;
+    u64 counts[OGE_METRIC_HISTOGRAM_SIZE];
+};
+
+typedef struct OgeMetricsThread OgeMetricsThread;
+
+// Created at the first update of each thread and kept when the thread exits, like the
+// memory counters of the threads. The values only grow (or are set) so OgeLogUpdate()
+// reads them without writing to them: an update is never lost, at worst one frame late.
+struct OgeMetricsThread
+{
+    long long values[OGE_METRICS_MAX_VALUES];  // first: cache line aligned
+    OgeMetricHistogramSlot* volatile histograms[OGE_METRICS_MAX_HISTOGRAMS]; // created at the first record
+    OgeMetricsThread* volatile next;
+};
+
+typedef struct OgeMetricHistogramStats OgeMetricHistogramStats;
+
+struct OgeMetricHistogramStats
+{
+    u64 count;
+    double mean;
+    u64 p50;
+    u64 p90;
+    u64 p99;
+    u64 max;            // within the bucket precision, like the percentiles
+};
+
+extern OGE_THREAD_LOCAL OgeMetricsThread* _ogeMetricsThread;
+
+extern u32  OgeMetricRegister(const char* name, OgeMetricKind kind);
+extern OgeMetricsThread* OgeMetricsCreateThread();
+// Sums the threads and writes the records: called by OgeLogUpdate()
+extern void OgeMetricsFrame();
+// Counter total or gauge value, summed over the threads now
+extern long long OgeMetricValue(u32 metric);
+// Values recorded during the last frame. False if there were none.
+extern bool OgeMetricHistogramFrame(u32 metric, OgeMetricHistogramStats* stats);
+
+inline OgeMetricsThread* OgeMetricsCurrentThread()
+{
+    OgeMetricsThread* thread = _ogeMetricsThread;
+    return thread != NULL ? thread : OgeMetricsCreateThread();
+}
+
+inline u32 OgeMetricHistogramIndex(u64 value)
+{
+    if (value < 2 * OGE_METRIC_HISTOGRAM_SUB_BUCKETS)
+        return (u32)value;
+#if defined(_MSC_VER)
+    unsigned long msb;
+    _BitScanReverse64(&msb, value);
+#else
+    u32 msb = 63 - (u32)__builtin_clzll(value);
+#endif
+    u32 shift = (u32)msb - OGE_METRIC_HISTOGRAM_SHIFT;
+    return shift * OGE_METRIC_HISTOGRAM_SUB_BUCKETS + (u32)(value >> shift);
+}
+
+// Hot path: one add in a cache line of this thread
+inline void OgeCounterAdd(u32 metric, u64 value)
+{
+    assert(OGE_METRIC_KIND(metric) == OGE_METRIC_COUNTER);
+    OgeMetricsThread* thread = OgeMetricsCurrentThread();
+    if (thread != NULL)
+        thread->values[OGE_METRIC_SLOT(metric)] += (long long)value;
+}
+
+inline void OgeGaugeSet(u32 metric, long long value)
+{
+    assert(OGE_METRIC_KIND(metric) == OGE_METRIC_GAUGE);
+    OgeMetricsThread* thread = OgeMetricsCurrentThread();
+    if (thread != NULL)
+        thread->values[OGE_METRIC_SLOT(metric)] = value;
+}
+
+inline void OgeGaugeAdd(u32 metric, long long delta)
+{
+    assert(OGE_METRIC_KIND(metric) == OGE_METRIC_GAUGE);
+    OgeMetricsThread* thread = OgeMetricsCurrentThread();
+    if (thread != NULL)
+        thread->values[OGE_METRIC_SLOT(metric)] += delta;
+}
+
+extern OgeMetricHistogramSlot* OgeMetricsCreateHistogram(OgeMetricsThread* thread, u32 slot);
+
+inline void OgeHistogramRecord(u32 metric, u64 value)
+{
+    assert(OGE_METRIC_KIND(metric) == OGE_METRIC_HISTOGRAM);
+    OgeMetricsThread* thread = OgeMetricsCurrentThread();
+    if (thread == NULL)
+        return;
+    u32 slot = OGE_METRIC_SLOT(metric);
+    OgeMetricHistogramSlot* histogram = thread->histograms[slot];
+    if (histogram == NULL && (histogram = OgeMetricsCreateHistogram(thread, slot)) == NULL)
+        return;
+    histogram->counts[OgeMetricHistogramIndex(value)]++;
+    histogram->sum += value;
+}
+
 typedef struct OgeLogger OgeLogger;
 
 /**
@@ -104,9 +403,25 @@ struct OgeLogger
     bool showOnConsole;
     OgeLogType logType;
     FILE* logFile;
+    FILE* indexFile;
+    long long liveBytes[OGE_LOG_INDEX_ALLOCATORS];
+    u64 levelRecords[OGE_TELEMETRY_LEVELS];
+    u64 droppedRecords;
+
+    // Counters of the frame ending at the next OgeLogUpdate()
+    u64 frameAllocCount;
+    u64 frameFreeCount;
+    u64 frameAllocBytes;
+    u64 frameFreeBytes;
+    long long liveTotal;        // all the allocators
+    long long framePeakBytes;
+    u64 frameLevelStart[OGE_TELEMETRY_LEVELS]; // levelRecords when the frame started
+    OgeFrameHistogram frameTimes;
+    volatile long long flushTime; // ms of the last flush of a NDJSON log, the thread exchanging it flushes
 
     void (*Log)(int level, const char* text, const char* file, int line);
-    void (*LogAlloc)(int allocator, const char* action, long address, long size, const char* file, int line);
+    void (*LogAlloc)(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread);
+    void (*LogSummary)(const char* type, const char* const* values, int count);
     void (*LogHeader)(void);
     void (*LogFooter)(void);
 };
@@ -119,9 +434,11 @@ extern void  OgeLogMessageTest(bool test, int level, const char* text, const cha
 extern void  OgeLogUpdate(float deltaTime, int frame);
 extern void  OgeLogOpenFile(const char* filename);
 extern void  OgeLogCloseFile();
+extern void  OgeLogFlush();     // writes the pending allocation events and flushes the log
 
 void OgeLogText(int level, const char* text, const char* file, int line);
-void OgeLogAllocText(int allocator, const char* action, long address, long size, const char* file, int line);
+void OgeLogAllocText(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread);
+void OgeLogSummaryText(const char* type, const char* const* values, int count);
 void OgeLogHeaderText();
 void OgeLogFooterText();
 
@@ -129,17 +446,33 @@ void OgeLogFooterText();
 //void OgeLogFooter();
 
 void OgeLogHTML(int level, const char* text, const char* file, int line);
-void OgeLogAllocHTML(int allocator, const char* action, long address, long size, const char* file, int line);
+void OgeLogAllocHTML(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread);
+void OgeLogSummaryHTML(const char* type, const char* const* values, int count);
 void OgeLogHeaderHTML();
 void OgeLogFooterHTML();
 
 void OgeLogJSON(int level, const char* text, const char* file, int line);
-void OgeLogAllocJSON(int allocator, const char* action, long address, long size, const char* file, int line);
+void OgeLogAllocJSON(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread);
+void OgeLogSummaryJSON(const char* type, const char* const* values, int count);
 void OgeLogHeaderJSON();
 void OgeLogFooterJSON();
 
+void OgeLogNDJSON(int level, const char* text, const char* file, int line);
+void OgeLogAllocNDJSON(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread);
+void OgeLogSummaryNDJSON(const char* type, const char* const* values, int count);
+void OgeLogHeaderNDJSON();
+void OgeLogFooterNDJSON();
+
 void OgeLogWriteIndent();
+void OgeLogWriteIndex(OgeLogIndexKind kind);
+void OgeLogFrameSummary(float deltaTime);
+void OgeLogFrameTimeSummary();
+
+void OgeFrameHistogramRecord(OgeFrameHistogram* histogram, u64 value);
+// Smallest value with at least 'percentile' % of the values at or below it (within the bucket precision)
+u64  OgeFrameHistogramPercentile(const OgeFrameHistogram* histogram, double percentile);
 
+const char* OgeLogLevelName(int level);
 const char* OgeLogGetDate();
 const char* OgeLogGetTime();
 const char* OgeLogGetDebugLine();
@@ -149,6 +482,22 @@ void OgeLogCallStack();
 extern void OgeLogMessage(int level, const char* text, const char* file, int line);
 // Action values should be add/rem/clr/del/err to be used with my HeapLogViewer
 extern void OgeLogAlloc(int allocator, const char* action, long address, long size, const char* file, int line);
+// Written by the tracker in the order of the events: 'sequence' numbers the events of the thread 'thread'
+// from 1, a gap means dropped events
+extern void OgeLogAllocEvent(int allocator, const char* action, long address, long size, const char* file, int line, u64 sequence, u32 thread);
+// Record of values computed by the engine (i.e. "frag"). The frame is added as the first value.
+// Like the messages, it is dropped once maxLogCount records were written.
+extern void OgeLogSummary(const char* type, const char* const* values, int count);
+
+// Creates the shared memory block (NULL = OGE_TELEMETRY_NAME) published by OgeLogUpdate()
+extern bool OgeTelemetryOpen(const char* name);
+extern void OgeTelemetryClose();
+extern void OgeTelemetryPublish(float deltaTime, int frame);
+// Monitor side: maps the block of a running game read only. NULL if there is none or its version differs.
+extern const OgeTelemetryBlock* OgeTelemetryAttach(const char* name);
+extern void OgeTelemetryDetach(const OgeTelemetryBlock* block);
+// Consistent copy of the stats: retries while the writer is updating them
+extern bool OgeTelemetryRead(const OgeTelemetryBlock* block, OgeTelemetryStats* stats);
 
 #ifdef LINE_FILE
 #   define LOGE(e)     OgeLogMessage(OGE_LOG_ERROR, e, __FILE__, __LINE__);
@@ -23,231 +23,2781 @@
  *  SOFTWARE.
  */
 #include "../Oge.h" // In which '#DEFINE OGE_USE_LEAK_CHECK 1' can be set
+#include <stddef.h> // size_t, ptrdiff_t
 
  /**
    Usage:
-     - Library must be build with preprocessor definition: OGE_MEMORY_IMPLEMENTATION
+     - The implementation is compiled in Logger.cpp, which defines OGE_MEMORY_IMPLEMENTATION
+       before including this file. Don't define it anywhere else: the functions are not inline.
      - Set preprocessor OGE_USE_LEAK_CHECK to 1 to use the leak report;
        otherwise the standard malloc/calloc/realloc/free are used
      - Call OgeMemoryReport(1); when you want a report.
+     - Call OgeMemorySiteReport(20, OGE_SITE_SORT_LIVE_BYTES); to see the 20 call sites
+       holding the most memory. The cost depends on the number of call sites (file + line),
+       not on the number of allocations, so it can be called every frame.
+     - Call OgeMemoryLifetimeReport(20); to rank the call sites whose blocks are freed in their
+       frame (frame arena candidates) or have one size (OgePool candidates), with the allocator
+       calls they would save. The lifetimes are counted in OgeMemoryAllocatorFrame() calls.
+     - Set preprocessor OGE_USE_STACK_CAPTURE to 1 to record the call stack of each allocation.
+       Stacks are stored once in a stack table and each allocation only keeps the stack id.
+       The frames of the tracker are dropped: a stack starts in the code allocating.
+       Symbols are only resolved when printing (OgeMemoryReport, OgeMemoryPrintStack).
+     - Set preprocessor OGE_MEMORY_SAMPLE_RATE to N bytes to only track about one allocation
+       per N bytes allocated (Poisson sampling on the bytes). The other allocations only pay
+       a counter decrement and a 16 bytes tag. The call site counters then hold unbiased
+       estimates: each sampled block counts for size / P(sampled) bytes.
+     - Call OgeMemorySnapshot() at two points (i.e. before and after a level) and
+       OgeMemorySnapshotDiff(a, b) to get the new, freed and grown blocks grouped by call site.
+     - In C++ every form of operator new/delete (array, nothrow, sized, aligned) goes through
+       the tracker. Use OGE_NEW instead of new to record the file and line:
+         Foo* foo = OGE_NEW Foo(1, 2);
+       A plain 'new' is recorded under "operator new" with the address of the calling code.
+     - For the hot C++ types use an OgePool<T, BlockCount> (Pool.h): create()/destroy() pop and
+       push a free list of slots and only the chunks of BlockCount objects are tracked.
+     - When a logger exists the allocations and frees are appended as fixed size events to a
+       ring per thread, without lock. The rings of all the threads are merged in the order of
+       the events and written to the log at each OgeLogUpdate() and OgeLogCloseFile(), or when
+       calling OgeLogFlush() or OgeMemoryFlushEvents() (i.e. from a timer of a program without frames).
+       A thread whose ring is full (OGE_MEMORY_EVENT_BUFFER events since the last flush)
+       drops its events: they are counted in the dropped records of the telemetry.
+     - Use OGE_MALLOC_TAGGED(size, allocator) (or OGE_NEW_TAGGED(allocator) in C++) to account
+       an allocation to an allocator id (i.e. one per subsystem). Each thread counts the
+       live bytes of each allocator in its own cache lines. OgeMemoryGetAllocatorStats() sums
+       them without locking, so it is cheap enough to be called every frame.
+       OgeMemorySetAllocatorBudget() logs an error (and calls the OgeBudgetCallback) once per
+       frame where the allocator is over its budget.
+     - For big buffers that grow (streaming pools, vertex caches) use an OgeVirtualArena:
+       OgeArenaCreate(&arena, 4ull << 30) reserves 4GB of address space, OgeArenaSetUsed() and
+       OgeArenaPush() commit pages on demand and OgeArenaTrim() decommits the unused tail.
+       The data never moves, so growing costs O(new pages) instead of OgeRealloc's copy.
+       The committed bytes are counted under OGE_ALLOCATOR_ARENA with commit/decommit events.
+     - OgeMemoryFragmentationReport() prints per allocator the holes between the live blocks
+       (largest hole, external fragmentation, entropy of the free space) and a map of the
+       occupancy per size class. With a logger a "frag" record per allocator is written every
+       OGE_MEMORY_FRAG_INTERVAL frames. OgeFragmentationCompute() also works on a snapshot
+       rebuilt from a log (see LogReader.h).
      void main()
      {
          OgeMemoryReport(1);
      }
  */
+
+#ifndef __OGE_MEMORY_TYPES_H__
+#define __OGE_MEMORY_TYPES_H__
+
+// Max number of distinct call sites (file + line) tracked. Must be a power of 2.
+// When the table is full the allocations are accounted to the site 0 ("<other>").
+#ifndef OGE_MEMORY_MAX_SITES
+#   define OGE_MEMORY_MAX_SITES 4096
+#endif
+
+// Alignment of the pointers returned by OgeMalloc/OgeCalloc/OgeRealloc (same as malloc).
+// The tracking headers are multiples of it. Operator new with a bigger std::align_val_t
+// uses the aligned path.
+#define OGE_MEMORY_ALIGNMENT (2 * sizeof(void*))
+
+// Size histogram: bin n counts the allocations with a size in [2^n, 2^(n+1)[
+#define OGE_MEMORY_SIZE_BINS 40
+
+// Lifetime histogram of the freed blocks, in frames (OgeMemoryAllocatorFrame() calls):
+// bin 0 counts the blocks freed in the frame of their allocation, bin n the blocks that
+// lived [2^(n-1), 2^n[ frames. The last bin is open.
+#define OGE_MEMORY_LIFETIME_BINS 12
+
+// OgeMemoryLifetimeReport(): blocks freed within this nb of frames are short lived.
+// Rounded down to a bin boundary (2^n - 1).
+#ifndef OGE_MEMORY_SHORT_LIFETIME
+#   define OGE_MEMORY_SHORT_LIFETIME 15
+#endif
+
+// Max nb of frames kept per call stack. The depth used can be lowered at runtime
+// with OgeMemorySetStackDepth(). Only used when OGE_USE_STACK_CAPTURE is 1.
+#ifndef OGE_MEMORY_MAX_STACK_DEPTH
+#   define OGE_MEMORY_MAX_STACK_DEPTH 32
+#endif
+
+#ifndef OGE_MEMORY_STACK_DEPTH
+#   define OGE_MEMORY_STACK_DEPTH 12
+#endif
+
+// Max nb of distinct call stacks. Must be a power of 2.
+// When the table is full new stacks get the id 0 (no stack).
+#ifndef OGE_MEMORY_MAX_STACKS
+#   define OGE_MEMORY_MAX_STACKS 65536
+#endif
+
+typedef struct OgeAllocSite OgeAllocSite;
+
+// Counters of one call site. Updated by OgeMalloc/OgeCalloc/OgeRealloc/OgeFree.
+struct OgeAllocSite
+{
+    const char* file;
+    int line;
+    const void* caller; // code calling operator new when there is no file/line
+    size_t liveCount;   // nb of blocks currently allocated
+    size_t liveBytes;   // bytes currently allocated
+    size_t peakBytes;   // highest value reached by liveBytes
+    size_t totalCount;  // nb of allocations since the start
+    size_t totalBytes;  // bytes allocated since the start
+    size_t sizeBins[OGE_MEMORY_SIZE_BINS];
+    size_t lifetimeBins[OGE_MEMORY_LIFETIME_BINS]; // freed blocks by frames lived
+};
+
+enum OgeSiteSort
+{
+    OGE_SITE_SORT_LIVE_BYTES = 0,
+    OGE_SITE_SORT_LIVE_COUNT,
+    OGE_SITE_SORT_PEAK_BYTES,
+    OGE_SITE_SORT_TOTAL_COUNT,
+    OGE_SITE_SORT_TOTAL_BYTES,
+};
+
+typedef enum OgeSiteSort OgeSiteSort;
+
+// Nb of allocation events buffered per thread between two flushes (usually one frame).
+// A power of 2. The events of a thread whose buffer is full are dropped and counted.
+#ifndef OGE_MEMORY_EVENT_BUFFER
+#   define OGE_MEMORY_EVENT_BUFFER 8192
+#endif
+
+enum OgeAllocAction
+{
+    OGE_ALLOC_ADD = 0,
+    OGE_ALLOC_DEL,
+    OGE_ALLOC_COMMIT,   // pages of a virtual arena backed by memory
+    OGE_ALLOC_DECOMMIT,
+};
+
+typedef enum OgeAllocAction OgeAllocAction;
+
+typedef struct OgeAllocEvent OgeAllocEvent;
+
+// Appended by the tracker on each allocation/free while a logger exists
+struct OgeAllocEvent
+{
+    u64 address;
+    u64 size;
+    u64 tick;       // OgeMemoryTick(): orders the events of all the threads
+    u32 sequence;   // nb of the event in its thread, from 1. A gap = dropped events
+    u32 site;       // index for OgeMemoryGetSite()
+    u32 thread;     // id given to each thread on its first event
+    u16 allocator;
+    u16 action;     // OgeAllocAction
+};
+
+// Allocator ids given to OgeMallocTagged(). 0 is the allocator of the untagged allocations.
+#ifndef OGE_MEMORY_MAX_ALLOCATORS
+#   define OGE_MEMORY_MAX_ALLOCATORS 16
+#endif
+
+#define OGE_MEMORY_CACHE_LINE 64
+
+typedef struct OgeAllocatorStats OgeAllocatorStats;
+
+// Sum of the counters of all the threads for one allocator
+struct OgeAllocatorStats
+{
+    const char* name;
+    size_t liveBytes;
+    size_t liveCount;
+    size_t peakBytes;   // high-water mark of the live bytes, estimated from the sampled blocks with OGE_MEMORY_SAMPLE_RATE
+    size_t totalCount;  // nb of allocations since the start
+    size_t totalBytes;
+    size_t frameCount;  // nb of allocations during the last frame
+    size_t budget;      // 0 = no budget
+};
+
+// Called once per frame while an allocator is over its budget
+typedef void (*OgeBudgetCallback)(u16 allocator, size_t liveBytes, size_t budget);
+
+// Allocator id of the virtual arenas: the committed bytes are counted under it
+#define OGE_ALLOCATOR_ARENA (OGE_MEMORY_MAX_ALLOCATORS - 1)
+
+// Pages are committed by chunks of at least this size
+#ifndef OGE_ARENA_COMMIT_SIZE
+#   define OGE_ARENA_COMMIT_SIZE (64 * 1024)
+#endif
+
+typedef struct OgeVirtualArena OgeVirtualArena;
+
+// Reserved range of address space. Its memory is committed when 'used' grows
+// so the buffer never moves. Not thread safe: one owner per arena.
+struct OgeVirtualArena
+{
+    char* base;
+    size_t reserved;    // bytes of address space
+    size_t committed;   // bytes backed by memory from base, multiple of the page size
+    size_t used;        // bytes given by OgeArenaPush() / OgeArenaSetUsed()
+    const char* file;
+    int line;
+    u32 site;           // call site of file/line, resolved by OgeArenaCreate() (leak check only)
+};
+
+typedef struct OgeSnapshotBlock OgeSnapshotBlock;
+typedef struct OgeHeapSnapshot OgeHeapSnapshot;
+typedef struct OgeSnapshotSiteDiff OgeSnapshotSiteDiff;
+typedef struct OgeHeapSnapshotDiff OgeHeapSnapshotDiff;
+
+struct OgeSnapshotBlock
+{
+    u64 address;    // pointer returned to the user
+    u64 size;
+    u32 site;       // index for OgeMemoryGetSite()
+    u16 allocator;
+};
+
+// Tracked blocks alive when OgeMemorySnapshot() was called, sorted by address
+struct OgeHeapSnapshot
+{
+    size_t count;
+    size_t bytes;
+    OgeSnapshotBlock* blocks;
+};
+
+struct OgeSnapshotSiteDiff
+{
+    u32 site;
+    size_t newCount;
+    size_t newBytes;
+    size_t freedCount;
+    size_t freedBytes;
+    size_t grownCount;  // same address but bigger in the second snapshot
+    size_t grownBytes;
+};
+
+// Sites sorted by decreasing net growth (new + grown - freed bytes)
+struct OgeHeapSnapshotDiff
+{
+    int count;
+    OgeSnapshotSiteDiff* sites;
+    OgeSnapshotSiteDiff total; // sum of all the sites, total.site is 0
+};
+
+// Size classes and address buckets of the occupancy histogram of OgeFragmentation.
+// Class n has the sizes in [2^(n+4), 2^(n+5)[ (the first and last classes are open).
+#define OGE_FRAG_SIZE_CLASSES 16
+#define OGE_FRAG_ADDRESS_BUCKETS 32
+
+// OgeFragmentationCompute() on all the allocators
+#define OGE_ALLOCATOR_ALL 0xFFFF
+
+// Holes up to this size between two blocks are the tracking headers and the malloc
+// metadata, not free space.
+#ifndef OGE_MEMORY_FRAG_MIN_GAP
+#   define OGE_MEMORY_FRAG_MIN_GAP 128
+#endif
+
+// Holes of this size or more separate two regions (another heap, a mmap'ed block):
+// they are not free space either.
+#ifndef OGE_MEMORY_FRAG_MAX_GAP
+#   define OGE_MEMORY_FRAG_MAX_GAP (16 * 1024 * 1024)
+#endif
+
+// OgeLogUpdate() writes a "frag" record per allocator every N frames. 0 = never.
+// Can be changed with OgeMemorySetFragmentationInterval().
+#ifndef OGE_MEMORY_FRAG_INTERVAL
+#   define OGE_MEMORY_FRAG_INTERVAL 600
+#endif
+
+typedef struct OgeFragmentation OgeFragmentation;
+
+// Fragmentation of the address range of the live blocks of one allocator.
+// The range is made of regions; the free space is the holes inside the regions.
+struct OgeFragmentation
+{
+    u16 allocator;
+    u32 regionCount;
+    u64 blockCount;
+    u64 liveBytes;
+    u64 freeBytes;
+    u64 gapCount;
+    u64 largestGap;
+    u64 spanBytes;          // sum of the region sizes, for all the allocators
+    double externalRatio;   // 1 - largestGap / freeBytes: 0 = one hole, near 1 = many small holes
+    double entropy;         // bits of the distribution of the free bytes over the holes: 0 = one hole, log2(n) = n equal holes
+    u64 occupancy[OGE_FRAG_SIZE_CLASSES][OGE_FRAG_ADDRESS_BUCKETS]; // live bytes per size class and bucket of the regions laid end to end
+};
+
+#ifdef __cplusplus
+// Tracks the file and line of a C++ allocation: Foo* foo = OGE_NEW Foo(1, 2);
+#   define OGE_NEW new(__FILE__, __LINE__)
+// Same with an allocator id: Foo* foo = OGE_NEW_TAGGED(OGE_ALLOCATOR_AI) Foo(1, 2);
+#   define OGE_NEW_TAGGED(allocator) new(__FILE__, __LINE__, (u16)(allocator))
+
+void* operator new(size_t size, const char* file, int line);
+void* operator new[](size_t size, const char* file, int line);
+void  operator delete(void* p, const char* file, int line) noexcept;
+void  operator delete[](void* p, const char* file, int line) noexcept;
+void* operator new(size_t size, const char* file, int line, u16 allocator);
+void* operator new[](size_t size, const char* file, int line, u16 allocator);
+void  operator delete(void* p, const char* file, int line, u16 allocator) noexcept;
+void  operator delete[](void* p, const char* file, int line, u16 allocator) noexcept;
+#endif
+
+#endif // __OGE_MEMORY_TYPES_H__
 #ifdef OGE_MEMORY_IMPLEMENTATION
 #undef OGE_MEMORY_IMPLEMENTATION
 
- // if we've already included oge memory before, undefine the macros
-#ifdef malloc
-#   undef malloc
-#   undef calloc
-#   undef free
-#   undef realloc
-#endif
+ // if we've already included oge memory before, undefine the macros
+#ifdef malloc
+#   undef malloc
+#   undef calloc
+#   undef free
+#   undef realloc
+#endif
+
+#include <stdlib.h>
+#include <string.h> // for memcpy
+#include <math.h>   // log2
+
+// The tracked entry points are OGE_NOINLINE so OGE_RETURN_ADDRESS() is in the code allocating:
+// it names the sites of operator new and ends the tracker frames of the call stacks.
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#   define OGE_RETURN_ADDRESS() _ReturnAddress()
+#   define OGE_NOINLINE __declspec(noinline)
+#else
+#   define OGE_RETURN_ADDRESS() __builtin_return_address(0)
+#   define OGE_NOINLINE __attribute__((noinline))
+#endif
+
+//--------------- Fragmentation ---------------------
+
+// Used with or without OGE_USE_LEAK_CHECK: the snapshot can come from a log
+
+inline u32 OgeFragSizeClass(u64 size)
+{
+    u32 c = 0;
+    while (c < OGE_FRAG_SIZE_CLASSES - 1 && size >= (32ull << c))
+        c++;
+    return c;
+}
+
+// Fragmentation of the blocks of 'allocator' (OGE_ALLOCATOR_ALL for every block).
+// The holes are searched between all the blocks, whatever their allocator: a hole only
+// counts for an allocator when the blocks on both sides are its own. The regions and the
+// address buckets are the same for all the allocators so their maps can be compared.
+// The blocks of the snapshot must be sorted by address, like the ones of OgeMemorySnapshot().
+// Return false if the allocator has no block.
+bool OgeFragmentationCompute(const OgeHeapSnapshot* snapshot, u16 allocator, OgeFragmentation* frag)
+{
+    memset(frag, 0, sizeof(OgeFragmentation));
+    frag->allocator = allocator;
+    if (snapshot == NULL || snapshot->count == 0)
+        return false;
+
+    // First pass: regions, holes and the sum of g*log2(g) for the entropy
+    double gapLog = 0;
+    u64 regionStart = snapshot->blocks[0].address;
+    u64 end = regionStart;
+    u16 previous = snapshot->blocks[0].allocator;
+    frag->regionCount = 1;
+    for (size_t i = 0; i < snapshot->count; i++) {
+        const OgeSnapshotBlock* block = &snapshot->blocks[i];
+        bool mine = allocator == OGE_ALLOCATOR_ALL || block->allocator == allocator;
+
+        if (block->address > end) {
+            u64 gap = block->address - end;
+            if (gap >= OGE_MEMORY_FRAG_MAX_GAP) {
+                frag->spanBytes += end - regionStart;
+                regionStart = block->address;
+                frag->regionCount++;
+            }
+            else if (gap > OGE_MEMORY_FRAG_MIN_GAP && mine && (allocator == OGE_ALLOCATOR_ALL || previous == allocator)) {
+                frag->freeBytes += gap;
+                frag->gapCount++;
+                if (gap > frag->largestGap)
+                    frag->largestGap = gap;
+                gapLog += (double)gap * log2((double)gap);
+            }
+        }
+
+        if (mine) {
+            frag->blockCount++;
+            frag->liveBytes += block->size;
+        }
+        if (block->address + block->size > end)
+            end = block->address + block->size;
+        previous = block->allocator;
+    }
+    frag->spanBytes += end - regionStart;
+    if (frag->blockCount == 0)
+        return false;
+
+    if (frag->freeBytes > 0) {
+        double freeBytes = (double)frag->freeBytes;
+        frag->externalRatio = 1.0 - (double)frag->largestGap / freeBytes;
+        frag->entropy = log2(freeBytes) - gapLog / freeBytes;
+        if (frag->entropy < 0)
+            frag->entropy = 0;
+    }
+
+    // Second pass: occupancy, the regions are laid end to end
+    u64 base = 0;
+    regionStart = snapshot->blocks[0].address;
+    end = regionStart;
+    for (size_t i = 0; i < snapshot->count; i++) {
+        const OgeSnapshotBlock* block = &snapshot->blocks[i];
+        if (block->address > end && block->address - end >= OGE_MEMORY_FRAG_MAX_GAP) {
+            base += end - regionStart;
+            regionStart = block->address;
+        }
+        if (block->address + block->size > end)
+            end = block->address + block->size;
+        if (allocator != OGE_ALLOCATOR_ALL && block->allocator != allocator)
+            continue;
+
+        u64 position = base + (block->address - regionStart);
+        u64 bucket = frag->spanBytes > 0 ? (u64)((double)position * OGE_FRAG_ADDRESS_BUCKETS / (double)frag->spanBytes) : 0;
+        if (bucket >= OGE_FRAG_ADDRESS_BUCKETS)
+            bucket = OGE_FRAG_ADDRESS_BUCKETS - 1;
+        frag->occupancy[OgeFragSizeClass(block->size)][bucket] += block->size;
+    }
+    return true;
+}
+
+// Prints the metrics and the occupancy as a map: one line per size class,
+// one column per address bucket, from ' ' (empty) to '@' (full)
+void OgeFragmentationReport(const OgeFragmentation* frag, const char* name)
+{
+    static const char shades[] = " .:-=+*#%@";
+
+    printf("\n======  Fragmentation: allocator %u (%s) ============\n", (unsigned)frag->allocator, name != NULL ? name : "");
+    printf("blocks %llu, live %llu bytes, free %llu bytes in %llu holes, span %llu bytes in %u regions\n",
+        (unsigned long long)frag->blockCount, (unsigned long long)frag->liveBytes,
+        (unsigned long long)frag->freeBytes, (unsigned long long)frag->gapCount,
+        (unsigned long long)frag->spanBytes, frag->regionCount);
+    printf("largest hole %llu bytes, external fragmentation %.3f, free space entropy %.2f bits\n",
+        (unsigned long long)frag->largestGap, frag->externalRatio, frag->entropy);
+
+    double bucketBytes = (double)frag->spanBytes / OGE_FRAG_ADDRESS_BUCKETS;
+    for (int c = OGE_FRAG_SIZE_CLASSES - 1; c >= 0; c--) {
+        char line[OGE_FRAG_ADDRESS_BUCKETS + 1];
+        u64 classBytes = 0;
+        for (int b = 0; b < OGE_FRAG_ADDRESS_BUCKETS; b++) {
+            double fill = bucketBytes > 0 ? (double)frag->occupancy[c][b] / bucketBytes : 0;
+            int shade = frag->occupancy[c][b] == 0 ? 0 : 1 + (int)(fill * (sizeof(shades) - 3));
+            line[b] = shades[shade < (int)sizeof(shades) - 2 ? shade : (int)sizeof(shades) - 2];
+            classBytes += frag->occupancy[c][b];
+        }
+        line[OGE_FRAG_ADDRESS_BUCKETS] = '\0';
+        if (classBytes > 0)
+            printf("%8llu+ |%s| %llu bytes\n", 16ull << c, line, (unsigned long long)classBytes);
+    }
+    printf("======  End Fragmentation ============\n");
+}
+
+#   if !OGE_USE_LEAK_CHECK
+
+// Only the internal helpers are inline. The exported functions are defined once, in the
+// OGE_MEMORY_IMPLEMENTATION file, so the other translation units can link to them.
+void* OgeMalloc(size_t size)
+{
+    void* ptr = malloc(size);
+    assert(ptr != 0);
+    return ptr;
+}
+
+void* OgeCalloc(size_t size)
+{
+    void* ptr = calloc(1, size);
+    assert(ptr != 0);
+    return ptr;
+}
+
+void* OgeRealloc(void* obj, size_t size)
+{
+    void* ptr = realloc(obj, size);
+    assert(ptr != 0);
+    return ptr;
+}
+
+void* OgeMallocTagged(size_t size, u16 allocator)
+{
+    (void)allocator;
+    return OgeMalloc(size);
+}
+
+void* OgeCallocTagged(size_t size, u16 allocator)
+{
+    (void)allocator;
+    return OgeCalloc(size);
+}
+
+void OgeFree(void* obj)
+{
+    free(obj);
+}
+
+void OgeFreeSized(void* obj, size_t size)
+{
+    (void)size;
+    free(obj);
+}
+
+// Used by operator new. Returns NULL when out of memory. Nothing is tracked.
+inline void* OgeMemoryNew(size_t size, size_t alignment, u16 allocator, const char* file, int line, const void* caller)
+{
+    (void)allocator, (void)file, (void)line, (void)caller;
+    if (size == 0)
+        size = 1;
+    if (alignment <= OGE_MEMORY_ALIGNMENT)
+        return malloc(size);
+#if defined(_MSC_VER)
+    return _aligned_malloc(size, alignment);
+#else
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0)
+        return NULL;
+    return ptr;
+#endif
+}
+
+inline void OgeMemoryDeleteAligned(void* obj)
+{
+#if defined(_MSC_VER)
+    _aligned_free(obj);
+#else
+    free(obj);
+#endif
+}
+
+inline void OgeMemoryDeleteAlignedSized(void* obj, size_t size)
+{
+    (void)size;
+    OgeMemoryDeleteAligned(obj);
+}
+
+void OgeMemoryReport(int showAll)
+{
+    printf("No report because preprocessor OGE_USE_LEAK_CHECK was not set to 1.\n");
+}
+
+int OgeMemorySiteCount(void)
+{
+    return 0;
+}
+
+const OgeAllocSite* OgeMemoryGetSite(int index)
+{
+    return NULL;
+}
+
+int OgeMemoryTopSites(const OgeAllocSite** sites, int maxSites, OgeSiteSort sortBy)
+{
+    return 0;
+}
+
+void OgeMemorySiteReport(int maxSites, OgeSiteSort sortBy)
+{
+    printf("No call site report because preprocessor OGE_USE_LEAK_CHECK was not set to 1.\n");
+}
+
+void OgeMemoryLifetimeReport(int maxSites)
+{
+    printf("No lifetime report because preprocessor OGE_USE_LEAK_CHECK was not set to 1.\n");
+}
+
+void OgeMemorySetStackDepth(int depth)
+{
+}
+
+u32 OgeMemoryGetStackId(void* obj)
+{
+    return 0;
+}
+
+int OgeMemoryGetStack(u32 stackId, void** frames, int maxFrames)
+{
+    return 0;
+}
+
+void OgeMemoryPrintStack(u32 stackId)
+{
+}
+
+void OgeMemorySetSampleRate(size_t bytes)
+{
+}
+
+size_t OgeMemoryGetSampleRate(void)
+{
+    return 0;
+}
+
+OgeHeapSnapshot* OgeMemorySnapshot(void)
+{
+    return NULL;
+}
+
+void OgeMemorySnapshotFree(OgeHeapSnapshot* snapshot)
+{
+}
+
+OgeHeapSnapshotDiff* OgeMemorySnapshotDiff(const OgeHeapSnapshot* a, const OgeHeapSnapshot* b)
+{
+    return NULL;
+}
+
+void OgeMemorySnapshotDiffFree(OgeHeapSnapshotDiff* diff)
+{
+}
+
+void OgeMemorySnapshotDiffReport(const OgeHeapSnapshotDiff* diff, int maxSites)
+{
+    printf("No snapshot diff because preprocessor OGE_USE_LEAK_CHECK was not set to 1.\n");
+}
+
+void OgeMemoryFlushEvents(void)
+{
+}
+
+void OgeMemorySetAllocatorName(u16 allocator, const char* name)
+{
+}
+
+void OgeMemorySetAllocatorBudget(u16 allocator, size_t bytes)
+{
+}
+
+void OgeMemorySetBudgetCallback(OgeBudgetCallback callback)
+{
+}
+
+bool OgeMemoryGetAllocatorStats(u16 allocator, OgeAllocatorStats* stats)
+{
+    if (stats != NULL)
+        memset(stats, 0, sizeof(OgeAllocatorStats));
+    return false;
+}
+
+size_t OgeMemoryAllocatorLiveBytes(u16 allocator)
+{
+    return 0;
+}
+
+void OgeMemoryAllocatorFrame(void)
+{
+}
+
+void OgeMemoryAllocatorReport(void)
+{
+    printf("No allocator report because preprocessor OGE_USE_LEAK_CHECK was not set to 1.\n");
+}
+
+void OgeMemorySetFragmentationInterval(int frames)
+{
+}
+
+void OgeMemoryFragmentationReport(void)
+{
+    printf("No fragmentation report because preprocessor OGE_USE_LEAK_CHECK was not set to 1.\n");
+}
+
+void OgeMemoryFragmentationFrame(unsigned long frame)
+{
+}
+
+#   else // OGE_USE_LEAK_CHECK
+
+#include <time.h>   // clock_gettime when there is no rdtsc
+
+typedef struct OgeMallocInfo OgeMallocInfo;
+
+struct OgeMallocInfo
+{
+    OgeMallocInfo* next;
+    OgeMallocInfo* prev;
+    const char* file;
+    size_t size;
+    size_t weight;  // size, or the estimated bytes of a sampled block
+    int line;
+    u32 site;       // index in _allocSites
+    u32 stack;      // id in the stack table. 0 = no stack
+    u32 offset;     // from the start of the malloc'ed block (aligned blocks)
+    u16 allocator;  // OgeMallocTagged(). 0 = untagged
+    u32 frame;      // _memoryFrame at the allocation
+#if UINTPTR_MAX == 0xFFFFFFFFu
+    u32 padding;
+#endif
+};
+
+// sizeof(OgeMallocInfo) is a multiple of OGE_MEMORY_ALIGNMENT so the user pointer keeps the malloc alignment
+// (64 bytes on 64 bits, 48 bytes on 32 bits)
+static_assert(sizeof(OgeMallocInfo) % OGE_MEMORY_ALIGNMENT == 0, "OgeMallocInfo must keep the malloc alignment");
+
+static OgeMallocInfo* _mallocInfoHead;
+static size_t _mallocInfoCount; // nb of blocks in the list
+
+// Protects the block list, the call sites and the stack table. The unsampled
+// allocations, the allocator counters and the events don't take it.
+static volatile long _trackerLock;
+static size_t MallocInfoSize = sizeof(OgeMallocInfo);
+
+// Nb of OgeMemoryAllocatorFrame() calls. Only written by the thread ending the frames.
+static volatile u32 _memoryFrame;
+
+//--------------- Sampling ---------------------
+
+#if OGE_MEMORY_SAMPLE_RATE
+
+typedef struct OgeSampleTag OgeSampleTag;
+
+// Put just before the pointer returned to the user. Sampled blocks also have
+// an OgeMallocInfo before the tag: [OgeMallocInfo][OgeSampleTag][user data]
+struct OgeSampleTag
+{
+    size_t size;
+    u16 allocator;
+    u16 sampled;    // 1 when there is an OgeMallocInfo before the tag
+};
+
+static size_t SampleTagSize = sizeof(OgeSampleTag);
+static volatile size_t _sampleRate = OGE_MEMORY_SAMPLE_RATE;
+static volatile long _sampleGeneration; // incremented by OgeMemorySetSampleRate()
+
+// Bytes still to allocate by this thread before the next sample
+static OGE_THREAD_LOCAL i64 _sampleCountdown;
+static OGE_THREAD_LOCAL bool _samplerStarted;
+static OGE_THREAD_LOCAL u64 _sampleRandom;
+static OGE_THREAD_LOCAL long _sampleThreadGeneration; // _sampleGeneration of the countdown
+
+// Exponential distribution of mean _sampleRate: the distance between two
+// points of a Poisson process, so each byte has the same chance to be sampled
+inline i64 OgeMemoryNextSampleInterval()
+{
+    if (_sampleRandom == 0)
+        _sampleRandom = (u64)(size_t)&_sampleRandom ^ 0x9E3779B97F4A7C15ull;
+
+    // xorshift64*
+    _sampleRandom ^= _sampleRandom >> 12;
+    _sampleRandom ^= _sampleRandom << 25;
+    _sampleRandom ^= _sampleRandom >> 27;
+    u64 r = _sampleRandom * 0x2545F4914F6CDD1Dull;
+
+    double u = ((double)(r >> 11) + 1.0) * (1.0 / 9007199254740992.0); // ]0, 1]
+    return (i64)(-log(u) * (double)OGE_ATOMIC_LOAD(&_sampleRate)) + 1;
+}
+
+inline bool OgeMemorySampleSlow()
+{
+    // The rate changed: the countdown is drawn again with the new mean
+    long generation = OGE_ATOMIC_LOAD(&_sampleGeneration);
+    if (generation != _sampleThreadGeneration) {
+        _sampleThreadGeneration = generation;
+        _sampleCountdown = 0;
+        _samplerStarted = false;
+    }
+
+    if (!_samplerStarted) {
+        // Don't sample the first allocation of each thread
+        _samplerStarted = true;
+        _sampleCountdown += OgeMemoryNextSampleInterval();
+        if (_sampleCountdown > 0)
+            return false;
+    }
+
+    // Memoryless: the next sample point is an exponential distance after this block
+    _sampleCountdown = OgeMemoryNextSampleInterval();
+    return true;
+}
+
+// Hot path: one decrement and one test for the unsampled allocations
+inline bool OgeMemoryShouldSample(size_t size)
+{
+    _sampleCountdown -= (i64)size;
+    if (_sampleCountdown > 0)
+        return false;
+    return OgeMemorySampleSlow();
+}
+
+// A block of 'size' bytes is sampled with the probability p = 1 - exp(-size / rate)
+// so counting it as size / p bytes gives an unbiased estimate.
+inline size_t OgeMemorySampleWeight(size_t size)
+{
+    size_t rate = OGE_ATOMIC_LOAD(&_sampleRate);
+    if (size == 0 || rate == 0)
+        return size != 0 ? size : 1;
+    double p = -expm1(-(double)size / (double)rate);
+    return (size_t)((double)size / p + 0.5);
+}
+
+#endif // OGE_MEMORY_SAMPLE_RATE
+
+//--------------- Call sites ---------------------
+
+// Site 0 collects the allocations made once the table is full
+static OgeAllocSite _allocSites[OGE_MEMORY_MAX_SITES] = { { "<other>", 0 } };
+static u32 _allocSiteCount = 1;
+
+// Open addressing hash table of site indices (0 = empty slot).
+// Twice as big as _allocSites so it can never be full.
+static u32 _allocSiteTable[OGE_MEMORY_MAX_SITES * 2];
+
+#if defined(_MSC_VER)
+#   include <intrin.h> // _BitScanReverse
+#endif
+
+// Returns floor(log2(size)), i.e. the bin of the size histogram
+inline u32 OgeMemorySizeBin(size_t size)
+{
+    u32 bin;
+#if defined(_MSC_VER)
+    unsigned long index;
+#   if defined(_WIN64)
+    _BitScanReverse64(&index, (unsigned long long)size | 1);
+#   else
+    _BitScanReverse(&index, (unsigned long)size | 1);
+#   endif
+    bin = (u32)index;
+#else
+    bin = (u32)(63 - __builtin_clzll((unsigned long long)size | 1));
+#endif
+    return bin < OGE_MEMORY_SIZE_BINS ? bin : OGE_MEMORY_SIZE_BINS - 1;
+}
+
+// __FILE__ strings are unique per translation unit so the pointer is enough to identify a file.
+// 'caller' is the return address for the allocations without file/line (operator new).
+inline u32 OgeMemoryFindSite(const char* file, int line, const void* caller)
+{
+    const u32 mask = OGE_MEMORY_MAX_SITES * 2 - 1;
+    u64 hash = ((u64)(size_t)file ^ ((u64)line << 32) ^ (u64)(size_t)caller) * 0x9E3779B97F4A7C15ull;
+    u32 slot = (u32)(hash >> 40) & mask;
+
+    u32 index = _allocSiteTable[slot];
+    while (index != 0) {
+        if (_allocSites[index].line == line && _allocSites[index].file == file && _allocSites[index].caller == caller)
+            return index;
+        slot = (slot + 1) & mask;
+        index = _allocSiteTable[slot];
+    }
+
+    if (_allocSiteCount >= OGE_MEMORY_MAX_SITES)
+        return 0;
+
+    index = _allocSiteCount++;
+    _allocSites[index].file = file;
+    _allocSites[index].line = line;
+    _allocSites[index].caller = caller;
+    _allocSiteTable[slot] = index;
+    return index;
+}
+
+//--------------- Threads ---------------------
+
+typedef struct OgeAllocatorCounters OgeAllocatorCounters;
+typedef struct OgeMemoryThread OgeMemoryThread;
+
+// Counters of one allocator for one thread. Only written by their thread so they need
+// no atomics; the readers may see values a few allocations old.
+// A thread freeing blocks allocated by another thread has a negative live count.
+struct OgeAllocatorCounters
+{
+    long long liveBytes;
+    long long liveCount;
+    long long totalCount;
+    long long totalBytes;
+    char padding[OGE_MEMORY_CACHE_LINE - 4 * sizeof(long long)];
+};
+
+// Created on the first tracked allocation of each thread. Kept when the thread exits
+// so its counters and its last events are not lost.
+// The events are a ring with one writer, the thread, and one reader, OgeMemoryFlushEvents():
+// the thread never waits for the flush, it drops its events while the ring is full.
+// The indices only grow, the slot of an event is its index modulo OGE_MEMORY_EVENT_BUFFER.
+struct OgeMemoryThread
+{
+    OgeAllocatorCounters counters[OGE_MEMORY_MAX_ALLOCATORS]; // first: cache line aligned
+    OgeMemoryThread* volatile next; // see _memoryThreads
+    u32 thread;
+
+    // Written by the thread
+    volatile long busy;     // 1 while an event is filled, see OgeMemoryFlushEvents()
+    volatile u32 head;      // nb of events pushed
+    volatile u32 dropped;   // nb of events lost because the ring was full
+    u32 sequence;           // nb of events numbered, the dropped ones included
+    u32 tailCache;          // 'tail' when the thread last read it
+    char padding[OGE_MEMORY_CACHE_LINE]; // the flush writes to the next fields
+
+    // Written by the flush
+    volatile u32 tail;      // nb of events written to the log (or discarded)
+    u32 flushHead;          // 'head' read by the current flush
+    u32 droppedSeen;        // 'dropped' already counted
+    u64 lastTick;           // of the last event written
+    OgeAllocEvent events[OGE_MEMORY_EVENT_BUFFER];
+};
+
+static_assert((OGE_MEMORY_EVENT_BUFFER & (OGE_MEMORY_EVENT_BUFFER - 1)) == 0, "OGE_MEMORY_EVENT_BUFFER must be a power of 2");
+
+static OGE_THREAD_LOCAL OgeMemoryThread* _memoryThread;
+static OgeMemoryThread* volatile _memoryThreads; // only ever grows so it can be read without lock
+static volatile long _memoryThreadsLock;
+static volatile long _memoryThreadCount;
+
+inline OgeMemoryThread* OgeMemoryCreateThread()
+{
+    // Never freed: the first cache line boundary of the block is used
+    char* block = (char*)calloc(1, sizeof(OgeMemoryThread) + OGE_MEMORY_CACHE_LINE - 1);
+    if (block == NULL)
+        return NULL;
+
+    OgeMemoryThread* thread = (OgeMemoryThread*)(((size_t)block + OGE_MEMORY_CACHE_LINE - 1) & ~(size_t)(OGE_MEMORY_CACHE_LINE - 1));
+    thread->thread = (u32)OGE_ATOMIC_INCREMENT(&_memoryThreadCount);
+
+    OgeSpinLock(&_memoryThreadsLock);
+    thread->next = _memoryThreads;
+    (void)OGE_ATOMIC_EXCHANGE_POINTER(&_memoryThreads, thread); // published once filled
+    OgeSpinUnlock(&_memoryThreadsLock);
+
+    _memoryThread = thread;
+    return thread;
+}
+
+inline OgeMemoryThread* OgeMemoryCurrentThread()
+{
+    OgeMemoryThread* thread = _memoryThread;
+    return thread != NULL ? thread : OgeMemoryCreateThread();
+}
+
+//--------------- Allocators ---------------------
+
+typedef struct OgeAllocatorInfo OgeAllocatorInfo;
+
+// Updated by OgeMemoryAllocatorFrame(), the queries only read it.
+// trackedBytes and peakBytes are updated under _trackerLock.
+struct OgeAllocatorInfo
+{
+    const char* name;
+    size_t budget;
+    size_t trackedBytes;    // live bytes of the tracked blocks (weights when sampling) and arena commits
+    volatile size_t peakBytes; // highest trackedBytes, read by the queries without the lock
+    size_t frameStartCount; // totalCount at the start of the frame
+    size_t frameCount;      // allocations during the last frame
+};
+
+static OgeAllocatorInfo _allocators[OGE_MEMORY_MAX_ALLOCATORS] = { { "default" } };
+
+// Called with _trackerLock held
+inline void OgeMemoryPeakAdd(u16 allocator, size_t bytes)
+{
+    OgeAllocatorInfo* info = &_allocators[allocator];
+    info->trackedBytes += bytes;
+    if (info->trackedBytes > info->peakBytes)
+        OGE_ATOMIC_STORE_RELEASE(&info->peakBytes, info->trackedBytes);
+}
+
+inline void OgeMemoryPeakRemove(u16 allocator, size_t bytes)
+{
+    _allocators[allocator].trackedBytes -= bytes;
+}
+static OgeBudgetCallback _budgetCallback;
+
+// Hot path: a few adds in cache lines only written by this thread
+inline void OgeMemoryCountAdd(u16 allocator, size_t size)
+{
+    OgeMemoryThread* thread = OgeMemoryCurrentThread();
+    if (thread == NULL)
+        return;
+    OgeAllocatorCounters* counters = &thread->counters[allocator];
+    counters->liveBytes += (long long)size;
+    counters->liveCount++;
+    counters->totalCount++;
+    counters->totalBytes += (long long)size;
+}
+
+inline void OgeMemoryCountRemove(u16 allocator, size_t size)
+{
+    OgeMemoryThread* thread = OgeMemoryCurrentThread();
+    if (thread == NULL)
+        return;
+    OgeAllocatorCounters* counters = &thread->counters[allocator];
+    counters->liveBytes -= (long long)size;
+    counters->liveCount--;
+}
+
+inline u16 OgeMemoryCheckAllocator(u16 allocator)
+{
+    assert(allocator < OGE_MEMORY_MAX_ALLOCATORS);
+    return allocator < OGE_MEMORY_MAX_ALLOCATORS ? allocator : 0;
+}
+
+//--------------- Allocation events ---------------------
+
+static const char* _allocActionNames[] = { "add", "del", "commit", "decommit" };
+static volatile long _eventWriteLock;   // one flush at a time
+
+// Clock of the events, shared by all the cores (invariant TSC on x86). The fence keeps the
+// read after the previous instructions, i.e. after the 'busy' flag of OgeMemoryPushEvent().
+inline u64 OgeMemoryTick()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_lfence();
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_lfence();
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+#endif
+}
+
+// Order of the events of two threads: by tick, a free before an allocation of the same tick
+// (the free of a block comes before the reuse of its address), then by thread
+inline bool OgeMemoryEventBefore(const OgeAllocEvent* a, const OgeAllocEvent* b)
+{
+    if (a->tick != b->tick)
+        return a->tick < b->tick;
+    if ((a->action == OGE_ALLOC_DEL) != (b->action == OGE_ALLOC_DEL))
+        return a->action == OGE_ALLOC_DEL;
+    return a->thread < b->thread;
+}
+
+// Writes the events of the threads from 'head' with a tick below 'limit', merged by
+// OgeMemoryEventBefore() (the events of one thread keep their order). They are discarded
+// and counted as dropped when there is no log file. Returns the nb of events discarded.
+// The caller holds _eventWriteLock and has set the 'flushHead' of the threads.
+// O(nb of events * nb of threads): the threads are few compared to the cost of a record.
+inline u64 OgeMemoryWriteEvents(OgeMemoryThread* head, u64 limit)
+{
+    const u32 mask = OGE_MEMORY_EVENT_BUFFER - 1;
+    bool log = _ogeLogger != NULL && _ogeLogger->logFile != NULL;
+    u64 discarded = 0;
+    for (;;) {
+        OgeMemoryThread* next = NULL;
+        for (OgeMemoryThread* thread = head; thread != NULL; thread = thread->next) {
+            if (thread->tail == thread->flushHead || thread->events[thread->tail & mask].tick >= limit)
+                continue;
+            if (next == NULL || OgeMemoryEventBefore(&thread->events[thread->tail & mask], &next->events[next->tail & mask]))
+                next = thread;
+        }
+        if (next == NULL)
+            break;
+
+        const OgeAllocEvent* event = &next->events[next->tail & mask];
+        next->lastTick = event->tick;
+        if (log) {
+            const OgeAllocSite* site = &_allocSites[event->site];
+            OgeLogAllocEvent(event->allocator, _allocActionNames[event->action], (long)event->address, (long)event->size,
+                site->file, site->line, event->sequence, event->thread);
+        }
+        else
+            discarded++;
+        // The slot is given back to the thread once read
+        OGE_ATOMIC_STORE_RELEASE(&next->tail, next->tail + 1);
+    }
+    return discarded;
+}
+
+// Writes the buffered events of all the threads to the log in the order they happened.
+// Called by OgeLogUpdate() and OgeLogCloseFile(), never by an allocation.
+// An event is only written once no event can still get a smaller tick: the flush reads the
+// clock, then the 'busy' flag and the ring of each thread. A thread that wasn't busy gives
+// its next events a later tick. A busy thread gives its current event a tick at least the
+// one of its previous event, so the events from there are kept for the next flush.
+void OgeMemoryFlushEvents(void)
+{
+    OgeSpinLock(&_eventWriteLock);
+
+    u64 limit = OgeMemoryTick();
+    OGE_MEMORY_BARRIER();
+
+    // The threads created from now on have their events after 'limit'
+    OgeMemoryThread* head = OGE_ATOMIC_LOAD_ACQUIRE(&_memoryThreads);
+    u64 dropped = 0;
+    for (OgeMemoryThread* thread = head; thread != NULL; thread = thread->next) {
+        bool busy = OGE_ATOMIC_LOAD_ACQUIRE(&thread->busy) != 0;
+        thread->flushHead = OGE_ATOMIC_LOAD_ACQUIRE(&thread->head);
+        if (busy) {
+            u64 last = thread->flushHead != thread->tail ? thread->events[(thread->flushHead - 1) & (OGE_MEMORY_EVENT_BUFFER - 1)].tick : thread->lastTick;
+            if (last < limit)
+                limit = last;
+        }
+
+        u32 lost = OGE_ATOMIC_LOAD(&thread->dropped);
+        dropped += lost - thread->droppedSeen;
+        thread->droppedSeen = lost;
+    }
+
+    u64 discarded = OgeMemoryWriteEvents(head, limit);
+    OgeSpinUnlock(&_eventWriteLock);
+
+    if (_ogeLogger != NULL) {
+        _ogeLogger->droppedRecords += dropped + discarded;
+        if (dropped > 0 && _ogeLogger->logFile != NULL) {
+            char text[128];
+            snprintf(text, sizeof(text), "%llu allocation events dropped: full event buffers (OGE_MEMORY_EVENT_BUFFER)", (unsigned long long)dropped);
+            OgeLogMessage(OGE_LOG_ERROR, text, __FILE__, __LINE__);
+        }
+    }
+}
+
+// Hot path: no lock and no write shared with the other threads. The event is numbered even
+// when dropped so the gap shows in the log.
+inline void OgeMemoryPushEvent(u16 action, u16 allocator, const void* address, size_t size, u32 site)
+{
+    OgeMemoryThread* thread = OgeMemoryCurrentThread();
+    if (thread == NULL)
+        return;
+
+    u32 sequence = ++thread->sequence;
+    u32 head = thread->head;
+    if (head - thread->tailCache == OGE_MEMORY_EVENT_BUFFER) {
+        thread->tailCache = OGE_ATOMIC_LOAD_ACQUIRE(&thread->tail);
+        if (head - thread->tailCache == OGE_MEMORY_EVENT_BUFFER) {
+            OGE_ATOMIC_STORE_RELEASE(&thread->dropped, thread->dropped + 1);
+            return;
+        }
+    }
+
+    // 'busy' is visible before the tick is read, see OgeMemoryFlushEvents()
+    OGE_ATOMIC_STORE_RELEASE(&thread->busy, 1);
+    OGE_MEMORY_BARRIER();
+    OgeAllocEvent* event = &thread->events[head & (OGE_MEMORY_EVENT_BUFFER - 1)];
+    event->address = (u64)(size_t)address;
+    event->size = (u64)size;
+    event->tick = OgeMemoryTick();
+    event->sequence = sequence;
+    event->site = site;
+    event->thread = thread->thread;
+    event->allocator = allocator;
+    event->action = action;
+    OGE_ATOMIC_STORE_RELEASE(&thread->head, head + 1);
+    OGE_ATOMIC_STORE_RELEASE(&thread->busy, 0);
+}
+
+// Nb of blocks a block stands for: 1 unless sampled
+inline size_t OgeMemoryWeightCount(size_t size, size_t weight)
+{
+    if (weight == size || size == 0)
+        return 1;
+    size_t count = (weight + size / 2) / size;
+    return count != 0 ? count : 1;
+}
+
+// 'weight' is the size, or the estimated bytes of a sampled block
+inline void OgeMemorySiteAdd(u32 index, size_t size, size_t weight)
+{
+    OgeAllocSite* site = &_allocSites[index];
+    size_t count = OgeMemoryWeightCount(size, weight);
+    site->liveCount += count;
+    site->liveBytes += weight;
+    site->totalCount += count;
+    site->totalBytes += weight;
+    if (site->liveBytes > site->peakBytes)
+        site->peakBytes = site->liveBytes;
+    site->sizeBins[OgeMemorySizeBin(size)] += count;
+}
+
+// Returns 0 for 0 frames, otherwise 1 + floor(log2(frames))
+inline u32 OgeMemoryLifetimeBin(u32 frames)
+{
+    u32 bin = frames == 0 ? 0 : 1 + OgeMemorySizeBin(frames);
+    return bin < OGE_MEMORY_LIFETIME_BINS ? bin : OGE_MEMORY_LIFETIME_BINS - 1;
+}
+
+// 'frames' is the nb of frames the block lived
+inline void OgeMemorySiteRemove(u32 index, size_t size, size_t weight, u32 frames)
+{
+    OgeAllocSite* site = &_allocSites[index];
+    size_t count = OgeMemoryWeightCount(size, weight);
+    site->liveCount -= count;
+    site->liveBytes -= weight;
+    site->lifetimeBins[OgeMemoryLifetimeBin(frames)] += count;
+}
+
+//--------------- Call stacks ---------------------
+
+#if OGE_USE_STACK_CAPTURE
+
+#if defined(_MSC_VER)
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>  // RtlCaptureStackBackTrace
+#   include <dbghelp.h>  // SymFromAddr
+#   pragma comment(lib, "dbghelp.lib")
+#else
+#   include <pthread.h> // stack range of the thread
+#   if defined(__GLIBC__) || defined(__APPLE__)
+#       include <execinfo.h> // backtrace_symbols
+#   endif
+#endif
+
+// Max nb of frames of the tracker itself (OgeMemoryTrack() up to the entry point):
+// they are captured on top of the stack depth and dropped.
+#define OGE_MEMORY_TRACKER_FRAMES 8
+
+typedef struct OgeStackEntry OgeStackEntry;
+
+struct OgeStackEntry
+{
+    u64 hash;
+    u32 firstFrame; // index in _stackFrames
+    u32 depth;
+};
+
+static int _stackDepth = OGE_MEMORY_STACK_DEPTH;
+
+// Stack ids are indices in _stackEntries. Entry 0 is the 'no stack' id.
+static OgeStackEntry* _stackEntries;
+static u32 _stackCount = 1;
+static u32* _stackTable;     // open addressing, twice the nb of entries
+static void** _stackFrames;  // frames of all stacks one after the other
+static u32 _stackFrameCount;
+
+#if !defined(_MSC_VER)
+// Stack range of the thread, read once per thread. 0 when unknown.
+static OGE_THREAD_LOCAL char* _stackLow;
+static OGE_THREAD_LOCAL char* _stackHigh;
+static OGE_THREAD_LOCAL bool _stackRangeRead;
+
+inline void OgeMemoryReadStackRange()
+{
+    _stackRangeRead = true;
+#if defined(__GLIBC__)
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        void* low;
+        size_t size;
+        if (pthread_attr_getstack(&attr, &low, &size) == 0) {
+            _stackLow = (char*)low;
+            _stackHigh = (char*)low + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+#elif defined(__APPLE__)
+    _stackHigh = (char*)pthread_get_stackaddr_np(pthread_self());
+    _stackLow = _stackHigh - pthread_get_stacksize_np(pthread_self());
+#endif
+}
+#endif
+
+// Walks the frame pointer chain: each frame starts with the caller frame pointer
+// followed by the return address (x86, x64 and ARM64 frame records).
+// On MSVC x64 there is no frame pointer chain; RtlCaptureStackBackTrace uses the unwind tables.
+OGE_NOINLINE inline int OgeMemoryCaptureStack(void** frames, int maxDepth, int skip)
+{
+#if defined(_MSC_VER)
+    return (int)RtlCaptureStackBackTrace((DWORD)(skip + 1), (DWORD)maxDepth, frames, NULL);
+#else
+    if (!_stackRangeRead)
+        OgeMemoryReadStackRange();
+
+    void** fp = (void**)__builtin_frame_address(0);
+    int depth = 0;
+
+    while (fp != NULL && depth < maxDepth) {
+        void** next = (void**)fp[0];
+        void* ret = fp[1];
+        if (ret == NULL)
+            break;
+
+        if (skip > 0)
+            skip--;
+        else
+            frames[depth++] = ret;
+
+        // The stack grows down: the caller frame must be above ours, aligned and in the stack of
+        // the thread (or not too far when its range is unknown). Stops on code built without frame
+        // pointers instead of reading random memory.
+        if (next <= fp || ((size_t)next & (sizeof(void*) - 1)) != 0)
+            break;
+        if (_stackHigh != NULL ? (char*)(next + 2) > _stackHigh : (char*)next - (char*)fp > 1024 * 1024)
+            break;
+        fp = next;
+    }
+
+    return depth;
+#endif
+}
+
+// Drops the frames of the tracker, the ones before 'caller' (the return address of the entry
+// point), and keeps at most maxDepth frames. All the frames are kept when 'caller' isn't found.
+inline int OgeMemoryTrimStack(void** frames, int depth, const void* caller, int maxDepth)
+{
+    int first = 0;
+    for (int i = 0; i < depth && i <= OGE_MEMORY_TRACKER_FRAMES; i++) {
+        if (frames[i] == caller) {
+            first = i;
+            break;
+        }
+    }
+
+    depth -= first;
+    if (depth > maxDepth)
+        depth = maxDepth;
+    memmove(frames, frames + first, sizeof(void*) * depth);
+    return depth;
+}
+
+// FNV-1a on the return addresses
+inline u64 OgeMemoryStackHash(void** frames, int depth)
+{
+    u64 hash = 0xCBF29CE484222325ull;
+    for (int i = 0; i < depth; i++) {
+        hash ^= (u64)(size_t)frames[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Returns the id of the stack. Identical stacks share the same id.
+// The caller holds _trackerLock; 'hash' is OgeMemoryStackHash(frames, depth).
+inline u32 OgeMemoryFindStack(void** frames, int depth, u64 hash)
+{
+    if (depth <= 0)
+        return 0;
+
+    if (_stackEntries == NULL) {
+        _stackEntries = (OgeStackEntry*)malloc(sizeof(OgeStackEntry) * OGE_MEMORY_MAX_STACKS);
+        _stackTable = (u32*)calloc(OGE_MEMORY_MAX_STACKS * 2, sizeof(u32));
+        _stackFrames = (void**)malloc(sizeof(void*) * OGE_MEMORY_MAX_STACKS * OGE_MEMORY_STACK_DEPTH);
+        if (_stackEntries == NULL || _stackTable == NULL || _stackFrames == NULL)
+            return 0;
+    }
+
+    const u32 mask = OGE_MEMORY_MAX_STACKS * 2 - 1;
+    u32 slot = (u32)(hash ^ (hash >> 32)) & mask;
+
+    u32 id = _stackTable[slot];
+    while (id != 0) {
+        OgeStackEntry* entry = &_stackEntries[id];
+        if (entry->hash == hash && entry->depth == (u32)depth
+            && memcmp(&_stackFrames[entry->firstFrame], frames, sizeof(void*) * depth) == 0)
+            return id;
+        slot = (slot + 1) & mask;
+        id = _stackTable[slot];
+    }
+
+    if (_stackCount >= OGE_MEMORY_MAX_STACKS
+        || _stackFrameCount + depth > OGE_MEMORY_MAX_STACKS * OGE_MEMORY_STACK_DEPTH)
+        return 0;
+
+    id = _stackCount++;
+    _stackEntries[id].hash = hash;
+    _stackEntries[id].depth = (u32)depth;
+    _stackEntries[id].firstFrame = _stackFrameCount;
+    memcpy(&_stackFrames[_stackFrameCount], frames, sizeof(void*) * depth);
+    _stackFrameCount += depth;
+    _stackTable[slot] = id;
+    return id;
+}
+
+#endif // OGE_USE_STACK_CAPTURE
+
+// 0 disables the capture. Clamped to OGE_MEMORY_MAX_STACK_DEPTH.
+void OgeMemorySetStackDepth(int depth)
+{
+#if OGE_USE_STACK_CAPTURE
+    _stackDepth = depth < 0 ? 0 : (depth > OGE_MEMORY_MAX_STACK_DEPTH ? OGE_MEMORY_MAX_STACK_DEPTH : depth);
+#endif
+}
+
+int OgeMemoryGetStack(u32 stackId, void** frames, int maxFrames)
+{
+#if OGE_USE_STACK_CAPTURE
+    if (stackId == 0 || stackId >= _stackCount)
+        return 0;
+    OgeStackEntry* entry = &_stackEntries[stackId];
+    int depth = (int)entry->depth < maxFrames ? (int)entry->depth : maxFrames;
+    memcpy(frames, &_stackFrames[entry->firstFrame], sizeof(void*) * depth);
+    return depth;
+#else
+    return 0;
+#endif
+}
+
+// Resolves the symbols: slow, only call it for reports
+void OgeMemoryPrintStack(u32 stackId)
+{
+#if OGE_USE_STACK_CAPTURE
+    void* frames[OGE_MEMORY_MAX_STACK_DEPTH];
+    int depth = OgeMemoryGetStack(stackId, frames, OGE_MEMORY_MAX_STACK_DEPTH);
+    if (depth == 0)
+        return;
+
+#if defined(_MSC_VER)
+    static bool symInitialized = false;
+    HANDLE process = GetCurrentProcess();
+    if (!symInitialized) {
+        SymSetOptions(SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES | SYMOPT_UNDNAME);
+        symInitialized = SymInitialize(process, NULL, TRUE) == TRUE;
+    }
+
+    char buffer[sizeof(SYMBOL_INFO) + 256];
+    SYMBOL_INFO* symbol = (SYMBOL_INFO*)buffer;
+    IMAGEHLP_LINE64 fileLine;
+    DWORD displacement;
+
+    for (int i = 0; i < depth; i++) {
+        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+        symbol->MaxNameLen = 255;
+        fileLine.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+
+        if (SymFromAddr(process, (DWORD64)frames[i], NULL, symbol)) {
+            if (SymGetLineFromAddr64(process, (DWORD64)frames[i], &displacement, &fileLine))
+                printf("        at %s  %s (%d)\n", symbol->Name, fileLine.FileName, (int)fileLine.LineNumber);
+            else
+                printf("        at %s\n", symbol->Name);
+        }
+        else {
+            printf("        at %p\n", frames[i]);
+        }
+    }
+#elif defined(__GLIBC__) || defined(__APPLE__)
+    char** symbols = backtrace_symbols(frames, depth);
+    for (int i = 0; i < depth; i++)
+        printf("        at %s\n", symbols != NULL ? symbols[i] : "?");
+    free(symbols);
+#else
+    for (int i = 0; i < depth; i++)
+        printf("        at %p\n", frames[i]);
+#endif
+#endif // OGE_USE_STACK_CAPTURE
+}
+
+// Returns the header of a tracked block; NULL if the block was not sampled
+inline OgeMallocInfo* OgeMemoryGetInfo(void* obj)
+{
+#if OGE_MEMORY_SAMPLE_RATE
+    OgeSampleTag* tag = (OgeSampleTag*)obj - 1;
+    return tag->sampled ? (OgeMallocInfo*)tag - 1 : NULL;
+#else
+    return (OgeMallocInfo*)obj - 1;
+#endif
+}
+
+inline size_t OgeMemoryBlockSize(void* obj)
+{
+#if OGE_MEMORY_SAMPLE_RATE
+    return ((OgeSampleTag*)obj - 1)->size;
+#else
+    return ((OgeMallocInfo*)obj - 1)->size;
+#endif
+}
+
+inline u16 OgeMemoryBlockAllocator(void* obj)
+{
+#if OGE_MEMORY_SAMPLE_RATE
+    return ((OgeSampleTag*)obj - 1)->allocator;
+#else
+    return ((OgeMallocInfo*)obj - 1)->allocator;
+#endif
+}
+
+u32 OgeMemoryGetStackId(void* obj)
+{
+    if (obj == NULL)
+        return 0;
+    OgeMallocInfo* mi = OgeMemoryGetInfo(obj);
+    return mi != NULL ? mi->stack : 0;
+}
+
+// Pointer returned to the user for a tracked block
+inline void* OgeMemoryUserPointer(OgeMallocInfo* mi)
+{
+#if OGE_MEMORY_SAMPLE_RATE
+    return (OgeSampleTag*)(mi + 1) + 1;
+#else
+    return mi + 1;
+#endif
+}
+
+// Fills the header of a new block, links it and returns the user pointer.
+// 'weight' is the size, or the estimated bytes of a sampled block.
+inline void* OgeMemoryTrack(OgeMallocInfo* ptr, size_t size, size_t weight, u16 allocator, const char* file, int line, const void* caller)
+{
+#if OGE_MEMORY_SAMPLE_RATE
+    OgeSampleTag* tag = (OgeSampleTag*)(ptr + 1);
+    tag->size = size;
+    tag->allocator = allocator;
+    tag->sampled = 1;
+#endif
+
+    ptr->file = file;
+    ptr->line = line;
+    ptr->offset = 0;
+    ptr->weight = weight;
+    ptr->allocator = allocator;
+    ptr->size = size;
+    ptr->frame = _memoryFrame;
+
+#if OGE_USE_STACK_CAPTURE
+    // The walk and the hash are done before taking the lock: only the stack table needs it.
+    // The first frame kept is 'caller', in the code allocating.
+    void* frames[OGE_MEMORY_MAX_STACK_DEPTH + OGE_MEMORY_TRACKER_FRAMES];
+    int depth = 0;
+    if (_stackDepth > 0) {
+        depth = OgeMemoryCaptureStack(frames, _stackDepth + OGE_MEMORY_TRACKER_FRAMES, 0);
+        depth = OgeMemoryTrimStack(frames, depth, caller, _stackDepth);
+    }
+    u64 stackHash = OgeMemoryStackHash(frames, depth);
+#endif
+
+    OgeSpinLock(&_trackerLock);
+    // The sites with a line are keyed by file:line, the others (operator new) by caller
+    ptr->site = OgeMemoryFindSite(file, line, line == 0 ? caller : NULL);
+    OgeMemorySiteAdd(ptr->site, size, weight);
+    OgeMemoryPeakAdd(allocator, weight);
+#if OGE_USE_STACK_CAPTURE
+    ptr->stack = OgeMemoryFindStack(frames, depth, stackHash);
+#else
+    ptr->stack = 0;
+#endif
+
+    ptr->next = _mallocInfoHead;
+    if (_mallocInfoHead)
+        ptr->next->prev = ptr;
+    ptr->prev = NULL;
+    _mallocInfoHead = ptr;
+    _mallocInfoCount++;
+    OgeSpinUnlock(&_trackerLock);
+
+    if (_ogeLogger != NULL) {
+        OgeMemoryPushEvent(OGE_ALLOC_ADD, allocator, ptr, size, ptr->site);
+    }
+
+#if OGE_MEMORY_SAMPLE_RATE
+    return tag + 1;
+#else
+    return ptr + 1;
+#endif
+}
+
+// Common path of all the allocations. Returns NULL when out of memory.
+inline void* OgeMemoryAllocate(size_t size, size_t alignment, bool zero, u16 allocator, const char* file, int line, const void* caller)
+{
+    size_t headerSize = MallocInfoSize;
+    size_t weight = size;
+
+    allocator = OgeMemoryCheckAllocator(allocator);
+
+#if OGE_MEMORY_SAMPLE_RATE
+    headerSize += SampleTagSize;
+
+    // Over-aligned blocks are always tracked: the tag has no room for the alignment offset
+    if (alignment <= OGE_MEMORY_ALIGNMENT) {
+        if (!OgeMemoryShouldSample(size)) {
+            OgeSampleTag* tag = (OgeSampleTag*)(zero ? calloc(1, size + SampleTagSize) : malloc(size + SampleTagSize));
+            if (tag == NULL) return 0;
+            tag->size = size;
+            tag->allocator = allocator;
+            tag->sampled = 0;
+            OgeMemoryCountAdd(allocator, size);
+            return tag + 1;
+        }
+        weight = OgeMemorySampleWeight(size);
+    }
+#endif
+
+    void* obj;
+    if (alignment <= OGE_MEMORY_ALIGNMENT) {
+        OgeMallocInfo* ptr = (OgeMallocInfo*)(zero ? calloc(1, size + headerSize) : malloc(size + headerSize));
+        if (ptr == NULL) return 0;
+        obj = OgeMemoryTrack(ptr, size, weight, allocator, file, line, caller);
+    }
+    else {
+        // Aligned: the header is put just before the aligned user pointer
+        char* block = (char*)malloc(size + headerSize + alignment - 1);
+        if (block == NULL) return 0;
+
+        size_t user = ((size_t)block + headerSize + alignment - 1) & ~(size_t)(alignment - 1);
+        OgeMallocInfo* ptr = (OgeMallocInfo*)(user - headerSize);
+        if (zero)
+            memset((void*)user, 0, size);
+
+        obj = OgeMemoryTrack(ptr, size, weight, allocator, file, line, caller);
+        ptr->offset = (u32)((char*)ptr - block);
+    }
+
+    OgeMemoryCountAdd(allocator, size);
+    return obj;
+}
+
+OGE_NOINLINE void* OgeMalloc(size_t size, const char* file, int line)
+{
+    void* ptr = OgeMemoryAllocate(size, 0, false, 0, file, line, OGE_RETURN_ADDRESS());
+    assert(ptr != 0);
+    return ptr;
+}
+
+OGE_NOINLINE void* OgeCalloc(size_t size, const char* file, int line)
+{
+    void* ptr = OgeMemoryAllocate(size, 0, true, 0, file, line, OGE_RETURN_ADDRESS());
+    assert(ptr != 0);
+    return ptr;
+}
+
+// 'allocator' is an id in [0, OGE_MEMORY_MAX_ALLOCATORS[
+OGE_NOINLINE void* OgeMallocTagged(size_t size, u16 allocator, const char* file, int line)
+{
+    void* ptr = OgeMemoryAllocate(size, 0, false, allocator, file, line, OGE_RETURN_ADDRESS());
+    assert(ptr != 0);
+    return ptr;
+}
+
+OGE_NOINLINE void* OgeCallocTagged(size_t size, u16 allocator, const char* file, int line)
+{
+    void* ptr = OgeMemoryAllocate(size, 0, true, allocator, file, line, OGE_RETURN_ADDRESS());
+    assert(ptr != 0);
+    return ptr;
+}
+
+// Unlinks a tracked block and frees it. 'size' is the one of the header, or the one given
+// by the compiler to a sized delete.
+inline void OgeMemoryUntrack(OgeMallocInfo* mi, size_t size)
+{
+    if (_ogeLogger != NULL && _ogeLogger->logFile != 0) {
+        OgeMemoryPushEvent(OGE_ALLOC_DEL, mi->allocator, mi, size, mi->site);
+    }
+
+    OgeMemoryCountRemove(mi->allocator, size);
+
+    OgeSpinLock(&_trackerLock);
+    OgeMemorySiteRemove(mi->site, size, mi->weight, _memoryFrame - mi->frame);
+    OgeMemoryPeakRemove(mi->allocator, mi->weight);
+
+    mi->size = ~size; // flipps the bits
+    if (mi->prev != NULL)
+        mi->prev->next = mi->next;
+    if (mi->next)
+        mi->next->prev = mi->prev;
+
+    if (_mallocInfoHead == mi)
+        _mallocInfoHead = mi->next;
+    _mallocInfoCount--;
+    OgeSpinUnlock(&_trackerLock);
+
+    free((char*)mi - mi->offset);
+}
+
+#if OGE_MEMORY_SAMPLE_RATE
+inline void OgeMemoryFreeUnsampled(OgeSampleTag* tag, size_t size)
+{
+    OgeMemoryCountRemove(tag->allocator, size);
+    free(tag);
+}
+#endif
+
+void OgeFree(void* obj)
+{
+    if (obj == NULL)
+        return;
+
+#if OGE_MEMORY_SAMPLE_RATE
+    OgeSampleTag* tag = (OgeSampleTag*)obj - 1;
+    if (!tag->sampled) {
+        OgeMemoryFreeUnsampled(tag, tag->size);
+        return;
+    }
+#endif
+
+    OgeMallocInfo* mi = OgeMemoryGetInfo(obj);
+    OgeMemoryUntrack(mi, mi->size);
+}
+
+// Sized delete: the counters of the allocator and of the call site and the event use the
+// size given by the compiler, the size of the header isn't read. An unsampled block only
+// reads the sampled flag and the allocator of its tag.
+void OgeFreeSized(void* obj, size_t size)
+{
+    if (obj == NULL)
+        return;
+
+#if OGE_MEMORY_SAMPLE_RATE
+    OgeSampleTag* tag = (OgeSampleTag*)obj - 1;
+    if (!tag->sampled) {
+        OgeMemoryFreeUnsampled(tag, size);
+        return;
+    }
+#endif
+
+    OgeMemoryUntrack(OgeMemoryGetInfo(obj), size);
+}
+
+// Used by operator new. Returns NULL when out of memory.
+inline void* OgeMemoryNew(size_t size, size_t alignment, u16 allocator, const char* file, int line, const void* caller)
+{
+    return OgeMemoryAllocate(size, alignment, false, allocator, file, line, caller);
+}
+
+inline void OgeMemoryDeleteAligned(void* obj)
+{
+    OgeFree(obj);
+}
+
+inline void OgeMemoryDeleteAlignedSized(void* obj, size_t size)
+{
+    OgeFreeSized(obj, size);
+}
+
+OGE_NOINLINE void* OgeRealloc(void* obj, size_t size, const char* file, int line)
+{
+    if (obj == NULL)
+    {
+        void* ptr = OgeMemoryAllocate(size, 0, false, 0, file, line, OGE_RETURN_ADDRESS());
+        assert(ptr != 0);
+        return ptr;
+    }
+    else if (size == 0)
+    {
+        OgeFree(obj);
+        obj = NULL;
+        return NULL;
+    }
+    else
+    {
+        // LATER What should we do with the original file/line? Concatenate?
+
+        size_t oldSize = OgeMemoryBlockSize(obj);
+        if (size <= oldSize)
+        {
+            return obj;
+        }
+        else
+        {
+            // The new block stays in the allocator of the old one
+            void* ptr = OgeMemoryAllocate(size, 0, false, OgeMemoryBlockAllocator(obj), file, line, OGE_RETURN_ADDRESS());
+            assert(ptr != 0);
+            if (ptr)
+            {
+                memcpy(ptr, obj, oldSize);
+                OgeFree(obj);
+                obj = NULL;
+            }
+            return ptr;
+        }
+    }
+}
+
+// Only changes the rate of the sampling builds (OGE_MEMORY_SAMPLE_RATE > 0).
+// The calling thread uses it from its next allocation, the other threads once their
+// current countdown runs out.
+void OgeMemorySetSampleRate(size_t bytes)
+{
+#if OGE_MEMORY_SAMPLE_RATE
+    OGE_ATOMIC_STORE_RELEASE(&_sampleRate, bytes);
+    OGE_ATOMIC_INCREMENT(&_sampleGeneration);
+    _sampleCountdown = 0;
+#endif
+}
+
+size_t OgeMemoryGetSampleRate(void)
+{
+#if OGE_MEMORY_SAMPLE_RATE
+    return OGE_ATOMIC_LOAD(&_sampleRate);
+#else
+    return 0;
+#endif
+}
+
+// LATER fprintf version
+inline void OgeInternalPrint(const char* str, OgeMallocInfo* omi)
+{
+    // The size of a freed block has its bits flipped
+    long long size = (ptrdiff_t)omi->size >= 0 ? (long long)omi->size : (long long)~omi->size;
+    printf("%s: %s (%4d) : %16lld bytes at %p\n", str, omi->file, omi->line, size, OgeMemoryUserPointer(omi));
+}
+
+void OgeMemoryReport(int showAll)
+{
+    printf("\n======  Memory Report ============\n");
+
+    OgeSpinLock(&_trackerLock);
+    OgeMallocInfo* omi = _mallocInfoHead;
+    while (omi)
+    {
+        if ((ptrdiff_t)omi->size >= 0) {
+            OgeInternalPrint("LEAK!", omi);
+            OgeMemoryPrintStack(omi->stack);
+        }
+        omi = omi->next;
+    }
+
+    if (showAll != 1) {
+        OgeSpinUnlock(&_trackerLock);
+        return;
+    }
+
+    omi = _mallocInfoHead;
+    while (omi)
+    {
+        if ((ptrdiff_t)omi->size < 0)
+            OgeInternalPrint("Freed", omi);
+        omi = omi->next;
+    }
+    OgeSpinUnlock(&_trackerLock);
+
+    printf("\n======  End Memory Report ============\n");
+}
+
+int OgeMemorySiteCount(void)
+{
+    return (int)_allocSiteCount;
+}
+
+// "file (line)" or "operator new [caller address]"
+inline const char* OgeMemorySiteName(const OgeAllocSite* site, char* buffer, size_t bufferSize)
+{
+    if (site == NULL)
+        snprintf(buffer, bufferSize, "?");
+    else if (site->caller != NULL)
+        snprintf(buffer, bufferSize, "%s [%p]", site->file, site->caller);
+    else
+        snprintf(buffer, bufferSize, "%s (%d)", site->file, site->line);
+    return buffer;
+}
+
+const OgeAllocSite* OgeMemoryGetSite(int index)
+{
+    if (index < 0 || (u32)index >= _allocSiteCount)
+        return NULL;
+    return &_allocSites[index];
+}
+
+inline size_t OgeMemorySiteValue(const OgeAllocSite* site, OgeSiteSort sortBy)
+{
+    switch (sortBy) {
+    case OGE_SITE_SORT_LIVE_COUNT:
+        return site->liveCount;
+    case OGE_SITE_SORT_PEAK_BYTES:
+        return site->peakBytes;
+    case OGE_SITE_SORT_TOTAL_COUNT:
+        return site->totalCount;
+    case OGE_SITE_SORT_TOTAL_BYTES:
+        return site->totalBytes;
+    case OGE_SITE_SORT_LIVE_BYTES:
+    default:
+        return site->liveBytes;
+    }
+}
+
+// Fills 'sites' with the (at most) maxSites biggest sites, sorted in decreasing order.
+// Cost is O(nb of call sites * maxSites) in the worst case; usually O(nb of call sites)
+// as most sites are rejected by comparing with the smallest kept site.
+int OgeMemoryTopSites(const OgeAllocSite** sites, int maxSites, OgeSiteSort sortBy)
+{
+    int count = 0;
+    if (sites == NULL || maxSites <= 0)
+        return 0;
+
+    for (u32 i = 0; i < _allocSiteCount; i++) {
+        const OgeAllocSite* site = &_allocSites[i];
+        size_t value = OgeMemorySiteValue(site, sortBy);
+        if (value == 0)
+            continue;
+        if (count == maxSites && value <= OgeMemorySiteValue(sites[count - 1], sortBy))
+            continue;
+
+        int n = (count < maxSites) ? count++ : count - 1;
+        while (n > 0 && OgeMemorySiteValue(sites[n - 1], sortBy) < value) {
+            sites[n] = sites[n - 1];
+            n--;
+        }
+        sites[n] = site;
+    }
+
+    return count;
+}
+
+void OgeMemorySiteReport(int maxSites, OgeSiteSort sortBy)
+{
+    const OgeAllocSite** sites = (const OgeAllocSite**)malloc(sizeof(OgeAllocSite*) * (maxSites > 0 ? maxSites : 1));
+    if (sites == NULL)
+        return;
+
+    int count = OgeMemoryTopSites(sites, maxSites, sortBy);
+
+    printf("\n======  Call Site Report (%d of %u sites) ============\n", count, _allocSiteCount);
+#if OGE_MEMORY_SAMPLE_RATE
+    printf("Estimated from 1 sample per %llu bytes allocated\n", (unsigned long long)OGE_ATOMIC_LOAD(&_sampleRate));
+#endif
+    printf("%16s %10s %16s %10s  %-12s %s\n", "live bytes", "live nb", "peak bytes", "total nb", "common size", "file (line)");
+
+    for (int i = 0; i < count; i++) {
+        const OgeAllocSite* site = sites[i];
+
+        // Most frequent size bin
+        u32 bin = 0;
+        for (u32 b = 1; b < OGE_MEMORY_SIZE_BINS; b++) {
+            if (site->sizeBins[b] > site->sizeBins[bin])
+                bin = b;
+        }
+
+        char binStr[32];
+        sprintf(binStr, "%llu-%llu", 1ull << bin, (2ull << bin) - 1);
+
+        char name[512];
+        printf("%16llu %10llu %16llu %10llu  %-12s %s\n",
+            (unsigned long long)site->liveBytes, (unsigned long long)site->liveCount,
+            (unsigned long long)site->peakBytes, (unsigned long long)site->totalCount,
+            binStr, OgeMemorySiteName(site, name, sizeof(name)));
+    }
+
+    printf("======  End Call Site Report ============\n");
+    free((void*)sites);
+}
+
+//--------------- Lifetimes ---------------------
+
+typedef struct OgeLifetimeSite OgeLifetimeSite;
+
+struct OgeLifetimeSite
+{
+    const OgeAllocSite* site;
+    size_t sameFrame;   // freed in the frame of their allocation
+    size_t shortLived;  // freed within OGE_MEMORY_SHORT_LIFETIME frames
+    size_t longLived;   // freed later
+    u32 sizeBin;        // most frequent size bin
+    size_t sizeCount;   // allocations in sizeBin
+    const char* candidate;
+    size_t savedCalls;  // estimated OgeMalloc + OgeFree calls an arena or a pool would remove
+};
+
+// Last lifetime bin of the short lived blocks: ages [1, 2^bin - 1]
+inline u32 OgeMemoryShortLifetimeBin(void)
+{
+    u32 bin = 0;
+    while (bin + 1 < OGE_MEMORY_LIFETIME_BINS && (2ull << bin) - 1 <= OGE_MEMORY_SHORT_LIFETIME)
+        bin++;
+    return bin;
+}
+
+// A site is a frame arena candidate when (nearly) all its blocks are freed in their frame, or
+// within a few frames (one arena per frame, reset when the oldest frame ends). Its allocations
+// and frees become pointer bumps and one reset per frame.
+// Otherwise it is a pool candidate when (nearly) all its sizes are in one power of 2 bin:
+// an OgePool of slots of that bin pops and pushes a free list and only allocates chunks.
+inline void OgeMemoryLifetimeClassify(const OgeAllocSite* site, u32 shortBin, OgeLifetimeSite* out)
+{
+    const size_t share = 90; // % of the allocations
+    size_t total = site->totalCount;
+
+    memset(out, 0, sizeof(OgeLifetimeSite));
+    out->site = site;
+    out->candidate = "-";
+    out->sameFrame = site->lifetimeBins[0];
+    for (u32 b = 1; b < OGE_MEMORY_LIFETIME_BINS; b++) {
+        if (b <= shortBin)
+            out->shortLived += site->lifetimeBins[b];
+        else
+            out->longLived += site->lifetimeBins[b];
+    }
+    for (u32 b = 0; b < OGE_MEMORY_SIZE_BINS; b++) {
+        if (site->sizeBins[b] > out->sizeCount) {
+            out->sizeBin = b;
+            out->sizeCount = site->sizeBins[b];
+        }
+    }
+    if (total == 0)
+        return;
+
+    if (out->sameFrame * 100 >= total * share) {
+        out->candidate = "frame arena";
+        out->savedCalls = 2 * out->sameFrame;
+    }
+    else if ((out->sameFrame + out->shortLived) * 100 >= total * share) {
+        out->candidate = "short arena";
+        out->savedCalls = 2 * (out->sameFrame + out->shortLived);
+    }
+    else if (out->sizeCount * 100 >= total * share) {
+        // The frees in proportion of the allocations of the bin, minus the chunk allocations (256 slots)
+        size_t freed = out->sameFrame + out->shortLived + out->longLived;
+        size_t calls = out->sizeCount + (size_t)((double)freed * out->sizeCount / total);
+        size_t chunks = (out->sizeCount + 255) / 256;
+        out->candidate = "pool";
+        out->savedCalls = calls > chunks ? calls - chunks : 0;
+    }
+}
+
+// Ranks the call sites by the allocator calls a frame arena or an OgePool would save.
+// The live blocks are the ones not freed yet, i.e. the leaks when called at the exit.
+void OgeMemoryLifetimeReport(int maxSites)
+{
+    OgeLifetimeSite* sites = (OgeLifetimeSite*)malloc(sizeof(OgeLifetimeSite) * (maxSites > 0 ? maxSites : 1));
+    if (sites == NULL)
+        return;
+
+    u32 shortBin = OgeMemoryShortLifetimeBin();
+    int count = 0;
+    for (u32 i = 0; i < _allocSiteCount && maxSites > 0; i++) {
+        OgeLifetimeSite candidate;
+        OgeMemoryLifetimeClassify(&_allocSites[i], shortBin, &candidate);
+        if (candidate.savedCalls == 0)
+            continue;
+        if (count == maxSites && candidate.savedCalls <= sites[count - 1].savedCalls)
+            continue;
+
+        int n = (count < maxSites) ? count++ : count - 1;
+        while (n > 0 && sites[n - 1].savedCalls < candidate.savedCalls) {
+            sites[n] = sites[n - 1];
+            n--;
+        }
+        sites[n] = candidate;
+    }
+
+    printf("\n======  Lifetime Report (%d of %u sites, %u frames) ============\n", count, _allocSiteCount, (unsigned)_memoryFrame);
+#if OGE_MEMORY_SAMPLE_RATE
+    printf("Estimated from 1 sample per %llu bytes allocated\n", (unsigned long long)OGE_ATOMIC_LOAD(&_sampleRate));
+#endif
+    printf("Short lived: freed within 1-%llu frames\n", (1ull << shortBin) - 1);
+    printf("%12s %10s %6s %6s %6s %10s  %-12s %5s  %-12s %s\n",
+        "saved calls", "total nb", "same%", "short%", "long%", "live nb", "common size", "size%", "candidate", "file (line)");
+
+    for (int i = 0; i < count; i++) {
+        const OgeLifetimeSite* ls = &sites[i];
+        const OgeAllocSite* site = ls->site;
+        double total = (double)site->totalCount;
+
+        char binStr[32];
+        sprintf(binStr, "%llu-%llu", 1ull << ls->sizeBin, (2ull << ls->sizeBin) - 1);
+
+        char name[512];
+        printf("%12llu %10llu %6.1f %6.1f %6.1f %10llu  %-12s %5.1f  %-12s %s\n",
+            (unsigned long long)ls->savedCalls, (unsigned long long)site->totalCount,
+            100.0 * ls->sameFrame / total, 100.0 * ls->shortLived / total, 100.0 * ls->longLived / total,
+            (unsigned long long)site->liveCount, binStr, 100.0 * ls->sizeCount / total,
+            ls->candidate, OgeMemorySiteName(site, name, sizeof(name)));
+    }
+
+    printf("======  End Lifetime Report ============\n");
+    free(sites);
+}
+
+//--------------- Allocator stats ---------------------
+
+void OgeMemorySetAllocatorName(u16 allocator, const char* name)
+{
+    _allocators[OgeMemoryCheckAllocator(allocator)].name = name;
+}
+
+// 0 removes the budget
+void OgeMemorySetAllocatorBudget(u16 allocator, size_t bytes)
+{
+    _allocators[OgeMemoryCheckAllocator(allocator)].budget = bytes;
+}
+
+void OgeMemorySetBudgetCallback(OgeBudgetCallback callback)
+{
+    _budgetCallback = callback;
+}
+
+// Sums the counters of all the threads without locking: O(nb of threads).
+// The values can be a few allocations late for the other threads.
+bool OgeMemoryGetAllocatorStats(u16 allocator, OgeAllocatorStats* stats)
+{
+    if (stats == NULL || allocator >= OGE_MEMORY_MAX_ALLOCATORS)
+        return false;
+
+    long long liveBytes = 0;
+    long long liveCount = 0;
+    long long totalCount = 0;
+    long long totalBytes = 0;
+    for (OgeMemoryThread* thread = OGE_ATOMIC_LOAD_ACQUIRE(&_memoryThreads); thread != NULL; thread = thread->next) {
+        const volatile OgeAllocatorCounters* counters = &thread->counters[allocator];
+        liveBytes += counters->liveBytes;
+        liveCount += counters->liveCount;
+        totalCount += counters->totalCount;
+        totalBytes += counters->totalBytes;
+    }
+
+    OgeAllocatorInfo* info = &_allocators[allocator];
+    stats->name = info->name;
+    stats->liveBytes = liveBytes > 0 ? (size_t)liveBytes : 0;
+    stats->liveCount = liveCount > 0 ? (size_t)liveCount : 0;
+    stats->totalCount = (size_t)totalCount;
+    stats->totalBytes = (size_t)totalBytes;
+    stats->frameCount = info->frameCount;
+    stats->budget = info->budget;
+
+    // The sampled estimate can be below the exact live bytes
+    size_t peakBytes = OGE_ATOMIC_LOAD(&info->peakBytes);
+    stats->peakBytes = peakBytes > stats->liveBytes ? peakBytes : stats->liveBytes;
+    return true;
+}
+
+size_t OgeMemoryAllocatorLiveBytes(u16 allocator)
+{
+    OgeAllocatorStats stats;
+    return OgeMemoryGetAllocatorStats(allocator, &stats) ? stats.liveBytes : 0;
+}
+
+// Called by OgeLogUpdate() at the end of each frame; call it yourself when there is no logger.
+// Counts the allocations of the frame, checks the budgets and ages the blocks (lifetime report).
+void OgeMemoryAllocatorFrame(void)
+{
+    _memoryFrame++;
+
+    for (u16 i = 0; i < OGE_MEMORY_MAX_ALLOCATORS; i++) {
+        OgeAllocatorInfo* info = &_allocators[i];
+        OgeAllocatorStats stats;
+        OgeMemoryGetAllocatorStats(i, &stats);
+
+        info->frameCount = stats.totalCount - info->frameStartCount;
+        info->frameStartCount = stats.totalCount;
+
+        if (info->budget == 0 || stats.liveBytes <= info->budget)
+            continue;
+
+        if (_ogeLogger != NULL && _ogeLogger->logFile != NULL) {
+            char text[256];
+            snprintf(text, sizeof(text), "Allocator %u (%s) over budget: %llu bytes for %llu",
+                (unsigned)i, info->name != NULL ? info->name : "?",
+                (unsigned long long)stats.liveBytes, (unsigned long long)info->budget);
+            LOGE(text);
+        }
+        if (_budgetCallback != NULL)
+            _budgetCallback(i, stats.liveBytes, info->budget);
+    }
+}
+
+void OgeMemoryAllocatorReport(void)
+{
+    printf("\n======  Allocator Report ============\n");
+    printf("%4s %-16s %16s %10s %16s %10s %16s\n", "id", "name", "live bytes", "live nb", "peak bytes", "frame nb", "budget");
+
+    for (u16 i = 0; i < OGE_MEMORY_MAX_ALLOCATORS; i++) {
+        OgeAllocatorStats stats;
+        OgeMemoryGetAllocatorStats(i, &stats);
+        if (stats.totalCount == 0 && stats.name == NULL)
+            continue;
+        printf("%4u %-16s %16llu %10llu %16llu %10llu %16llu%s\n",
+            (unsigned)i, stats.name != NULL ? stats.name : "",
+            (unsigned long long)stats.liveBytes, (unsigned long long)stats.liveCount,
+            (unsigned long long)stats.peakBytes, (unsigned long long)stats.frameCount,
+            (unsigned long long)stats.budget, stats.budget != 0 && stats.liveBytes > stats.budget ? "  OVER BUDGET" : "");
+    }
+
+    printf("======  End Allocator Report ============\n");
+}
+
+//--------------- Snapshots ---------------------
+
+// LSD radix sort on the addresses, 11 bits per pass. The passes where all the blocks
+// have the same digit (i.e. the high bits of the heap addresses) are skipped.
+inline void OgeMemoryRadixSort(OgeSnapshotBlock* blocks, OgeSnapshotBlock* tmp, size_t count)
+{
+    const int bits = 11;
+    const int passes = (64 + bits - 1) / bits;
+    const u32 buckets = 1u << bits;
+
+    size_t* histograms = (size_t*)calloc((size_t)passes * buckets, sizeof(size_t));
+    if (histograms == NULL)
+        return;
+
+    for (size_t i = 0; i < count; i++) {
+        u64 address = blocks[i].address;
+        for (int p = 0; p < passes; p++)
+            histograms[p * buckets + ((address >> (p * bits)) & (buckets - 1))]++;
+    }
+
+    OgeSnapshotBlock* src = blocks;
+    OgeSnapshotBlock* dst = tmp;
+
+    for (int p = 0; p < passes; p++) {
+        size_t* histogram = &histograms[p * buckets];
+        if (histogram[(src[0].address >> (p * bits)) & (buckets - 1)] == count)
+            continue;
+
+        size_t offset = 0;
+        for (u32 b = 0; b < buckets; b++) {
+            size_t n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+
+        for (size_t i = 0; i < count; i++)
+            dst[histogram[(src[i].address >> (p * bits)) & (buckets - 1)]++] = src[i];
+
+        OgeSnapshotBlock* swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != blocks)
+        memcpy(blocks, src, sizeof(OgeSnapshotBlock) * count);
+
+    free(histograms);
+}
+
+// Copies the live set. The snapshot is allocated with the untracked malloc so it
+// doesn't change the heap it describes. Free it with OgeMemorySnapshotFree().
+OgeHeapSnapshot* OgeMemorySnapshot(void)
+{
+    OgeHeapSnapshot* snapshot = (OgeHeapSnapshot*)calloc(1, sizeof(OgeHeapSnapshot));
+    if (snapshot == NULL)
+        return NULL;
+
+    // The buffer is sized before taking the lock. When blocks were allocated meanwhile
+    // it is too small: it is reallocated with some margin and the copy is retried.
+    size_t capacity = _mallocInfoCount + 16;
+    for (;;) {
+        snapshot->blocks = (OgeSnapshotBlock*)malloc(sizeof(OgeSnapshotBlock) * capacity * 2);
+        if (snapshot->blocks == NULL) {
+            free(snapshot);
+            return NULL;
+        }
+
+        OgeSpinLock(&_trackerLock);
+        if (_mallocInfoCount <= capacity)
+            break; // the lock is kept for the copy
+        capacity = _mallocInfoCount + _mallocInfoCount / 8 + 16;
+        OgeSpinUnlock(&_trackerLock);
+        free(snapshot->blocks);
+    }
+
+    OgeSnapshotBlock* block = snapshot->blocks;
+    for (OgeMallocInfo* omi = _mallocInfoHead; omi != NULL; omi = omi->next) {
+        if ((ptrdiff_t)omi->size < 0)
+            continue;
+        block->address = (u64)(size_t)OgeMemoryUserPointer(omi);
+        block->size = omi->size;
+        block->site = omi->site;
+        block->allocator = omi->allocator;
+        snapshot->bytes += omi->size;
+        snapshot->count++;
+        block++;
+    }
+    OgeSpinUnlock(&_trackerLock);
+
+    // The second half of the buffer is the radix sort scratch
+    if (snapshot->count > 1)
+        OgeMemoryRadixSort(snapshot->blocks, snapshot->blocks + capacity, snapshot->count);
+
+    return snapshot;
+}
+
+void OgeMemorySnapshotFree(OgeHeapSnapshot* snapshot)
+{
+    if (snapshot == NULL)
+        return;
+    free(snapshot->blocks);
+    free(snapshot);
+}
+
+inline int OgeMemorySiteDiffCompare(const void* a, const void* b)
+{
+    const OgeSnapshotSiteDiff* da = (const OgeSnapshotSiteDiff*)a;
+    const OgeSnapshotSiteDiff* db = (const OgeSnapshotSiteDiff*)b;
+    long long netA = (long long)(da->newBytes + da->grownBytes) - (long long)da->freedBytes;
+    long long netB = (long long)(db->newBytes + db->grownBytes) - (long long)db->freedBytes;
+    return netA < netB ? 1 : (netA > netB ? -1 : 0);
+}
+
+// Merges the two sorted snapshots: O(a->count + b->count + nb of sites)
+OgeHeapSnapshotDiff* OgeMemorySnapshotDiff(const OgeHeapSnapshot* a, const OgeHeapSnapshot* b)
+{
+    if (a == NULL || b == NULL)
+        return NULL;
+
+    OgeHeapSnapshotDiff* diff = (OgeHeapSnapshotDiff*)calloc(1, sizeof(OgeHeapSnapshotDiff));
+    OgeSnapshotSiteDiff* bySite = (OgeSnapshotSiteDiff*)calloc(_allocSiteCount, sizeof(OgeSnapshotSiteDiff));
+    if (diff == NULL || bySite == NULL) {
+        free(diff);
+        free(bySite);
+        return NULL;
+    }
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a->count || j < b->count) {
+        const OgeSnapshotBlock* ba = i < a->count ? &a->blocks[i] : NULL;
+        const OgeSnapshotBlock* bb = j < b->count ? &b->blocks[j] : NULL;
+
+        if (bb == NULL || (ba != NULL && ba->address < bb->address)) {
+            bySite[ba->site].freedCount++;
+            bySite[ba->site].freedBytes += (size_t)ba->size;
+            i++;
+        }
+        else if (ba == NULL || bb->address < ba->address) {
+            bySite[bb->site].newCount++;
+            bySite[bb->site].newBytes += (size_t)bb->size;
+            j++;
+        }
+        else {
+            // Same address: either the same block or a block freed then allocated again
+            if (ba->site != bb->site || bb->size < ba->size) {
+                bySite[ba->site].freedCount++;
+                bySite[ba->site].freedBytes += (size_t)ba->size;
+                bySite[bb->site].newCount++;
+                bySite[bb->site].newBytes += (size_t)bb->size;
+            }
+            else if (bb->size > ba->size) {
+                bySite[bb->site].grownCount++;
+                bySite[bb->site].grownBytes += (size_t)(bb->size - ba->size);
+            }
+            i++;
+            j++;
+        }
+    }
+
+    // Keep only the sites with a change
+    int count = 0;
+    for (u32 s = 0; s < _allocSiteCount; s++) {
+        OgeSnapshotSiteDiff* site = &bySite[s];
+        if (site->newCount == 0 && site->freedCount == 0 && site->grownCount == 0)
+            continue;
+        site->site = s;
+        diff->total.newCount += site->newCount;
+        diff->total.newBytes += site->newBytes;
+        diff->total.freedCount += site->freedCount;
+        diff->total.freedBytes += site->freedBytes;
+        diff->total.grownCount += site->grownCount;
+        diff->total.grownBytes += site->grownBytes;
+        bySite[count++] = *site;
+    }
 
-#include <stdlib.h>
+    qsort(bySite, count, sizeof(OgeSnapshotSiteDiff), OgeMemorySiteDiffCompare);
 
-#   if !OGE_USE_LEAK_CHECK
+    diff->count = count;
+    diff->sites = bySite;
+    return diff;
+}
 
-// inlining to avoid link issue: https://stackoverflow.com/questions/19148639/already-defined-obj-linking-error
-inline void* OgeMalloc(size_t size)
+void OgeMemorySnapshotDiffFree(OgeHeapSnapshotDiff* diff)
 {
-    int* ptr = malloc(size);
-    assert(ptr != 0);
-    return ptr;
+    if (diff == NULL)
+        return;
+    free(diff->sites);
+    free(diff);
 }
 
-inline void* OgeCalloc(size_t size)
+void OgeMemorySnapshotDiffReport(const OgeHeapSnapshotDiff* diff, int maxSites)
 {
-    int* ptr = calloc(1, size);
-    assert(ptr != 0);
-    return ptr;
+    if (diff == NULL)
+        return;
+
+    printf("\n======  Snapshot Diff (%d sites) ============\n", diff->count);
+    printf("%10s %14s %10s %14s %10s %14s  %s\n", "new nb", "new bytes", "freed nb", "freed bytes", "grown nb", "grown bytes", "file (line)");
+
+    for (int i = 0; i < diff->count && i < maxSites; i++) {
+        const OgeSnapshotSiteDiff* d = &diff->sites[i];
+        char name[512];
+        printf("%10llu %14llu %10llu %14llu %10llu %14llu  %s\n",
+            (unsigned long long)d->newCount, (unsigned long long)d->newBytes,
+            (unsigned long long)d->freedCount, (unsigned long long)d->freedBytes,
+            (unsigned long long)d->grownCount, (unsigned long long)d->grownBytes,
+            OgeMemorySiteName(OgeMemoryGetSite((int)d->site), name, sizeof(name)));
+    }
+
+    const OgeSnapshotSiteDiff* t = &diff->total;
+    printf("%10llu %14llu %10llu %14llu %10llu %14llu  Total\n",
+        (unsigned long long)t->newCount, (unsigned long long)t->newBytes,
+        (unsigned long long)t->freedCount, (unsigned long long)t->freedBytes,
+        (unsigned long long)t->grownCount, (unsigned long long)t->grownBytes);
+    printf("======  End Snapshot Diff ============\n");
 }
 
-inline void* OgeRealloc(void* obj, size_t size)
+//--------------- Fragmentation ---------------------
+
+static int _fragInterval = OGE_MEMORY_FRAG_INTERVAL;
+
+void OgeMemorySetFragmentationInterval(int frames)
 {
-    int* ptr = realloc(obj, size);
-    assert(ptr != 0);
-    return ptr;
+    _fragInterval = frames > 0 ? frames : 0;
 }
 
-inline void OgeFree(void* obj)
+// Fragmentation of the tracked blocks of each allocator. With OGE_MEMORY_SAMPLE_RATE only
+// the sampled blocks are tracked so the holes are overestimated.
+void OgeMemoryFragmentationReport(void)
 {
-    free(obj);
+    OgeHeapSnapshot* snapshot = OgeMemorySnapshot();
+    if (snapshot == NULL)
+        return;
+
+    OgeFragmentation* frag = (OgeFragmentation*)malloc(sizeof(OgeFragmentation));
+    int count = 0;
+    for (u16 i = 0; frag != NULL && i < OGE_MEMORY_MAX_ALLOCATORS; i++) {
+        if (OgeFragmentationCompute(snapshot, i, frag)) {
+            OgeFragmentationReport(frag, _allocators[i].name);
+            count++;
+        }
+    }
+    if (frag != NULL && count > 1 && OgeFragmentationCompute(snapshot, OGE_ALLOCATOR_ALL, frag))
+        OgeFragmentationReport(frag, "all");
+    free(frag);
+    OgeMemorySnapshotFree(snapshot);
 }
 
-inline void OgeMemoryReport(int showAll)
+// Called by OgeLogUpdate(): every OGE_MEMORY_FRAG_INTERVAL frames writes a "frag" record per allocator
+// (allocator 65535 is OGE_ALLOCATOR_ALL)
+//   {"type":"frag","p1":"frame", "p2":"allocator", "p3":"blocks", "p4":"live bytes", "p5":"free bytes",
+//    "p6":"largest hole", "p7":"external fragmentation", "p8":"entropy" }
+void OgeMemoryFragmentationFrame(unsigned long frame)
 {
-    printf("No report because preprocessor OGE_USE_LEAK_CHECK was not set to 1.\n");
+    if (_fragInterval == 0 || frame % (unsigned long)_fragInterval != 0)
+        return;
+    if (_ogeLogger == NULL || _ogeLogger->logFile == NULL)
+        return;
+
+    OgeHeapSnapshot* snapshot = OgeMemorySnapshot();
+    OgeFragmentation* frag = (OgeFragmentation*)malloc(sizeof(OgeFragmentation));
+    int count = 0;
+    for (u32 i = 0; snapshot != NULL && frag != NULL && i <= OGE_MEMORY_MAX_ALLOCATORS; i++) {
+        // The last record is the whole heap, when there is more than one allocator
+        u16 allocator = i < OGE_MEMORY_MAX_ALLOCATORS ? (u16)i : OGE_ALLOCATOR_ALL;
+        if ((allocator == OGE_ALLOCATOR_ALL && count < 2) || !OgeFragmentationCompute(snapshot, allocator, frag))
+            continue;
+        count++;
+
+        char values[7][32];
+        const char* fields[7];
+        snprintf(values[0], 32, "%u", (unsigned)allocator);
+        snprintf(values[1], 32, "%llu", (unsigned long long)frag->blockCount);
+        snprintf(values[2], 32, "%llu", (unsigned long long)frag->liveBytes);
+        snprintf(values[3], 32, "%llu", (unsigned long long)frag->freeBytes);
+        snprintf(values[4], 32, "%llu", (unsigned long long)frag->largestGap);
+        snprintf(values[5], 32, "%.4f", frag->externalRatio);
+        snprintf(values[6], 32, "%.3f", frag->entropy);
+        for (int v = 0; v < 7; v++)
+            fields[v] = values[v];
+        OgeLogSummary("frag", fields, 7);
+    }
+    free(frag);
+    OgeMemorySnapshotFree(snapshot);
 }
 
-#   else // OGE_USE_LEAK_CHECK
+#   endif // OGE_USE_LEAK_CHECK
 
-#include <string.h> // for memcpy
+//--------------- Virtual arenas ---------------------
 
-typedef struct OgeMallocInfo OgeMallocInfo;
+#if defined(_MSC_VER)
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   include <windows.h> // VirtualAlloc
+#else
+#   include <sys/mman.h> // mmap, mprotect, madvise
+#   include <unistd.h>   // sysconf
+#endif
 
-struct OgeMallocInfo
+inline size_t OgeArenaPageSize()
 {
-    OgeMallocInfo* next;
-    OgeMallocInfo* prev;
-    int line;
-    const char* file;
-    size_t size;
-};
+    static size_t pageSize = 0;
+    if (pageSize == 0) {
+#if defined(_MSC_VER)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        pageSize = (size_t)info.dwPageSize;
+#else
+        pageSize = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    }
+    return pageSize;
+}
 
-static OgeMallocInfo* _mallocInfoHead;
-static size_t MallocInfoSize = sizeof(OgeMallocInfo);
+inline size_t OgeArenaRoundUp(size_t size, size_t granularity)
+{
+    return (size + granularity - 1) & ~(granularity - 1);
+}
 
-// inlining to avoid link issue: https://stackoverflow.com/questions/19148639/already-defined-obj-linking-error
-inline void* OgeMalloc(size_t size, const char* file, int line)
+// Counts the committed bytes under OGE_ALLOCATOR_ARENA and logs the commit/decommit
+inline void OgeArenaTrack(OgeVirtualArena* arena, u16 action, size_t offset, size_t bytes)
 {
-    OgeMallocInfo* ptr = (OgeMallocInfo*)malloc(size + MallocInfoSize);
-    assert(ptr != 0);
-    if (ptr == NULL) return 0;
+#if OGE_USE_LEAK_CHECK
+    OgeMemoryThread* thread = OgeMemoryCurrentThread();
+    if (thread != NULL) {
+        OgeAllocatorCounters* counters = &thread->counters[OGE_ALLOCATOR_ARENA];
+        if (action == OGE_ALLOC_COMMIT) {
+            counters->liveBytes += (long long)bytes;
+            counters->totalBytes += (long long)bytes;
+        }
+        else {
+            counters->liveBytes -= (long long)bytes;
+        }
+    }
 
-    ptr->file = file;
-    ptr->line = line;
+    OgeSpinLock(&_trackerLock);
+    if (action == OGE_ALLOC_COMMIT)
+        OgeMemoryPeakAdd(OGE_ALLOCATOR_ARENA, bytes);
+    else
+        OgeMemoryPeakRemove(OGE_ALLOCATOR_ARENA, bytes);
+    OgeSpinUnlock(&_trackerLock);
 
-    if (_ogeLogger != NULL) {
-        LOGA(0, "add", (unsigned long)(ptr), size, file, line);
+    if (_ogeLogger != NULL && _ogeLogger->logFile != NULL) {
+        OgeMemoryPushEvent(action, OGE_ALLOCATOR_ARENA, arena->base + offset, bytes, arena->site);
     }
+#endif
+}
 
-    ptr->next = _mallocInfoHead;
-    if (_mallocInfoHead)
-        ptr->next->prev = ptr;
-    ptr->prev = NULL;
-    ptr->size = size;
-    _mallocInfoHead = ptr;
-    return ptr + 1;
+// Commits [committed, newCommitted[
+inline bool OgeArenaCommit(OgeVirtualArena* arena, size_t newCommitted)
+{
+    size_t bytes = newCommitted - arena->committed;
+    char* start = arena->base + arena->committed;
+#if defined(_MSC_VER)
+    if (VirtualAlloc(start, bytes, MEM_COMMIT, PAGE_READWRITE) == NULL)
+        return false;
+#else
+    if (mprotect(start, bytes, PROT_READ | PROT_WRITE) != 0)
+        return false;
+#endif
+    OgeArenaTrack(arena, OGE_ALLOC_COMMIT, arena->committed, bytes);
+    arena->committed = newCommitted;
+    return true;
 }
 
-inline void* OgeCalloc(size_t size, const char* file, int line)
+// Gives back the pages of [newCommitted, committed[ to the OS; the range stays reserved
+inline void OgeArenaDecommit(OgeVirtualArena* arena, size_t newCommitted)
 {
-    OgeMallocInfo* ptr = (OgeMallocInfo*)calloc(1, size + MallocInfoSize);
-    assert(ptr != 0);
-    if (ptr == NULL) return 0;
+    size_t bytes = arena->committed - newCommitted;
+    char* start = arena->base + newCommitted;
+#if defined(_MSC_VER)
+    VirtualFree(start, bytes, MEM_DECOMMIT);
+#else
+    madvise(start, bytes, MADV_DONTNEED);
+    mprotect(start, bytes, PROT_NONE);
+#endif
+    OgeArenaTrack(arena, OGE_ALLOC_DECOMMIT, newCommitted, bytes);
+    arena->committed = newCommitted;
+}
 
-    ptr->file = file;
-    ptr->line = line;
+// Reserves 'reserveBytes' of address space without using memory. Returns false on failure.
+// Use the OgeArenaCreate() macro to record the file and line.
+bool OgeArenaCreateAt(OgeVirtualArena* arena, size_t reserveBytes, const char* file, int line)
+{
+    memset(arena, 0, sizeof(OgeVirtualArena));
+    reserveBytes = OgeArenaRoundUp(reserveBytes > 0 ? reserveBytes : 1, OgeArenaPageSize());
+
+#if defined(_MSC_VER)
+    void* base = VirtualAlloc(NULL, reserveBytes, MEM_RESERVE, PAGE_NOACCESS);
+    if (base == NULL)
+        return false;
+#else
+    void* base = mmap(NULL, reserveBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        return false;
+#endif
 
-    // TODO ptr->callstackStr = callstack()/StackWalk64()  so we know where the alloc has been called when in a lib struct such as Str!
+    arena->base = (char*)base;
+    arena->reserved = reserveBytes;
+    arena->file = file;
+    arena->line = line;
 
-    ptr->next = _mallocInfoHead;
-    if (_mallocInfoHead)
-        ptr->next->prev = ptr;
-    ptr->prev = NULL;
-    ptr->size = size;
-    _mallocInfoHead = ptr;
+#if OGE_USE_LEAK_CHECK
+    if (_allocators[OGE_ALLOCATOR_ARENA].name == NULL)
+        _allocators[OGE_ALLOCATOR_ARENA].name = "virtual arena";
 
-    if (_ogeLogger != NULL) {
-        LOGA(0, "add", (unsigned long)(ptr), size, file, line);
-    }
+    // Once: the site table is guarded by _trackerLock
+    OgeSpinLock(&_trackerLock);
+    arena->site = OgeMemoryFindSite(file, line, NULL);
+    OgeSpinUnlock(&_trackerLock);
 
-    return ptr + 1;
+    OgeMemoryThread* thread = OgeMemoryCurrentThread();
+    if (thread != NULL) {
+        thread->counters[OGE_ALLOCATOR_ARENA].liveCount++;
+        thread->counters[OGE_ALLOCATOR_ARENA].totalCount++;
+    }
+#endif
+    return true;
 }
 
-inline void OgeFree(void* obj)
+void OgeArenaDestroy(OgeVirtualArena* arena)
 {
-    if (obj == NULL)
+    if (arena->base == NULL)
         return;
 
-    OgeMallocInfo* mi = (OgeMallocInfo*)obj - 1;
+    if (arena->committed > 0)
+        OgeArenaTrack(arena, OGE_ALLOC_DECOMMIT, 0, arena->committed);
 
-    if (_ogeLogger != NULL && _ogeLogger->logFile != 0) {
-        LOGA(0, "del", (unsigned long)(mi), mi->size, mi->file, mi->line);
-    }
+#if defined(_MSC_VER)
+    VirtualFree(arena->base, 0, MEM_RELEASE);
+#else
+    munmap(arena->base, arena->reserved);
+#endif
 
-    mi->size = ~mi->size; // flipps the bits
-    if (mi->prev != NULL)
-        mi->prev->next = mi->next;
-    if (mi->next)
-        mi->next->prev = mi->prev;
+#if OGE_USE_LEAK_CHECK
+    OgeMemoryThread* thread = OgeMemoryCurrentThread();
+    if (thread != NULL)
+        thread->counters[OGE_ALLOCATOR_ARENA].liveCount--;
+#endif
+    memset(arena, 0, sizeof(OgeVirtualArena));
+}
 
-    if (_mallocInfoHead == mi)
-        _mallocInfoHead = mi->next;
+// Grows or shrinks the used part. Growing commits the missing pages, by chunks of
+// OGE_ARENA_COMMIT_SIZE; shrinking keeps them (see OgeArenaTrim). The data never moves.
+// Returns false when 'used' is over the reserved size or the commit failed.
+bool OgeArenaSetUsed(OgeVirtualArena* arena, size_t used)
+{
+    if (used > arena->reserved)
+        return false;
+
+    if (used > arena->committed) {
+        size_t newCommitted = OgeArenaRoundUp(used, OgeArenaPageSize());
+        size_t minCommitted = arena->committed + OGE_ARENA_COMMIT_SIZE;
+        if (newCommitted < minCommitted)
+            newCommitted = minCommitted < arena->reserved ? minCommitted : arena->reserved;
+        if (!OgeArenaCommit(arena, newCommitted))
+            return false;
+    }
 
-    free(mi);
+    arena->used = used;
+    return true;
 }
 
-inline void* OgeRealloc(void* obj, size_t size, const char* file, int line)
+// Returns 'size' bytes at the end of the used part, or NULL when the arena is full.
+// 'alignment' must be a power of 2; 0 means OGE_MEMORY_ALIGNMENT.
+void* OgeArenaPush(OgeVirtualArena* arena, size_t size, size_t alignment)
 {
-    if (obj == NULL)
-    {
-        return OgeMalloc(size, file, line);
-    }
-    else if (size == 0)
-    {
-        OgeFree(obj);
-        obj = NULL;
+    if (alignment == 0)
+        alignment = OGE_MEMORY_ALIGNMENT;
+    size_t offset = OgeArenaRoundUp(arena->used, alignment);
+    if (offset > arena->reserved || size > arena->reserved - offset)
         return NULL;
-    }
-    else
-    {
-        // LATER What should we do with the original file/line? Concatenate?
+    if (!OgeArenaSetUsed(arena, offset + size))
+        return NULL;
+    return arena->base + offset;
+}
 
-        OgeMallocInfo* omi = (OgeMallocInfo*)obj - 1;
-        if (size <= omi->size)
-        {
-            return obj;
-        }
-        else
-        {
-            void* ptr = OgeMalloc(size, file, line);
-            if (ptr)
-            {
-                memcpy(ptr, obj, omi->size);
-                OgeFree(obj);
-                obj = NULL;
-            }
-            return ptr;
-        }
-    }
+// Decommits the pages after the used part, keeping 'keepBytes' committed as slack
+void OgeArenaTrim(OgeVirtualArena* arena, size_t keepBytes)
+{
+    size_t keep = arena->used + keepBytes;
+    if (keep < arena->used || keep > arena->reserved)
+        keep = arena->reserved;
+    keep = OgeArenaRoundUp(keep, OgeArenaPageSize());
+    if (keep < arena->committed)
+        OgeArenaDecommit(arena, keep);
 }
 
-// LATER fprintf version
-inline void OgeInternalPrint(const char* str, OgeMallocInfo* omi)
+//--------------- C++ operators ---------------------
+
+// The complete replaceable set so no form falls back to the C runtime.
+// They must be defined once: only in the OGE_MEMORY_IMPLEMENTATION file.
+#ifdef __cplusplus
+
+#include <new>
+
+inline void* OgeMemoryNewOrThrow(size_t size, size_t alignment, u16 allocator, const char* file, int line, const void* caller)
 {
-#if defined(_MSC_VER)
-    printf("%s: %s (%4d) : %16lld bytes at %p\n", str, omi->file, omi->line, (long long)omi->size, (void*)(omi + 1));
+    void* ptr = OgeMemoryNew(size, alignment, allocator, file, line, caller);
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    if (ptr == NULL)
+        throw std::bad_alloc();
 #else
-#   if defined __MINGW32__
-    // TODO
-#   else // GCC
-    // TODO
-#   endif
-
+    assert(ptr != 0);
 #endif
+    return ptr;
 }
 
-inline void OgeMemoryReport(int showAll)
-{
-    printf("\n======  Memory Report ============\n");
+OGE_NOINLINE void* operator new(size_t size) {
+    return OgeMemoryNewOrThrow(size, 0, 0, "operator new", 0, OGE_RETURN_ADDRESS());
+}
 
-    OgeMallocInfo* omi = _mallocInfoHead;
-    while (omi)
-    {
-        if ((ptrdiff_t)omi->size >= 0)
-            OgeInternalPrint("LEAK!", omi);
-        omi = omi->next;
-    }
+OGE_NOINLINE void* operator new[](size_t size) {
+    return OgeMemoryNewOrThrow(size, 0, 0, "operator new[]", 0, OGE_RETURN_ADDRESS());
+}
 
-    if (showAll != 1)
-        return;
+OGE_NOINLINE void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return OgeMemoryNew(size, 0, 0, "operator new", 0, OGE_RETURN_ADDRESS());
+}
 
-    omi = _mallocInfoHead;
-    while (omi)
-    {
-        if ((ptrdiff_t)omi->size < 0)
-            OgeInternalPrint("Freed", omi);
-        omi = omi->next;
-    }
+OGE_NOINLINE void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return OgeMemoryNew(size, 0, 0, "operator new[]", 0, OGE_RETURN_ADDRESS());
+}
 
-    printf("\n======  End Memory Report ============\n");
+void operator delete(void* p) noexcept {
+    OgeFree(p);
 }
 
-#   endif // OGE_USE_LEAK_CHECK
+void operator delete[](void* p) noexcept {
+    OgeFree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    OgeFree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    OgeFree(p);
+}
+
+void operator delete(void* p, size_t size) noexcept {
+    OgeFreeSized(p, size);
+}
+
+void operator delete[](void* p, size_t size) noexcept {
+    OgeFreeSized(p, size);
+}
+
+#if defined(__cpp_aligned_new)
+OGE_NOINLINE void* operator new(size_t size, std::align_val_t alignment) {
+    return OgeMemoryNewOrThrow(size, (size_t)alignment, 0, "operator new", 0, OGE_RETURN_ADDRESS());
+}
+
+OGE_NOINLINE void* operator new[](size_t size, std::align_val_t alignment) {
+    return OgeMemoryNewOrThrow(size, (size_t)alignment, 0, "operator new[]", 0, OGE_RETURN_ADDRESS());
+}
+
+OGE_NOINLINE void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return OgeMemoryNew(size, (size_t)alignment, 0, "operator new", 0, OGE_RETURN_ADDRESS());
+}
+
+OGE_NOINLINE void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return OgeMemoryNew(size, (size_t)alignment, 0, "operator new[]", 0, OGE_RETURN_ADDRESS());
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    OgeMemoryDeleteAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    OgeMemoryDeleteAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    OgeMemoryDeleteAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    OgeMemoryDeleteAligned(p);
+}
+
+void operator delete(void* p, size_t size, std::align_val_t) noexcept {
+    OgeMemoryDeleteAlignedSized(p, size);
+}
+
+void operator delete[](void* p, size_t size, std::align_val_t) noexcept {
+    OgeMemoryDeleteAlignedSized(p, size);
+}
+#endif // __cpp_aligned_new
+
+// OGE_NEW
+OGE_NOINLINE void* operator new(size_t size, const char* file, int line) {
+    return OgeMemoryNewOrThrow(size, 0, 0, file, line, OGE_RETURN_ADDRESS());
+}
+
+OGE_NOINLINE void* operator new[](size_t size, const char* file, int line) {
+    return OgeMemoryNewOrThrow(size, 0, 0, file, line, OGE_RETURN_ADDRESS());
+}
+
+// Only called when a constructor throws in a OGE_NEW expression
+void operator delete(void* p, const char*, int) noexcept {
+    OgeFree(p);
+}
+
+void operator delete[](void* p, const char*, int) noexcept {
+    OgeFree(p);
+}
+
+// OGE_NEW_TAGGED
+OGE_NOINLINE void* operator new(size_t size, const char* file, int line, u16 allocator) {
+    return OgeMemoryNewOrThrow(size, 0, allocator, file, line, OGE_RETURN_ADDRESS());
+}
+
+OGE_NOINLINE void* operator new[](size_t size, const char* file, int line, u16 allocator) {
+    return OgeMemoryNewOrThrow(size, 0, allocator, file, line, OGE_RETURN_ADDRESS());
+}
+
+void operator delete(void* p, const char*, int, u16) noexcept {
+    OgeFree(p);
+}
+
+void operator delete[](void* p, const char*, int, u16) noexcept {
+    OgeFree(p);
+}
+
+#endif // __cplusplus
 #endif // OGE_MEMORY_IMPLEMENTATION
 
 // ----------------- Declaration ------------------------
@@ -258,57 +2808,108 @@ inline void OgeMemoryReport(int showAll)
 
 #   if !OGE_USE_LEAK_CHECK
 
-#       define malloc(size)        OgeMalloc(size);
-#       define calloc(size)        OgeCalloc(size);
-#       define realloc(obj, size)  OgeRealloc(obj, size);
-#       define free(obj)           OgeFree(obj);
+#       define malloc(size)        OgeMalloc(size)
+#       define calloc(size)        OgeCalloc(size)
+#       define realloc(obj, size)  OgeRealloc(obj, size)
+#       define free(obj)           OgeFree(obj)
+#       define OGE_MALLOC_TAGGED(size, allocator) OgeMallocTagged(size, allocator)
+#       define OGE_CALLOC_TAGGED(size, allocator) OgeCallocTagged(size, allocator)
 
 extern void* OgeMalloc(size_t size);
 extern void* OgeCalloc(size_t size);
+extern void* OgeMallocTagged(size_t size, u16 allocator);
+extern void* OgeCallocTagged(size_t size, u16 allocator);
 extern void* OgeRealloc(void* obj, size_t size);
 extern void  OgeFree(void* obj);
+extern void  OgeFreeSized(void* obj, size_t size);
 extern void  OgeMemoryReport(int showAll);
 // char* OgeMemoryReportString(int showAll);
-
-#ifdef __cplusplus
-void * operator new(size_t size) {
-    return OgeMalloc(size);
-}
-
-void operator delete(void* p) {
-    OgeFree(p);
-}
-#endif
+extern int   OgeMemorySiteCount(void);
+extern const OgeAllocSite* OgeMemoryGetSite(int index);
+extern int   OgeMemoryTopSites(const OgeAllocSite** sites, int maxSites, OgeSiteSort sortBy);
+extern void  OgeMemorySiteReport(int maxSites, OgeSiteSort sortBy);
+extern void  OgeMemoryLifetimeReport(int maxSites);
+extern void  OgeMemorySetStackDepth(int depth);
+extern u32   OgeMemoryGetStackId(void* obj);
+extern int   OgeMemoryGetStack(u32 stackId, void** frames, int maxFrames);
+extern void  OgeMemoryPrintStack(u32 stackId);
+extern void  OgeMemorySetSampleRate(size_t bytes);
+extern size_t OgeMemoryGetSampleRate(void);
+extern OgeHeapSnapshot* OgeMemorySnapshot(void);
+extern void  OgeMemorySnapshotFree(OgeHeapSnapshot* snapshot);
+extern OgeHeapSnapshotDiff* OgeMemorySnapshotDiff(const OgeHeapSnapshot* a, const OgeHeapSnapshot* b);
+extern void  OgeMemorySnapshotDiffFree(OgeHeapSnapshotDiff* diff);
+extern void  OgeMemorySnapshotDiffReport(const OgeHeapSnapshotDiff* diff, int maxSites);
+extern void  OgeMemoryFlushEvents(void);
+extern void  OgeMemorySetAllocatorName(u16 allocator, const char* name);
+extern void  OgeMemorySetAllocatorBudget(u16 allocator, size_t bytes);
+extern void  OgeMemorySetBudgetCallback(OgeBudgetCallback callback);
+extern bool  OgeMemoryGetAllocatorStats(u16 allocator, OgeAllocatorStats* stats);
+extern size_t OgeMemoryAllocatorLiveBytes(u16 allocator);
+extern void  OgeMemoryAllocatorFrame(void);
+extern void  OgeMemoryAllocatorReport(void);
+extern void  OgeMemorySetFragmentationInterval(int frames);
+extern void  OgeMemoryFragmentationReport(void);
+extern void  OgeMemoryFragmentationFrame(unsigned long frame);
 
 #   else // OGE_USE_LEAK_CHECK
 
 #       include <stdlib.h> // to avoid lots of errors
 
-#       define malloc(size)        OgeMalloc(size, __FILE__, __LINE__);
-#       define calloc(size)        OgeCalloc(size, __FILE__, __LINE__);
-#       define realloc(obj, size)  OgeRealloc(obj, size, __FILE__, __LINE__);
-#       define free(obj)           OgeFree(obj);
+#       define malloc(size)        OgeMalloc(size, __FILE__, __LINE__)
+#       define calloc(size)        OgeCalloc(size, __FILE__, __LINE__)
+#       define realloc(obj, size)  OgeRealloc(obj, size, __FILE__, __LINE__)
+#       define free(obj)           OgeFree(obj)
+#       define OGE_MALLOC_TAGGED(size, allocator) OgeMallocTagged(size, allocator, __FILE__, __LINE__)
+#       define OGE_CALLOC_TAGGED(size, allocator) OgeCallocTagged(size, allocator, __FILE__, __LINE__)
 
 extern void* OgeMalloc(size_t size, const char* file, int line);
 extern void* OgeCalloc(size_t size, const char* file, int line);
+extern void* OgeMallocTagged(size_t size, u16 allocator, const char* file, int line);
+extern void* OgeCallocTagged(size_t size, u16 allocator, const char* file, int line);
 extern void* OgeRealloc(void* obj, size_t size, const char* file, int line);
 extern void  OgeFree(void* obj);
+extern void  OgeFreeSized(void* obj, size_t size);
 extern void  OgeMemoryReport(int showAll);
 // TODO char* OgeMemoryReportString(int showAll);
+extern int   OgeMemorySiteCount(void);
+extern const OgeAllocSite* OgeMemoryGetSite(int index);
+extern int   OgeMemoryTopSites(const OgeAllocSite** sites, int maxSites, OgeSiteSort sortBy);
+extern void  OgeMemorySiteReport(int maxSites, OgeSiteSort sortBy);
+extern void  OgeMemoryLifetimeReport(int maxSites);
+extern void  OgeMemorySetStackDepth(int depth);
+extern u32   OgeMemoryGetStackId(void* obj);
+extern int   OgeMemoryGetStack(u32 stackId, void** frames, int maxFrames);
+extern void  OgeMemoryPrintStack(u32 stackId);
+extern void  OgeMemorySetSampleRate(size_t bytes);
+extern size_t OgeMemoryGetSampleRate(void);
+extern OgeHeapSnapshot* OgeMemorySnapshot(void);
+extern void  OgeMemorySnapshotFree(OgeHeapSnapshot* snapshot);
+extern OgeHeapSnapshotDiff* OgeMemorySnapshotDiff(const OgeHeapSnapshot* a, const OgeHeapSnapshot* b);
+extern void  OgeMemorySnapshotDiffFree(OgeHeapSnapshotDiff* diff);
+extern void  OgeMemorySnapshotDiffReport(const OgeHeapSnapshotDiff* diff, int maxSites);
+extern void  OgeMemoryFlushEvents(void);
+extern void  OgeMemorySetAllocatorName(u16 allocator, const char* name);
+extern void  OgeMemorySetAllocatorBudget(u16 allocator, size_t bytes);
+extern void  OgeMemorySetBudgetCallback(OgeBudgetCallback callback);
+extern bool  OgeMemoryGetAllocatorStats(u16 allocator, OgeAllocatorStats* stats);
+extern size_t OgeMemoryAllocatorLiveBytes(u16 allocator);
+extern void  OgeMemoryAllocatorFrame(void);
+extern void  OgeMemoryAllocatorReport(void);
+extern void  OgeMemorySetFragmentationInterval(int frames);
+extern void  OgeMemoryFragmentationReport(void);
+extern void  OgeMemoryFragmentationFrame(unsigned long frame);
 
-#ifdef OGE_MEMORY_IMPLEMENTATION
-
-#ifdef __cplusplus
-void* operator new(size_t size) {
-    return OgeMalloc(size, __FILE__, __LINE__);
-}
+#   endif // OGE_USE_LEAK_CHECK
 
-void operator delete(void* p) {
-    OgeFree(p);
-}
-#endif
+#   define OgeArenaCreate(arena, reserveBytes) OgeArenaCreateAt(arena, reserveBytes, __FILE__, __LINE__)
 
-#endif // ! OGE_MEMORY_IMPLEMENTATION
+extern bool  OgeArenaCreateAt(OgeVirtualArena* arena, size_t reserveBytes, const char* file, int line);
+extern void  OgeArenaDestroy(OgeVirtualArena* arena);
+extern bool  OgeArenaSetUsed(OgeVirtualArena* arena, size_t used);
+extern void* OgeArenaPush(OgeVirtualArena* arena, size_t size, size_t alignment);
+extern void  OgeArenaTrim(OgeVirtualArena* arena, size_t keepBytes);
 
-#   endif // OGE_USE_LEAK_CHECK
+extern bool  OgeFragmentationCompute(const OgeHeapSnapshot* snapshot, u16 allocator, OgeFragmentation* frag);
+extern void  OgeFragmentationReport(const OgeFragmentation* frag, const char* name);
 #endif // INCLUDE_OGE_MEMORY_H
@@ -0,0 +1,180 @@
+#ifndef __OGE_POOL_H__
+#define __OGE_POOL_H__
+
+/*
+ *  OGE Open Game Engine
+ *  Copyright (c) 2023 Steven Gay (lazalong@gmail.com)
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+/*
+  Typed object pool for the hot C++ types (entities, components...).
+
+  Usage:
+     static OgePool<Particle, 256> particles("particles", OGE_ALLOCATOR_FX);
+     Particle* p = particles.create(position, velocity);
+     ...
+     particles.destroy(p);
+
+   - The slot size and alignment are computed at compile time from T. A free slot holds the
+     next free slot, so there is no header per object and creating is a pop of the free list.
+   - The slots come from chunks of BlockCount slots. Only the chunks go through OgeMallocTagged():
+     the leak tracker, the allocator counters and the log see one block per chunk, named after
+     the pool, instead of one per object.
+   - The chunks are only freed by the destructor. With OGE_USE_LEAK_CHECK a pool destroyed with
+     live objects keeps its chunks so they show in OgeMemoryReport().
+   - Not thread safe: use one pool per thread or per system.
+*/
+
+#include "../Oge.h"
+#include "Memory.h"
+#include <new>      // placement new
+#include <utility>  // std::forward
+
+template <typename T, size_t BlockCount = 256>
+class OgePool
+{
+    static_assert(BlockCount > 0, "OgePool: BlockCount must be at least 1");
+
+    struct Slot
+    {
+        Slot* next;
+    };
+
+    struct Chunk
+    {
+        Chunk* next;
+    };
+
+public:
+    // A slot holds a T or, when free, the next free slot
+    static constexpr size_t SlotAlign = alignof(T) > alignof(void*) ? alignof(T) : alignof(void*);
+    static constexpr size_t SlotSize = ((sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*)) + SlotAlign - 1) / SlotAlign * SlotAlign;
+    // The slots start after the chunk link, on their alignment. OgeMalloc only guarantees OGE_MEMORY_ALIGNMENT.
+    static constexpr size_t SlotOffset = (sizeof(Chunk) + SlotAlign - 1) / SlotAlign * SlotAlign;
+    static constexpr size_t ChunkPadding = SlotAlign > OGE_MEMORY_ALIGNMENT ? SlotAlign - OGE_MEMORY_ALIGNMENT : 0;
+    static constexpr size_t ChunkBytes = ChunkPadding + SlotOffset + SlotSize * BlockCount;
+
+    explicit OgePool(const char* name = "OgePool", u16 allocator = 0)
+        : _name(name), _allocator(allocator), _chunks(NULL), _free(NULL), _next(NULL), _end(NULL),
+          _liveCount(0), _chunkCount(0)
+    {
+    }
+
+    ~OgePool()
+    {
+#if OGE_USE_LEAK_CHECK
+        if (_liveCount != 0) {
+            printf("OgePool %s destroyed with %llu live objects: its chunks are kept for the leak report\n",
+                _name, (unsigned long long)_liveCount);
+            return;
+        }
+#endif
+        while (_chunks != NULL) {
+            Chunk* next = _chunks->next;
+            OgeFree(_chunks);
+            _chunks = next;
+        }
+    }
+
+    OgePool(const OgePool&) = delete;
+    OgePool& operator=(const OgePool&) = delete;
+
+    // NULL when a chunk can't be allocated
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        void* slot = allocate();
+        if (slot == NULL)
+            return NULL;
+        return new (slot) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object)
+    {
+        if (object == NULL)
+            return;
+        object->~T();
+        release(object);
+    }
+
+    // Raw slot: the caller constructs the object
+    void* allocate()
+    {
+        Slot* slot = _free;
+        if (slot != NULL)
+            _free = slot->next;
+        else {
+            if (_next == _end && !grow())
+                return NULL;
+            slot = (Slot*)_next;
+            _next += SlotSize;
+        }
+        _liveCount++;
+        return slot;
+    }
+
+    void release(void* object)
+    {
+        Slot* slot = (Slot*)object;
+        slot->next = _free;
+        _free = slot;
+        _liveCount--;
+    }
+
+    size_t liveCount() const { return _liveCount; }
+    size_t capacity() const { return _chunkCount * BlockCount; }
+    size_t chunkCount() const { return _chunkCount; }
+    const char* name() const { return _name; }
+
+private:
+    // The new chunk is bumped through: its slots aren't threaded in the free list up front
+    bool grow()
+    {
+#if OGE_USE_LEAK_CHECK
+        char* block = (char*)OgeMallocTagged(ChunkBytes, _allocator, _name, 0);
+#else
+        char* block = (char*)OgeMallocTagged(ChunkBytes, _allocator);
+#endif
+        if (block == NULL)
+            return false;
+
+        Chunk* chunk = (Chunk*)block;
+        chunk->next = _chunks;
+        _chunks = chunk;
+        _chunkCount++;
+
+        size_t first = ((size_t)block + SlotOffset + SlotAlign - 1) & ~(SlotAlign - 1);
+        _next = (char*)first;
+        _end = _next + SlotSize * BlockCount;
+        return true;
+    }
+
+    const char* _name;      // file name of the chunks in the tracker and the log
+    u16 _allocator;
+    Chunk* _chunks;
+    Slot* _free;
+    char* _next;            // bump pointer in the last chunk
+    char* _end;
+    size_t _liveCount;
+    size_t _chunkCount;
+};
+
+#endif // __OGE_POOL_H__
@@ -0,0 +1,515 @@
+// Allocator benchmark: libc malloc against the OGE allocator (OgeMalloc/OgeFree).
+// Build it once with OGE_USE_LEAK_CHECK=0 and once with OGE_USE_LEAK_CHECK=1, see README.md.
+
+// The standard headers go first: Memory.h replaces malloc/calloc/realloc/free by macros
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+#include "oge/Oge.h"
+#include "oge/utilities/Logger.h"
+#include "oge/utilities/Memory.h"
+
+#if defined(_MSC_VER)
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#   include <psapi.h> // GetProcessMemoryInfo
+#   pragma comment(lib, "psapi.lib")
+#endif
+
+#define BENCH_MAX_THREADS 64
+#define BENCH_LATENCY_STRIDE 32 // one op out of 32 is timed
+#define BENCH_CHURN_SLOTS 1024
+#define BENCH_QUEUE_SIZE 4096
+#define BENCH_FRAME_BURST 1000
+#define BENCH_REALLOC_MAX (1024 * 1024)
+
+//--------------- Allocators ---------------------
+
+typedef struct BenchAllocator BenchAllocator;
+
+struct BenchAllocator
+{
+    const char* name;
+    void* (*allocFn)(size_t size);
+    void* (*reallocFn)(void* obj, size_t size);
+    void  (*freeFn)(void* obj);
+};
+
+// The parentheses stop the expansion of the Memory.h macros: this is the C runtime
+static void* LibcAlloc(size_t size) { return (malloc)(size); }
+static void* LibcRealloc(void* obj, size_t size) { return (realloc)(obj, size); }
+static void  LibcFree(void* obj) { (free)(obj); }
+
+static void* OgeAlloc(size_t size) { return malloc(size); }
+static void* OgeReallocate(void* obj, size_t size) { return realloc(obj, size); }
+static void  OgeRelease(void* obj) { free(obj); }
+
+static const BenchAllocator _allocators[] = {
+    { "libc", LibcAlloc, LibcRealloc, LibcFree },
+    { "oge",  OgeAlloc,  OgeReallocate, OgeRelease },
+};
+
+//--------------- Helpers ---------------------
+
+typedef struct BenchThread BenchThread;
+
+// Filled by each worker thread
+struct BenchThread
+{
+    const BenchAllocator* allocator;
+    int index;
+    size_t ops;
+    u64 random;
+    std::vector<u32> latencies; // ns of the timed ops
+};
+
+typedef struct BenchResult BenchResult;
+
+struct BenchResult
+{
+    const char* workload;
+    const char* allocator;
+    int threads;
+    size_t ops;
+    double seconds;
+    double opsPerSecond;
+    u32 p50, p90, p99, p999, max; // ns
+    size_t rss;
+    size_t peakRss;
+};
+
+static std::atomic<int> _startFlag;
+static std::atomic<int> _stopFlag;
+static bool _useLogger;
+static u32 _timerOverhead;
+
+inline u64 BenchNow()
+{
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline u32 BenchRandom(BenchThread* thread)
+{
+    // xorshift64
+    thread->random ^= thread->random << 13;
+    thread->random ^= thread->random >> 7;
+    thread->random ^= thread->random << 17;
+    return (u32)(thread->random >> 16);
+}
+
+inline void BenchRecord(BenchThread* thread, u64 start, u64 end)
+{
+    u64 ns = end - start;
+    ns = ns > _timerOverhead ? ns - _timerOverhead : 0;
+    thread->latencies.push_back((u32)(ns < 0xFFFFFFFFull ? ns : 0xFFFFFFFFull));
+}
+
+inline void BenchWaitStart()
+{
+    while (_startFlag.load(std::memory_order_acquire) == 0)
+        std::this_thread::yield();
+}
+
+// Resident set size of the process. 'peak' is the high water mark since the start.
+static void BenchMemoryUsage(size_t* rss, size_t* peak)
+{
+    *rss = 0;
+    *peak = 0;
+#if defined(_MSC_VER)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        *rss = counters.WorkingSetSize;
+        *peak = counters.PeakWorkingSetSize;
+    }
+#elif defined(__linux__)
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file == NULL)
+        return;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long long kb;
+        if (sscanf(line, "VmRSS: %llu kB", &kb) == 1)
+            *rss = (size_t)kb * 1024;
+        else if (sscanf(line, "VmHWM: %llu kB", &kb) == 1)
+            *peak = (size_t)kb * 1024;
+    }
+    fclose(file);
+#endif
+}
+
+static void BenchCalibrateTimer()
+{
+    u64 best = ~0ull;
+    for (int i = 0; i < 1000; i++) {
+        u64 start = BenchNow();
+        u64 end = BenchNow();
+        if (end - start < best)
+            best = end - start;
+    }
+    _timerOverhead = (u32)best;
+}
+
+//--------------- Workloads ---------------------
+
+// Small objects allocated and freed in random order
+static void BenchChurn(BenchThread* thread)
+{
+    const BenchAllocator* a = thread->allocator;
+    void* slots[BENCH_CHURN_SLOTS] = { 0 };
+    BenchWaitStart();
+
+    for (size_t i = 0; i < thread->ops; i++) {
+        u32 r = BenchRandom(thread);
+        u32 slot = r & (BENCH_CHURN_SLOTS - 1);
+        size_t size = 16 + (r >> 10) % 240;
+        bool timed = (i % BENCH_LATENCY_STRIDE) == 0;
+
+        u64 start = timed ? BenchNow() : 0;
+        if (slots[slot] != NULL)
+            a->freeFn(slots[slot]);
+        slots[slot] = a->allocFn(size);
+        if (timed)
+            BenchRecord(thread, start, BenchNow());
+        *(char*)slots[slot] = (char)i;
+    }
+
+    for (int s = 0; s < BENCH_CHURN_SLOTS; s++) {
+        if (slots[s] != NULL)
+            a->freeFn(slots[s]);
+    }
+}
+
+typedef struct BenchQueue BenchQueue;
+
+// Single producer, single consumer ring
+struct BenchQueue
+{
+    alignas(64) std::atomic<size_t> head; // written by the consumer
+    alignas(64) std::atomic<size_t> tail; // written by the producer
+    void* items[BENCH_QUEUE_SIZE];
+};
+
+static BenchQueue _queues[BENCH_MAX_THREADS / 2];
+
+// Even threads allocate, odd threads free the blocks of the previous thread
+static void BenchProducerConsumer(BenchThread* thread)
+{
+    const BenchAllocator* a = thread->allocator;
+    BenchQueue* queue = &_queues[thread->index / 2];
+    bool producer = (thread->index & 1) == 0;
+    BenchWaitStart();
+
+    for (size_t i = 0; i < thread->ops; i++) {
+        bool timed = (i % BENCH_LATENCY_STRIDE) == 0;
+
+        if (producer) {
+            size_t tail = queue->tail.load(std::memory_order_relaxed);
+            while (tail - queue->head.load(std::memory_order_acquire) == BENCH_QUEUE_SIZE)
+                std::this_thread::yield();
+
+            size_t size = 16 + BenchRandom(thread) % 496;
+            u64 start = timed ? BenchNow() : 0;
+            void* ptr = a->allocFn(size);
+            if (timed)
+                BenchRecord(thread, start, BenchNow());
+            *(char*)ptr = (char)i;
+
+            queue->items[tail & (BENCH_QUEUE_SIZE - 1)] = ptr;
+            queue->tail.store(tail + 1, std::memory_order_release);
+        }
+        else {
+            size_t head = queue->head.load(std::memory_order_relaxed);
+            while (queue->tail.load(std::memory_order_acquire) == head)
+                std::this_thread::yield();
+
+            void* ptr = queue->items[head & (BENCH_QUEUE_SIZE - 1)];
+            queue->head.store(head + 1, std::memory_order_release);
+
+            u64 start = timed ? BenchNow() : 0;
+            a->freeFn(ptr);
+            if (timed)
+                BenchRecord(thread, start, BenchNow());
+        }
+    }
+}
+
+// Buffers growing by 1.5x up to 1MB, like a dynamic array
+static void BenchReallocGrowth(BenchThread* thread)
+{
+    const BenchAllocator* a = thread->allocator;
+    void* ptr = NULL;
+    size_t size = 16;
+    BenchWaitStart();
+
+    for (size_t i = 0; i < thread->ops; i++) {
+        bool timed = (i % BENCH_LATENCY_STRIDE) == 0;
+
+        u64 start = timed ? BenchNow() : 0;
+        ptr = a->reallocFn(ptr, size);
+        if (timed)
+            BenchRecord(thread, start, BenchNow());
+        ((char*)ptr)[size - 1] = (char)i;
+
+        size = size + size / 2;
+        if (size > BENCH_REALLOC_MAX) {
+            a->freeFn(ptr);
+            ptr = NULL;
+            size = 16;
+        }
+    }
+
+    if (ptr != NULL)
+        a->freeFn(ptr);
+}
+
+// Each frame allocates a burst of objects and frees them all at the end of the frame.
+// The first thread ends the frames of the logger.
+static void BenchFrameBursts(BenchThread* thread)
+{
+    const BenchAllocator* a = thread->allocator;
+    void* objects[BENCH_FRAME_BURST];
+    int frame = 0;
+    BenchWaitStart();
+
+    for (size_t i = 0; i < thread->ops; frame++) {
+        int count = 0;
+        for (; count < BENCH_FRAME_BURST && i < thread->ops; count++, i++) {
+            size_t size = 16 + BenchRandom(thread) % 1008;
+            bool timed = (i % BENCH_LATENCY_STRIDE) == 0;
+
+            u64 start = timed ? BenchNow() : 0;
+            objects[count] = a->allocFn(size);
+            if (timed)
+                BenchRecord(thread, start, BenchNow());
+            *(char*)objects[count] = (char)i;
+        }
+
+        // Odd objects first, then the even ones: not the allocation order
+        for (int o = 1; o < count; o += 2)
+            a->freeFn(objects[o]);
+        for (int o = 0; o < count; o += 2)
+            a->freeFn(objects[o]);
+
+        if (thread->index == 0)
+            OgeLogUpdate(16.0f, frame);
+    }
+}
+
+// The workloads without frames have their allocation events written and the log flushed by a timer, like a server
+static void BenchFlusher()
+{
+    while (_stopFlag.load(std::memory_order_acquire) == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        OgeLogFlush();
+    }
+}
+
+typedef struct BenchWorkload BenchWorkload;
+
+struct BenchWorkload
+{
+    const char* name;
+    void (*run)(BenchThread* thread);
+    bool pairs;     // needs an even nb of threads
+    bool frames;    // calls OgeLogUpdate()
+};
+
+static const BenchWorkload _workloads[] = {
+    { "churn", BenchChurn, false, false },
+    { "producer_consumer", BenchProducerConsumer, true, false },
+    { "realloc_growth", BenchReallocGrowth, false, false },
+    { "frame_bursts", BenchFrameBursts, false, true },
+};
+
+//--------------- Runner ---------------------
+
+static u32 BenchPercentile(std::vector<u32>& values, double percentile)
+{
+    if (values.empty())
+        return 0;
+    size_t n = (size_t)(percentile * (double)(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+static BenchResult BenchRun(const BenchWorkload* workload, const BenchAllocator* allocator, int threadCount, size_t opsPerThread)
+{
+    std::vector<BenchThread> threads(threadCount);
+    for (int t = 0; t < threadCount; t++) {
+        threads[t].allocator = allocator;
+        threads[t].index = t;
+        threads[t].ops = opsPerThread;
+        threads[t].random = 0x9E3779B97F4A7C15ull * (u64)(t + 1);
+        threads[t].latencies.reserve(opsPerThread / BENCH_LATENCY_STRIDE + 1);
+    }
+    for (int q = 0; q < BENCH_MAX_THREADS / 2; q++) {
+        _queues[q].head = 0;
+        _queues[q].tail = 0;
+    }
+
+    _startFlag = 0;
+    _stopFlag = 0;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++)
+        workers.emplace_back(workload->run, &threads[t]);
+    std::thread flusher;
+    if (_useLogger && !workload->frames)
+        flusher = std::thread(BenchFlusher);
+
+    u64 start = BenchNow();
+    _startFlag.store(1, std::memory_order_release);
+    for (std::thread& worker : workers)
+        worker.join();
+    u64 end = BenchNow();
+    _stopFlag.store(1, std::memory_order_release);
+    if (flusher.joinable())
+        flusher.join();
+
+    std::vector<u32> latencies;
+    for (BenchThread& thread : threads)
+        latencies.insert(latencies.end(), thread.latencies.begin(), thread.latencies.end());
+
+    BenchResult result;
+    memset(&result, 0, sizeof(result));
+    result.workload = workload->name;
+    result.allocator = allocator->name;
+    result.threads = threadCount;
+    result.ops = opsPerThread * threadCount;
+    result.seconds = (double)(end - start) * 1e-9;
+    result.opsPerSecond = result.seconds > 0 ? (double)result.ops / result.seconds : 0;
+    result.p50 = BenchPercentile(latencies, 0.50);
+    result.p90 = BenchPercentile(latencies, 0.90);
+    result.p99 = BenchPercentile(latencies, 0.99);
+    result.p999 = BenchPercentile(latencies, 0.999);
+    result.max = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+    BenchMemoryUsage(&result.rss, &result.peakRss);
+    return result;
+}
+
+static void BenchWriteJson(const char* filename, const std::vector<BenchResult>& results, size_t opsPerThread)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Can't write %s\n", filename);
+        return;
+    }
+
+    fprintf(file, "{\n  \"config\": {\"leak_check\": %d, \"sample_rate\": %llu, \"stack_capture\": %d, \"logger\": %s, \"ops_per_thread\": %llu},\n",
+        OGE_USE_LEAK_CHECK, (unsigned long long)OGE_MEMORY_SAMPLE_RATE, OGE_USE_STACK_CAPTURE,
+        _useLogger ? "true" : "false", (unsigned long long)opsPerThread);
+    fprintf(file, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult* r = &results[i];
+        fprintf(file, "    {\"workload\": \"%s\", \"allocator\": \"%s\", \"threads\": %d, \"ops\": %llu, \"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+            "\"p50_ns\": %u, \"p90_ns\": %u, \"p99_ns\": %u, \"p999_ns\": %u, \"max_ns\": %u, \"rss_bytes\": %llu, \"peak_rss_bytes\": %llu}%s\n",
+            r->workload, r->allocator, r->threads, (unsigned long long)r->ops, r->seconds, r->opsPerSecond,
+            r->p50, r->p90, r->p99, r->p999, r->max, (unsigned long long)r->rss, (unsigned long long)r->peakRss,
+            i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+static void BenchUsage()
+{
+    printf("Usage: AllocBenchmark [--threads N] [--ops N] [--workload NAME] [--logger FILE] [--ndjson] [--telemetry] [--json FILE]\n");
+    printf("  --threads N      max nb of threads, the runs use 1, 2, 4... N threads (default: nb of cores, max 8)\n");
+    printf("  --ops N          operations per thread (default: 200000)\n");
+    printf("  --workload NAME  churn, producer_consumer, realloc_growth or frame_bursts (default: all)\n");
+    printf("  --logger FILE    create a JSON logger so the allocation events are written (i.e. /dev/null)\n");
+    printf("  --ndjson         the logger is a OGE_LOGTYPE_NDJSON one, readable while the benchmark runs\n");
+    printf("  --telemetry      publish the counters for samples/TelemetryMonitor at each frame of frame_bursts\n");
+    printf("  --json FILE      machine readable summary (default: alloc_benchmark.json)\n");
+}
+
+int main(int argc, char* argv[]) {
+    int maxThreads = (int)std::thread::hardware_concurrency();
+    size_t opsPerThread = 200000;
+    const char* workloadName = NULL;
+    const char* logFile = NULL;
+    const char* jsonFile = "alloc_benchmark.json";
+    bool telemetry = false;
+    OgeLogType logType = OGE_LOGTYPE_JSON;
+
+    if (maxThreads <= 0)
+        maxThreads = 1;
+    if (maxThreads > 8)
+        maxThreads = 8;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            maxThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc)
+            opsPerThread = (size_t)atoll(argv[++i]);
+        else if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc)
+            workloadName = argv[++i];
+        else if (strcmp(argv[i], "--logger") == 0 && i + 1 < argc)
+            logFile = argv[++i];
+        else if (strcmp(argv[i], "--ndjson") == 0)
+            logType = OGE_LOGTYPE_NDJSON;
+        else if (strcmp(argv[i], "--telemetry") == 0)
+            telemetry = true;
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonFile = argv[++i];
+        else {
+            BenchUsage();
+            return 1;
+        }
+    }
+    maxThreads = maxThreads < 1 ? 1 : (maxThreads > BENCH_MAX_THREADS ? BENCH_MAX_THREADS : maxThreads);
+
+    if (logFile != NULL) {
+        OgeCreateLogger(logFile, logType, 0x7FFFFFFF, false);
+        _useLogger = true;
+    }
+
+    if (telemetry && !OgeTelemetryOpen(NULL))
+        printf("Can't create the telemetry block %s\n", OGE_TELEMETRY_NAME);
+
+    BenchCalibrateTimer();
+
+    printf("Oge v%s allocator benchmark: OGE_USE_LEAK_CHECK=%d OGE_MEMORY_SAMPLE_RATE=%llu logger=%s\n",
+        OGE_VERSION, OGE_USE_LEAK_CHECK, (unsigned long long)OGE_MEMORY_SAMPLE_RATE, _useLogger ? logFile : "none");
+    printf("%-18s %-5s %7s %14s %8s %8s %8s %8s %10s %10s\n",
+        "workload", "alloc", "threads", "ops/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns", "rss MB");
+
+    std::vector<BenchResult> results;
+    for (const BenchWorkload& workload : _workloads) {
+        if (workloadName != NULL && strcmp(workloadName, workload.name) != 0)
+            continue;
+
+        // 1, 2, 4... maxThreads. The producer/consumer threads go by pairs.
+        std::vector<int> threadCounts;
+        for (int threads = 1; ; threads *= 2) {
+            int count = threads < maxThreads ? threads : maxThreads;
+            if (workload.pairs)
+                count = count < 2 ? 2 : count & ~1;
+            if (threadCounts.empty() || threadCounts.back() != count)
+                threadCounts.push_back(count);
+            if (threads >= maxThreads)
+                break;
+        }
+
+        for (int count : threadCounts) {
+            for (const BenchAllocator& allocator : _allocators) {
+                BenchResult r = BenchRun(&workload, &allocator, count, opsPerThread);
+                printf("%-18s %-5s %7d %14.0f %8u %8u %8u %8u %10u %10.1f\n",
+                    r.workload, r.allocator, r.threads, r.opsPerSecond,
+                    r.p50, r.p90, r.p99, r.p999, r.max, (double)r.rss / (1024.0 * 1024.0));
+                results.push_back(r);
+            }
+        }
+    }
+
+    if (_useLogger)
+        OgeLogCloseFile();
+    OgeTelemetryClose();
+
+    BenchWriteJson(jsonFile, results, opsPerThread);
+    printf("Summary written to %s\n", jsonFile);
+    return 0;
+}
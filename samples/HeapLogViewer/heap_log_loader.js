@@ -0,0 +1,327 @@
+// Loader of the heap logs into typed array columns
+//
+// Formats:
+//  - json: {"log":[ {"type":"mem", "p1":"10", ...}, ... ]} written by the OGE_LOGTYPE_JSON logger,
+//          or one record per line without the {"log":[ ]} written by the OGE_LOGTYPE_NDJSON logger
+//  - text: "mem: frame heap action address size sequence thread file:line" lines written by the OGE_LOGTYPE_TEXT logger.
+//          The other lines are messages
+//  - binary: trace saved by TraceReplay --save, a "OGETRACE" header and 24 bytes per record
+//
+// The file is read by chunks so a big log never is one string. The page runs the loader in
+// a Web Worker (loadLogFile); when the worker can't be created (Chrome refuses them for a page
+// opened from file://) it runs on the page and the UI gets control back between two chunks.
+
+const loaderChunkSize = 4 * 1024 * 1024;
+
+// Index = action code of the columns. The first 5 have a color, the others are drawn like 'add'.
+const actionNames = ['add', 'rem', 'clr', 'del', 'err', 'commit', 'decommit', '?'];
+const actionCodes = { 'add': 0, 'rem': 1, 'clr': 2, 'del': 3, 'err': 4, 'commit': 5, 'decommit': 6 };
+
+// OgeLogAction of the binary traces to action code
+const traceActions = [0, 3, 5, 6, 2, 1, 4, 7];
+
+const eventMem = 0;
+const eventLog = 1;
+const eventOther = 2;
+
+// Growable columns: one entry per event of the log
+function EventColumns() {
+   this.count = 0;
+   this.capacity = 0;
+   this.nbHeaps = 0;
+   this.valueMax = [];     // per heap: max of address + size
+   this.texts = {};        // text of the events that aren't 'mem', by index
+
+   this.grow = function() {
+      let capacity = Math.max(65536, this.capacity * 2);
+      let grow = (Type, old) => { let a = new Type(capacity); if (old) a.set(old); return a; };
+      this.type = grow(Uint8Array, this.type);
+      this.frame = grow(Uint32Array, this.frame);
+      this.heap = grow(Uint16Array, this.heap);
+      this.action = grow(Uint8Array, this.action);
+      this.address = grow(Float64Array, this.address);
+      this.size = grow(Float64Array, this.size);
+      this.capacity = capacity;
+   }
+
+   this.add = function(type, frame, heap, action, address, size, text) {
+      if (this.count === this.capacity)
+         this.grow();
+      let n = this.count++;
+      this.type[n] = type;
+      this.frame[n] = frame;
+      this.heap[n] = heap;
+      this.action[n] = action;
+      this.address[n] = address;
+      this.size[n] = size;
+      if (type === eventMem) {
+         if (heap + 1 > this.nbHeaps) {
+            for (let h = this.nbHeaps; h <= heap; h++)
+               this.valueMax[h] = 0;
+            this.nbHeaps = heap + 1;
+         }
+         if (address + size > this.valueMax[heap])
+            this.valueMax[heap] = address + size;
+      }
+      else
+         this.texts[n] = text;
+   }
+
+   this.addRecord = function(r) {
+      if (r.type === "mem") {
+         let action = r.p3 in actionCodes ? actionCodes[r.p3] : 7;
+         this.add(eventMem, parseInt(r.p1) || 0, parseInt(r.p2) || 0, action, parseInt(r.p4) || 0, parseInt(r.p5) || 0);
+      }
+      else
+         this.add(r.type === "log" ? eventLog : eventOther, parseInt(r.p1) || 0, 0, 0, 0, 0,
+            r.type + " " + r.p1 + " " + r.p2 + " " + r.p3 + " " + r.p4 + " " + r.p5);
+   }
+
+   // Plain object with the columns cut to 'count': it can be posted by a worker
+   this.result = function() {
+      let cut = a => a.slice(0, this.count);
+      return { count: this.count, nbHeaps: this.nbHeaps, valueMax: this.valueMax, texts: this.texts,
+         type: cut(this.type), frame: cut(this.frame), heap: cut(this.heap), action: cut(this.action),
+         address: cut(this.address), size: cut(this.size) };
+   }
+}
+
+// Text shown for the event n of the columns
+function eventText(events, n) {
+   if (events.type[n] !== eventMem)
+      return events.texts[n];
+   return "mem " + events.frame[n] + " " + events.heap[n] + " " + actionNames[events.action[n]]
+      + " " + events.address[n] + " " + events.size[n];
+}
+
+const memKeys = ['"p1":"', '"p2":"', '"p3":"', '"p4":"', '"p5":"', '"p6":"'];
+
+// The records are cut out without parsing the whole file: from a '{' to its '}' outside of
+// the strings. Each record is then small enough for JSON.parse. A record can span two chunks.
+function JsonLogParser(columns) {
+   this.pending = "";
+   this.errors = 0;
+
+   this.push = function(chunk) {
+      let text = this.pending + chunk;
+      let pos = 0;
+      this.pending = "";
+      for (;;) {
+         let start = text.indexOf('{', pos);
+         if (start < 0)
+            return;
+         // The {"log":[ around the records
+         if (text.startsWith('{"log"', start)) {
+            pos = start + 1;
+            continue;
+         }
+         let end = this.memRecord(text, start);
+         if (end >= 0) {
+            pos = end + 1;
+            continue;
+         }
+         let inString = false;
+         for (let i = start + 1; i < text.length; i++) {
+            let c = text.charCodeAt(i);
+            if (inString) {
+               if (c === 92) // backslash
+                  i++;
+               else if (c === 34) // quote
+                  inString = false;
+            }
+            else if (c === 34)
+               inString = true;
+            else if (c === 125) { // }
+               end = i;
+               break;
+            }
+         }
+         if (end < 0) {
+            this.pending = text.substring(start);
+            return;
+         }
+         try {
+            columns.addRecord(JSON.parse(text.substring(start, end + 1)));
+         }
+         catch (e) {
+            this.errors++;
+         }
+         pos = end + 1;
+      }
+   }
+
+   this.finish = function() {
+      this.pending = "";
+   }
+
+   // Fast path of the mem records written by the logger, most of a log: the values are read
+   // in place. Return the index of the closing '}', or -1 to let the slow path scan the record.
+   this.memRecord = function(text, start) {
+      if (!text.startsWith('{"type":"mem"', start))
+         return -1;
+
+      let values = this.values;
+      let p = start + 13;
+      for (let k = 0; k < 6; k++) {
+         let key = text.indexOf(memKeys[k], p);
+         let close = key < 0 ? -1 : text.indexOf('"', key + 6);
+         if (close < 0) {
+            if (k < 5)
+               return -1;
+            break;
+         }
+         // p6 is optional: stop at the end of the record
+         if (k === 5 && text.indexOf('}', p) < key)
+            break;
+         values[k] = text.substring(key + 6, close);
+         p = close + 1;
+      }
+      let end = text.indexOf('}', p);
+      if (end < 0)
+         return -1;
+
+      // Number() is faster than parseInt() and the logger writes plain decimals
+      let action = actionCodes[values[2]];
+      columns.add(eventMem, Number(values[0]) || 0, Number(values[1]) || 0, action !== undefined ? action : 7,
+         Number(values[3]) || 0, Number(values[4]) || 0);
+      return end;
+   }
+   this.values = [];
+}
+
+// mem: 10 0 add 101084 1000 57 2 main.cpp:12
+function TextLogParser(columns) {
+   this.pending = "";
+   this.errors = 0;
+
+   this.line = function(line) {
+      if (line.length === 0)
+         return;
+      if (line.startsWith("mem: ")) {
+         let f = line.substring(5).split(" ");
+         if (f.length < 5) {
+            this.errors++;
+            return;
+         }
+         let action = f[2] in actionCodes ? actionCodes[f[2]] : 7;
+         columns.add(eventMem, Number(f[0]) || 0, Number(f[1]) || 0, action, Number(f[3]) || 0, Number(f[4]) || 0);
+      }
+      else
+         columns.add(eventLog, 0, 0, 0, 0, 0, line);
+   }
+
+   this.push = function(chunk) {
+      let lines = (this.pending + chunk).split(/\r?\n/);
+      this.pending = lines.pop();
+      for (let line of lines)
+         this.line(line);
+   }
+
+   this.finish = function() {
+      this.line(this.pending);
+      this.pending = "";
+   }
+}
+
+// OgeTraceHeader: magic[8], u32 version, u32 recordSize, u64 count
+// OgeTraceRecord: u64 address, u64 size, u32 frame, u16 allocator, u8 action, u8 reserved
+function TraceParser(columns) {
+   this.recordSize = 0;
+   this.errors = 0;
+
+   this.header = function(view) {
+      this.recordSize = view.getUint32(12, true);
+      return view.getUint32(8, true) === 1 && this.recordSize >= 24;
+   }
+
+   // 'view' has whole records
+   this.push = function(view) {
+      for (let p = 0; p + this.recordSize <= view.byteLength; p += this.recordSize) {
+         let action = view.getUint8(p + 22);
+         columns.add(eventMem, view.getUint32(p + 16, true), view.getUint16(p + 20, true),
+            action < traceActions.length ? traceActions[action] : 7,
+            Number(view.getBigUint64(p, true)), Number(view.getBigUint64(p + 8, true)));
+      }
+   }
+}
+
+// Load a File or Blob. onProgress(loadedBytes, totalBytes, nbEvents) is called after each chunk.
+async function loadLog(file, onProgress) {
+   let columns = new EventColumns();
+   let head = new Uint8Array(await file.slice(0, 24).arrayBuffer());
+   let magic = String.fromCharCode.apply(null, head.subarray(0, 8));
+
+   if (magic === "OGETRACE") {
+      let parser = new TraceParser(columns);
+      if (head.length < 24 || !parser.header(new DataView(head.buffer)))
+         throw new Error("Unsupported trace version");
+      let step = Math.floor(loaderChunkSize / parser.recordSize) * parser.recordSize;
+      for (let offset = 24; offset < file.size; offset += step) {
+         parser.push(new DataView(await file.slice(offset, offset + step).arrayBuffer()));
+         onProgress(Math.min(offset + step, file.size), file.size, columns.count);
+      }
+   }
+   else {
+      let text = String.fromCharCode.apply(null, head).trimStart();
+      let parser = text.startsWith("{") ? new JsonLogParser(columns) : new TextLogParser(columns);
+      let decoder = new TextDecoder("utf-8");
+      for (let offset = 0; offset < file.size; offset += loaderChunkSize) {
+         let chunk = await file.slice(offset, offset + loaderChunkSize).arrayBuffer();
+         parser.push(decoder.decode(chunk, { stream: true }));
+         onProgress(Math.min(offset + loaderChunkSize, file.size), file.size, columns.count);
+      }
+      parser.push(decoder.decode());
+      parser.finish();
+   }
+   return columns.result();
+}
+
+// Log already in a string, i.e. the test log of the page
+function parseLogString(text) {
+   let columns = new EventColumns();
+   let parser = text.trimStart().startsWith("{") ? new JsonLogParser(columns) : new TextLogParser(columns);
+   parser.push(text);
+   parser.finish();
+   return columns.result();
+}
+
+// Page side: load in a worker, or on the page if the worker can't be created
+function loadLogFile(file, onProgress, onDone, onError) {
+   let loadHere = () => loadLog(file, onProgress).then(onDone, onError);
+   let worker;
+   try {
+      worker = new Worker("heap_log_loader.js");
+   }
+   catch (e) {
+      loadHere();
+      return;
+   }
+   worker.onmessage = function(e) {
+      if (e.data.progress)
+         onProgress(e.data.loaded, e.data.total, e.data.count);
+      else {
+         worker.terminate();
+         if (e.data.events)
+            onDone(e.data.events);
+         else
+            onError(e.data.error);
+      }
+   }
+   worker.onerror = function(e) {
+      e.preventDefault();
+      worker.terminate();
+      loadHere();
+   }
+   worker.postMessage({ file: file });
+}
+
+// Worker side
+if (typeof WorkerGlobalScope !== 'undefined' && self instanceof WorkerGlobalScope) {
+   onmessage = function(e) {
+      let progress = (loaded, total, count) => postMessage({ progress: true, loaded: loaded, total: total, count: count });
+      loadLog(e.data.file, progress).then(
+         events => postMessage({ events: events },
+            [events.type.buffer, events.frame.buffer, events.heap.buffer, events.action.buffer, events.address.buffer, events.size.buffer]),
+         error => postMessage({ error: String(error) }));
+   }
+}
@@ -121,3 +121,78 @@ function drawBox(cw, x,y,w,h,color) {
 
 heap = new Heap(valueMax, nbLines);
 */
+
+// Incremental rendering of a heap canvas
+//
+// The canvas is a grid of cells: 1 pixel wide and 10 pixels high rows of 1024 cells.
+// Each cell keeps the index of the last event drawn on it, so a step forward only
+// changes the cells of one event, and the rows changed are written in an ImageData
+// instead of one fillRect per event.
+const cellWidth = 1024;
+const cellHeight = 10;
+
+function hexToRgb(color) {
+   let v = parseInt(color.substring(1), 16);
+   return [(v >> 16) & 255, (v >> 8) & 255, v & 255];
+}
+
+// scale = bytes per cell
+function HeapView(canvasId, scale) {
+   this.canvas = document.getElementById(canvasId);
+   this.ctx = this.canvas.getContext('2d');
+   this.rows = Math.ceil(this.canvas.height / cellHeight);
+   this.scale = scale > 0 ? scale : 1;
+   this.cells = new Int32Array(cellWidth * this.rows).fill(-1); // -1 = nothing drawn
+   this.image = this.ctx.createImageData(this.canvas.width, this.canvas.height);
+   this.dirtyFirst = 0;            // rows to write in the ImageData
+   this.dirtyLast = this.rows - 1;
+
+   // Draw event 'n' covering [address, address + size[. At least one cell like the old boxes.
+   this.draw = function(n, address, size) {
+      let first = Math.floor(address / this.scale);
+      let last = Math.max(first, Math.ceil((address + size) / this.scale) - 1);
+      last = Math.min(last, this.cells.length - 1);
+      if (first > last)
+         return;
+      this.cells.fill(n, first, last + 1);
+      this.dirtyFirst = Math.min(this.dirtyFirst, Math.floor(first / cellWidth));
+      this.dirtyLast = Math.max(this.dirtyLast, Math.floor(last / cellWidth));
+   }
+
+   this.restore = function(cells) {
+      this.cells.set(cells);
+      this.dirtyFirst = 0;
+      this.dirtyLast = this.rows - 1;
+   }
+
+   // colorOf(n) = [r, g, b] of the event n. The edges of the rows and of the blocks are
+   // darkened like the strokeRect of the boxes.
+   this.render = function(colorOf, background) {
+      if (this.dirtyFirst > this.dirtyLast)
+         return;
+      let data = this.image.data;
+      let width = this.canvas.width;
+      let height = this.canvas.height;
+      let yFirst = this.dirtyFirst * cellHeight;
+      let yLast = Math.min(height, (this.dirtyLast + 1) * cellHeight);
+
+      for (let y = yFirst; y < yLast; y++) {
+         let row = Math.floor(y / cellHeight);
+         let rowEdge = (y % cellHeight) === 0;
+         let p = y * width * 4;
+         for (let x = 0; x < width; x++, p += 4) {
+            let n = x < cellWidth ? this.cells[row * cellWidth + x] : -1;
+            let c = n < 0 ? background : colorOf(n);
+            let edge = n >= 0 && (rowEdge || x === 0 || this.cells[row * cellWidth + x - 1] !== n);
+            let k = edge ? 0.5 : 1;
+            data[p] = c[0] * k;
+            data[p + 1] = c[1] * k;
+            data[p + 2] = c[2] * k;
+            data[p + 3] = 255;
+         }
+      }
+      this.ctx.putImageData(this.image, 0, 0, 0, yFirst, width, yLast - yFirst);
+      this.dirtyFirst = this.rows;
+      this.dirtyLast = -1;
+   }
+}
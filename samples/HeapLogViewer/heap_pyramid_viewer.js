@@ -0,0 +1,239 @@
+// Viewer of the occupancy pyramids written by samples/HeapPyramid (.pyr files)
+//
+// Each row of the canvas is one tile of the current level: 1024 cells of cellBytes << level bytes.
+// Only the tiles of the visible rows are read from the file (File.slice), the directory of a
+// level is read the first time the level is shown and the tiles are kept in a LRU cache.
+// The file is never read as a whole, a pyramid of several GB can be opened.
+
+const pyramidHeaderSize = 72;
+const pyramidHeapSize = 24;
+const pyramidKeyframeSize = 16;
+const pyramidLevelSize = 16;
+const pyramidTileSize = 24;
+const pyramidCacheTiles = 2048;
+
+async function readSlice(file, start, end) {
+   return new DataView(await file.slice(start, end).arrayBuffer());
+}
+
+function readU64(view, p) {
+   return Number(view.getBigUint64(p, true));
+}
+
+function PyramidFile(file) {
+   this.file = file;
+   this.directories = new Map();   // "keyframe/heap/level" -> { tiles: Float64Array, offsets: Float64Array }
+   this.tiles = new Map();         // file offset -> Uint8Array, in LRU order
+
+   this.open = async function() {
+      let view = await readSlice(this.file, 0, pyramidHeaderSize);
+      let magic = String.fromCharCode.apply(null, new Uint8Array(view.buffer, 0, 8));
+      if (view.byteLength < pyramidHeaderSize || magic !== "OGEPYRAM" || view.getUint32(8, true) !== 1)
+         throw new Error("Not a version 1 pyramid");
+      this.tileCells = view.getUint32(12, true);
+      this.cellBytes = view.getUint32(16, true);
+      this.levelCount = view.getUint32(20, true);
+      this.heapCount = view.getUint32(24, true);
+      this.keyframeCount = view.getUint32(28, true);
+      let heapsOffset = readU64(view, 32);
+      let keyframesOffset = readU64(view, 40);
+      this.levelsOffset = readU64(view, 48);
+      this.directoryOffset = readU64(view, 56);
+
+      // The heaps, keyframes and levels are small and follow each other
+      let tables = await readSlice(this.file, heapsOffset, this.directoryOffset);
+      this.heaps = [];
+      for (let h = 0; h < this.heapCount; h++) {
+         let p = h * pyramidHeapSize;
+         this.heaps.push({ base: readU64(tables, p), span: readU64(tables, p + 8),
+            heap: tables.getUint16(p + 16, true), levelCount: tables.getUint16(p + 18, true) });
+      }
+      this.keyframes = [];
+      for (let k = 0; k < this.keyframeCount; k++) {
+         let p = keyframesOffset - heapsOffset + k * pyramidKeyframeSize;
+         this.keyframes.push({ record: readU64(tables, p), frame: tables.getUint32(p + 8, true) });
+      }
+      this.levels = tables;
+      this.levelsStart = this.levelsOffset - heapsOffset;
+   }
+
+   this.level = function(keyframe, heap, level) {
+      let p = this.levelsStart + ((keyframe * this.heapCount + heap) * this.levelCount + level) * pyramidLevelSize;
+      return { firstTile: readU64(this.levels, p), tileCount: readU64(this.levels, p + 8) };
+   }
+
+   this.directory = async function(keyframe, heap, level) {
+      let key = keyframe + "/" + heap + "/" + level;
+      let directory = this.directories.get(key);
+      if (directory)
+         return directory;
+      let range = this.level(keyframe, heap, level);
+      let start = this.directoryOffset + range.firstTile * pyramidTileSize;
+      let view = range.tileCount > 0 ? await readSlice(this.file, start, start + range.tileCount * pyramidTileSize) : null;
+      directory = { tiles: new Float64Array(range.tileCount), offsets: new Float64Array(range.tileCount),
+         liveBytes: new Float64Array(range.tileCount) };
+      for (let i = 0; i < range.tileCount; i++) {
+         directory.tiles[i] = readU64(view, i * pyramidTileSize);
+         directory.offsets[i] = readU64(view, i * pyramidTileSize + 8);
+         directory.liveBytes[i] = readU64(view, i * pyramidTileSize + 16);
+      }
+      this.directories.set(key, directory);
+      return directory;
+   }
+
+   // Cells of the tiles [first, first + count[ of a level, null for the tiles without live bytes
+   this.readTiles = async function(keyframe, heap, level, first, count) {
+      let directory = await this.directory(keyframe, heap, level);
+      let cells = new Array(count).fill(null);
+      let i = lowerBound(directory.tiles, first);
+      let missing = [];
+      for (; i < directory.tiles.length && directory.tiles[i] < first + count; i++) {
+         let offset = directory.offsets[i];
+         let tile = this.tiles.get(offset);
+         if (tile) {
+            this.tiles.delete(offset);
+            this.tiles.set(offset, tile);
+            cells[directory.tiles[i] - first] = tile;
+         }
+         else
+            missing.push(i);
+      }
+
+      // The tiles of a level are consecutive in the file: one read for a run of missing tiles
+      for (let m = 0; m < missing.length; ) {
+         let run = m + 1;
+         while (run < missing.length && missing[run] === missing[run - 1] + 1)
+            run++;
+         let start = directory.offsets[missing[m]];
+         let bytes = new Uint8Array(await this.file.slice(start, start + (run - m) * this.tileCells).arrayBuffer());
+         for (let j = m; j < run; j++) {
+            let tile = bytes.subarray((j - m) * this.tileCells, (j - m + 1) * this.tileCells);
+            this.tiles.set(directory.offsets[missing[j]], tile);
+            cells[directory.tiles[missing[j]] - first] = tile;
+         }
+         m = run;
+      }
+      while (this.tiles.size > pyramidCacheTiles)
+         this.tiles.delete(this.tiles.keys().next().value);
+      return cells;
+   }
+}
+
+function lowerBound(array, value) {
+   let lo = 0;
+   let hi = array.length;
+   while (lo < hi) {
+      let mid = (lo + hi) >> 1;
+      if (array[mid] < value)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+// One canvas 1024 pixels wide, 'rowHeight' pixels per tile
+function PyramidView(canvasId, rowHeight) {
+   this.canvas = document.getElementById(canvasId);
+   this.context = this.canvas.getContext("2d");
+   this.rowHeight = rowHeight;
+   this.rows = Math.floor(this.canvas.height / rowHeight);
+   this.image = this.context.createImageData(this.canvas.width, this.rows * rowHeight);
+   this.pyramid = null;
+   this.keyframe = 0;
+   this.heap = 0;
+   this.level = 0;
+   this.firstTile = 0;
+   this.generation = 0;            // a render started before the last change is dropped
+   this.freeColor = hexToRgb("#f0f0f0");
+   this.liveColor = hexToRgb("#c03020");
+   this.outsideColor = hexToRgb("#808080");
+
+   this.cellBytes = function(level) {
+      return this.pyramid.cellBytes * Math.pow(2, level);
+   }
+
+   this.tileBytes = function(level) {
+      return this.cellBytes(level) * this.pyramid.tileCells;
+   }
+
+   // Shows the whole heap: its top level
+   this.reset = function() {
+      this.level = this.pyramid.heaps[this.heap].levelCount - 1;
+      this.firstTile = 0;
+   }
+
+   // Offset in the heap of the pixel x of the row
+   this.offsetAt = function(x, row) {
+      return ((this.firstTile + row) * this.pyramid.tileCells + x) * this.cellBytes(this.level);
+   }
+
+   // Zoom in (delta < 0) or out around the pixel x of the row
+   this.zoom = function(delta, x, row) {
+      let heap = this.pyramid.heaps[this.heap];
+      let level = Math.min(Math.max(this.level + delta, 0), heap.levelCount - 1);
+      if (level === this.level)
+         return false;
+      let offset = this.offsetAt(x, row);
+      this.level = level;
+      this.firstTile = Math.max(0, Math.floor(offset / this.tileBytes(level)) - row);
+      return true;
+   }
+
+   this.pan = function(rows) {
+      let lastTile = Math.floor(this.pyramid.heaps[this.heap].span / this.tileBytes(this.level));
+      let firstTile = Math.min(Math.max(this.firstTile + rows, 0), Math.max(lastTile - this.rows + 1, 0));
+      if (firstTile === this.firstTile)
+         return false;
+      this.firstTile = firstTile;
+      return true;
+   }
+
+   this.render = async function() {
+      let generation = ++this.generation;
+      let tiles = await this.pyramid.readTiles(this.keyframe, this.heap, this.level, this.firstTile, this.rows);
+      if (generation !== this.generation)
+         return;
+
+      let heap = this.pyramid.heaps[this.heap];
+      let cellBytes = this.cellBytes(this.level);
+      let width = this.image.width;
+      let data = this.image.data;
+      let free = this.freeColor;
+      let live = this.liveColor;
+      for (let row = 0; row < this.rows; row++) {
+         let cells = tiles[row];
+         let firstCell = (this.firstTile + row) * this.pyramid.tileCells;
+         for (let x = 0; x < width; x++) {
+            let color = free;
+            let r, g, b;
+            if ((firstCell + x) * cellBytes >= heap.span)
+               color = this.outsideColor;
+            if (cells && cells[x] > 0) {
+               // A few live bytes in a big cell stay visible
+               let f = 0.2 + 0.8 * cells[x] / 255;
+               r = free[0] + (live[0] - free[0]) * f;
+               g = free[1] + (live[1] - free[1]) * f;
+               b = free[2] + (live[2] - free[2]) * f;
+            }
+            else {
+               r = color[0];
+               g = color[1];
+               b = color[2];
+            }
+            for (let y = 0; y < this.rowHeight - 1; y++) {
+               let p = ((row * this.rowHeight + y) * width + x) * 4;
+               data[p] = r;
+               data[p + 1] = g;
+               data[p + 2] = b;
+               data[p + 3] = 255;
+            }
+            // Last line of the row: the separator
+            let p = ((row * this.rowHeight + this.rowHeight - 1) * width + x) * 4;
+            data[p] = data[p + 1] = data[p + 2] = 255;
+            data[p + 3] = 255;
+         }
+      }
+      this.context.putImageData(this.image, 0, 0);
+   }
+}
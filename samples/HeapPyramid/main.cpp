@@ -0,0 +1,402 @@
+// Builds the occupancy pyramids of the heaps of a log for the HeapLogViewer (pyramid.html).
+//
+// For each keyframe and heap the address range of the heap is cut in cells of 16 bytes
+// (level 0), 32 bytes (level 1)... up to the level where the whole heap is one tile.
+// A tile is one row of 1024 cells and each cell stores the live fraction of its bytes.
+// Only the tiles with live bytes are written, so the finest levels of a big heap stay small,
+// and the viewer reads only the tiles it shows.
+//
+// File layout (little endian):
+//
+//   PyramidHeader
+//   tiles           1024 bytes each: live fraction of the cells, 0 = free, 255 = full
+//   PyramidHeap     [heapCount]
+//   PyramidKeyframe [keyframeCount]
+//   PyramidLevel    [keyframeCount][heapCount][levelCount]: range of the directory
+//   PyramidTile     [directoryCount]: sorted by keyframe, heap, level then tile
+
+// The standard headers go first: Memory.h replaces malloc/calloc/realloc/free by macros
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <math.h>
+#include <string.h>
+
+#include "oge/Oge.h"
+#include "oge/utilities/Memory.h"
+#include "oge/utilities/LogReader.h"
+
+#define PYRAMID_MAGIC "OGEPYRAM"
+#define PYRAMID_VERSION 1
+#define PYRAMID_TILE_CELLS 1024
+#define PYRAMID_MAX_HEAPS OGE_MEMORY_MAX_ALLOCATORS
+
+typedef struct PyramidHeader PyramidHeader;
+
+struct PyramidHeader
+{
+    char magic[8];
+    u32 version;
+    u32 tileCells;
+    u32 cellBytes;      // of level 0
+    u32 levelCount;     // max of the heaps: the levels of a heap above its own count have no tiles
+    u32 heapCount;
+    u32 keyframeCount;
+    u64 heapsOffset;
+    u64 keyframesOffset;
+    u64 levelsOffset;
+    u64 directoryOffset;
+    u64 directoryCount;
+};
+
+typedef struct PyramidHeap PyramidHeap;
+
+// Cell c of level l covers [base + c * (cellBytes << l), base + (c + 1) * (cellBytes << l)[
+struct PyramidHeap
+{
+    u64 base;
+    u64 span;
+    u16 heap;           // allocator id
+    u16 levelCount;     // the top level has one tile
+    u32 reserved;
+};
+
+typedef struct PyramidKeyframe PyramidKeyframe;
+
+// State after 'record' records of the trace, the last one in 'frame'
+struct PyramidKeyframe
+{
+    u64 record;
+    u32 frame;
+    u32 reserved;
+};
+
+typedef struct PyramidLevel PyramidLevel;
+
+struct PyramidLevel
+{
+    u64 firstTile;      // in the directory
+    u64 tileCount;
+};
+
+typedef struct PyramidTile PyramidTile;
+
+struct PyramidTile
+{
+    u64 tile;           // tile nb in the level: its first cell is tile * tileCells
+    u64 offset;         // of its cells in the file
+    u64 liveBytes;
+};
+
+//--------------- Heaps ---------------------
+
+typedef std::map<u64, u64> BlockMap; // address -> size
+
+// Removes [address, address + size[ from the blocks: the decommits give back a part of a commit
+static void PyramidRemoveRange(BlockMap* blocks, u64 address, u64 size)
+{
+    u64 end = address + size;
+    BlockMap::iterator it = blocks->upper_bound(address);
+    if (it != blocks->begin())
+        --it;
+    while (it != blocks->end() && it->first < end) {
+        u64 blockStart = it->first;
+        u64 blockEnd = it->first + it->second;
+        if (blockEnd <= address) {
+            ++it;
+            continue;
+        }
+        it = blocks->erase(it);
+        if (blockStart < address)
+            (*blocks)[blockStart] = address - blockStart;
+        if (blockEnd > end)
+            it = blocks->emplace(end, blockEnd - end).first;
+    }
+}
+
+static void PyramidApply(BlockMap* blocks, const OgeTraceRecord* r)
+{
+    switch (r->action) {
+    case OGE_ACTION_ADD:
+    case OGE_ACTION_COMMIT:
+        (*blocks)[r->address] = r->size;
+        break;
+    case OGE_ACTION_DEL:
+    case OGE_ACTION_REM:
+        blocks->erase(r->address);
+        break;
+    case OGE_ACTION_DECOMMIT:
+        PyramidRemoveRange(blocks, r->address, r->size);
+        break;
+    default:
+        break;
+    }
+}
+
+//--------------- Tiles ---------------------
+
+typedef std::map<u64, std::vector<u64> > TileMap; // tile -> live bytes of its cells
+
+typedef struct PyramidWriter PyramidWriter;
+
+struct PyramidWriter
+{
+    FILE* file;
+    u64 offset;
+    std::vector<PyramidTile> directory;
+    std::vector<PyramidLevel> levels;
+    u64 tileBytes;      // written, for the report
+};
+
+// Level 0: the bytes of each block are added to the cells they overlap
+static void PyramidLevelZero(const BlockMap& blocks, const PyramidHeap* heap, u64 cellBytes, TileMap* tiles)
+{
+    for (const std::pair<const u64, u64>& block : blocks) {
+        if (block.second == 0 || block.first < heap->base)
+            continue;
+        u64 start = block.first - heap->base;
+        u64 end = start + block.second;
+        std::vector<u64>* cells = NULL;
+        u64 cellsTile = ~0ull;
+        for (u64 c = start / cellBytes; c * cellBytes < end; c++) {
+            u64 tile = c / PYRAMID_TILE_CELLS;
+            if (tile != cellsTile) {
+                std::vector<u64>& entry = (*tiles)[tile];
+                if (entry.empty())
+                    entry.resize(PYRAMID_TILE_CELLS, 0);
+                cells = &entry;
+                cellsTile = tile;
+            }
+            u64 lo = std::max(start, c * cellBytes);
+            u64 hi = std::min(end, (c + 1) * cellBytes);
+            (*cells)[c % PYRAMID_TILE_CELLS] += hi - lo;
+        }
+    }
+}
+
+// A cell of level l + 1 is two cells of level l
+static void PyramidParent(const TileMap& tiles, TileMap* parent)
+{
+    parent->clear();
+    for (const std::pair<const u64, std::vector<u64> >& tile : tiles) {
+        std::vector<u64>& cells = (*parent)[tile.first / 2];
+        if (cells.empty())
+            cells.resize(PYRAMID_TILE_CELLS, 0);
+        u64 half = (tile.first % 2) * (PYRAMID_TILE_CELLS / 2);
+        for (u64 c = 0; c < PYRAMID_TILE_CELLS; c++)
+            cells[half + c / 2] += tile.second[c];
+    }
+}
+
+static void PyramidWriteLevel(PyramidWriter* writer, const TileMap& tiles, u64 cellCapacity)
+{
+    PyramidLevel level = { (u64)writer->directory.size(), (u64)tiles.size() };
+    writer->levels.push_back(level);
+
+    u8 fractions[PYRAMID_TILE_CELLS];
+    for (const std::pair<const u64, std::vector<u64> >& tile : tiles) {
+        u64 liveBytes = 0;
+        for (u64 c = 0; c < PYRAMID_TILE_CELLS; c++) {
+            u64 bytes = tile.second[c];
+            liveBytes += bytes;
+            // A cell with one live byte isn't shown free
+            u64 value = (u64)ceil((double)bytes * 255.0 / (double)cellCapacity);
+            fractions[c] = (u8)(value > 255 ? 255 : value);
+        }
+        PyramidTile entry = { tile.first, writer->offset, liveBytes };
+        writer->directory.push_back(entry);
+        fwrite(fractions, 1, PYRAMID_TILE_CELLS, writer->file);
+        writer->offset += PYRAMID_TILE_CELLS;
+        writer->tileBytes += PYRAMID_TILE_CELLS;
+    }
+}
+
+static void PyramidWriteHeap(PyramidWriter* writer, const BlockMap& blocks, const PyramidHeap* heap, u32 levelCount, u64 cellBytes)
+{
+    TileMap tiles;
+    TileMap parent;
+    PyramidLevelZero(blocks, heap, cellBytes, &tiles);
+    for (u32 l = 0; l < levelCount; l++) {
+        if (l < heap->levelCount) {
+            PyramidWriteLevel(writer, tiles, cellBytes << l);
+            PyramidParent(tiles, &parent);
+            tiles.swap(parent);
+        }
+        else {
+            PyramidLevel empty = { (u64)writer->directory.size(), 0 };
+            writer->levels.push_back(empty);
+        }
+    }
+}
+
+//--------------- Main ---------------------
+
+static void PyramidUsage()
+{
+    printf("Usage: HeapPyramid LOG [--keyframes N] [--cell BYTES] [--allocator N] [-o FILE]\n");
+    printf("  LOG            JSON log or binary trace (TraceReplay --save)\n");
+    printf("  --keyframes N  nb of keyframes evenly spaced over the records (default: 8)\n");
+    printf("  --cell BYTES   cell size of the finest level, a power of 2 (default: 16)\n");
+    printf("  --allocator N  only this allocator\n");
+    printf("  -o FILE        output (default: LOG.pyr)\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* logFile = NULL;
+    const char* outFile = NULL;
+    int keyframeCount = 8;
+    u64 cellBytes = 16;
+    int allocator = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--keyframes") == 0 && i + 1 < argc)
+            keyframeCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cell") == 0 && i + 1 < argc)
+            cellBytes = (u64)atoll(argv[++i]);
+        else if (strcmp(argv[i], "--allocator") == 0 && i + 1 < argc)
+            allocator = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outFile = argv[++i];
+        else if (argv[i][0] != '-' && logFile == NULL)
+            logFile = argv[i];
+        else {
+            PyramidUsage();
+            return 1;
+        }
+    }
+    if (logFile == NULL || keyframeCount < 1 || cellBytes == 0 || (cellBytes & (cellBytes - 1)) != 0) {
+        PyramidUsage();
+        return 1;
+    }
+
+    OgeTrace trace;
+    if (!OgeTraceLoad(&trace, logFile)) {
+        printf("Can't load %s\n", logFile);
+        return 1;
+    }
+    if (trace.count == 0) {
+        printf("No mem records in %s\n", logFile);
+        OgeTraceFree(&trace);
+        return 1;
+    }
+
+    // Address range of each heap over the whole trace, so the tiles of all the keyframes match
+    u64 low[PYRAMID_MAX_HEAPS];
+    u64 high[PYRAMID_MAX_HEAPS];
+    for (int h = 0; h < PYRAMID_MAX_HEAPS; h++) {
+        low[h] = ~0ull;
+        high[h] = 0;
+    }
+    for (u64 i = 0; i < trace.count; i++) {
+        const OgeTraceRecord* r = &trace.records[i];
+        if (r->allocator >= PYRAMID_MAX_HEAPS || (allocator >= 0 && r->allocator != allocator))
+            continue;
+        if (r->action == OGE_ACTION_ADD || r->action == OGE_ACTION_COMMIT) {
+            low[r->allocator] = std::min(low[r->allocator], r->address);
+            high[r->allocator] = std::max(high[r->allocator], r->address + r->size);
+        }
+    }
+
+    // The base is aligned on a tile of level 0
+    u64 tileSpan = cellBytes * PYRAMID_TILE_CELLS;
+    std::vector<PyramidHeap> heaps;
+    int heapSlot[PYRAMID_MAX_HEAPS];
+    u32 levelCount = 1;
+    for (int h = 0; h < PYRAMID_MAX_HEAPS; h++) {
+        heapSlot[h] = -1;
+        if (low[h] >= high[h])
+            continue;
+        PyramidHeap heap;
+        memset(&heap, 0, sizeof(heap));
+        heap.heap = (u16)h;
+        heap.base = low[h] / tileSpan * tileSpan;
+        heap.span = high[h] - heap.base;
+        heap.levelCount = 1;
+        while ((tileSpan << (heap.levelCount - 1)) < heap.span && heap.levelCount < 64)
+            heap.levelCount++;
+        levelCount = std::max(levelCount, (u32)heap.levelCount);
+        heapSlot[h] = (int)heaps.size();
+        heaps.push_back(heap);
+    }
+
+    // Evenly spaced over the records: a log can have all its allocations in a few frames
+    std::vector<u64> keyframeRecords;
+    for (int k = 0; k < keyframeCount; k++) {
+        u64 record = trace.count * (u64)(k + 1) / (u64)keyframeCount;
+        if (record > 0 && (keyframeRecords.empty() || record > keyframeRecords.back()))
+            keyframeRecords.push_back(record);
+    }
+
+    char defaultOut[1024];
+    if (outFile == NULL) {
+        snprintf(defaultOut, sizeof(defaultOut), "%s.pyr", logFile);
+        outFile = defaultOut;
+    }
+    PyramidWriter writer;
+    writer.file = fopen(outFile, "wb");
+    writer.offset = sizeof(PyramidHeader);
+    writer.tileBytes = 0;
+    if (writer.file == NULL) {
+        printf("Can't write %s\n", outFile);
+        OgeTraceFree(&trace);
+        return 1;
+    }
+    PyramidHeader header;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, writer.file); // written again at the end
+
+    // One pass over the trace: the heaps are written at the end of each keyframe
+    std::vector<BlockMap> blocks(heaps.size());
+    std::vector<PyramidKeyframe> keyframes;
+    u64 i = 0;
+    for (u64 record : keyframeRecords) {
+        for (; i < record; i++) {
+            const OgeTraceRecord* r = &trace.records[i];
+            if (r->allocator < PYRAMID_MAX_HEAPS && heapSlot[r->allocator] >= 0)
+                PyramidApply(&blocks[heapSlot[r->allocator]], r);
+        }
+        u32 frame = trace.records[i - 1].frame;
+        PyramidKeyframe keyframe = { i, frame, 0 };
+        keyframes.push_back(keyframe);
+
+        u64 tileBytes = writer.tileBytes;
+        for (size_t h = 0; h < heaps.size(); h++)
+            PyramidWriteHeap(&writer, blocks[h], &heaps[h], levelCount, cellBytes);
+        printf("keyframe at frame %u: %llu records, %.1f MB of tiles\n", frame, (unsigned long long)i,
+            (double)(writer.tileBytes - tileBytes) / (1024.0 * 1024.0));
+    }
+
+    header.heapsOffset = writer.offset;
+    fwrite(heaps.data(), sizeof(PyramidHeap), heaps.size(), writer.file);
+    writer.offset += sizeof(PyramidHeap) * heaps.size();
+    header.keyframesOffset = writer.offset;
+    fwrite(keyframes.data(), sizeof(PyramidKeyframe), keyframes.size(), writer.file);
+    writer.offset += sizeof(PyramidKeyframe) * keyframes.size();
+    header.levelsOffset = writer.offset;
+    fwrite(writer.levels.data(), sizeof(PyramidLevel), writer.levels.size(), writer.file);
+    writer.offset += sizeof(PyramidLevel) * writer.levels.size();
+    header.directoryOffset = writer.offset;
+    fwrite(writer.directory.data(), sizeof(PyramidTile), writer.directory.size(), writer.file);
+    writer.offset += sizeof(PyramidTile) * writer.directory.size();
+
+    memcpy(header.magic, PYRAMID_MAGIC, 8);
+    header.version = PYRAMID_VERSION;
+    header.tileCells = PYRAMID_TILE_CELLS;
+    header.cellBytes = (u32)cellBytes;
+    header.levelCount = levelCount;
+    header.heapCount = (u32)heaps.size();
+    header.keyframeCount = (u32)keyframes.size();
+    header.directoryCount = writer.directory.size();
+    fseek(writer.file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, writer.file);
+    bool ok = fclose(writer.file) == 0;
+
+    for (const PyramidHeap& heap : heaps)
+        printf("heap %u: base 0x%llx, span %.1f MB, %u levels\n", heap.heap, (unsigned long long)heap.base,
+            (double)heap.span / (1024.0 * 1024.0), heap.levelCount);
+    printf("%s: %u keyframes, %llu tiles, %.1f MB\n", outFile, header.keyframeCount,
+        (unsigned long long)header.directoryCount, (double)writer.offset / (1024.0 * 1024.0));
+
+    OgeTraceFree(&trace);
+    return ok ? 0 : 1;
+}
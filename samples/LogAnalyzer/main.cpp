@@ -0,0 +1,731 @@
+// Command line analyzer of the JSON heap logs. The log is memory mapped, cut in one chunk
+// per thread on record boundaries and the chunks are parsed in parallel.
+// The partial results are then merged in file order.
+
+// The standard headers go first: Memory.h replaces malloc/calloc/realloc/free by macros
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <limits.h> // LLONG_MIN
+#include <string.h>
+
+#include "oge/Oge.h"
+#include "oge/utilities/Memory.h"
+#include "oge/utilities/LogReader.h"
+
+#define ANALYZER_MAX_HEAPS OGE_MEMORY_MAX_ALLOCATORS
+#define ANALYZER_MAX_THREADS 64
+
+//--------------- Chunk results ---------------------
+
+typedef struct FrameStats FrameStats;
+
+struct FrameStats
+{
+    long long delta[ANALYZER_MAX_HEAPS]; // live bytes change
+    u64 allocCount;
+    u64 allocBytes;
+    u64 freeCount;
+};
+
+typedef struct SiteStats SiteStats;
+
+struct SiteStats
+{
+    u64 count;
+    u64 bytes;
+};
+
+typedef struct HeapStats HeapStats;
+
+struct HeapStats
+{
+    u64 allocCount;
+    u64 allocBytes;
+    u64 freeCount;
+    u64 freeBytes;
+    u64 doubleAdds;     // add of an address already live: the first block leaked or its del is missing
+    u64 unmatchedFrees; // del of an address never added
+};
+
+typedef struct PendingBlock PendingBlock;
+
+// An add without its del (yet)
+struct PendingBlock
+{
+    u64 size;
+    std::string_view site;
+    u16 heap;
+};
+
+typedef struct ChunkEvent ChunkEvent;
+
+// An add or a del of an address that isn't live in the chunk: whether it is a double add or
+// a bad free depends on the previous chunks
+struct ChunkEvent
+{
+    u64 address;
+    u64 record;     // index of the mem record in the chunk
+    u16 heap;
+    u8 action;      // OGE_ACTION_ADD or OGE_ACTION_DEL
+};
+
+typedef struct ChunkResult ChunkResult;
+
+struct ChunkResult
+{
+    size_t begin;
+    size_t end;
+    u64 records;
+    u64 memRecords;
+    u64 skipped;        // heap id too big
+    u32 frameBase;
+    std::vector<FrameStats> frames; // frames[f - frameBase]
+    HeapStats heaps[ANALYZER_MAX_HEAPS];
+    std::unordered_map<std::string_view, SiteStats> sites;
+    std::unordered_map<u64, PendingBlock> pending;
+    std::vector<ChunkEvent> unmatched;  // in file order
+};
+
+inline FrameStats* AnalyzerFrame(ChunkResult* chunk, u32 frame)
+{
+    if (chunk->frames.empty())
+        chunk->frameBase = frame;
+    else if (frame < chunk->frameBase) {
+        // Rare: the frames go back. Rebase the vector.
+        chunk->frames.insert(chunk->frames.begin(), chunk->frameBase - frame, FrameStats());
+        chunk->frameBase = frame;
+    }
+    size_t index = frame - chunk->frameBase;
+    if (index >= chunk->frames.size())
+        chunk->frames.resize(index + 1, FrameStats());
+    return &chunk->frames[index];
+}
+
+static void AnalyzeChunk(const char* data, size_t size, ChunkResult* chunk)
+{
+    OgeLogReader reader;
+    OgeLogRecord record;
+    OgeLogReaderInit(&reader, data, size, chunk->begin, chunk->end);
+
+    while (OgeLogReadRecord(&reader, &record)) {
+        chunk->records++;
+        if (record.type != OGE_RECORD_MEM)
+            continue;
+        chunk->memRecords++;
+        if (record.allocator >= ANALYZER_MAX_HEAPS) {
+            chunk->skipped++;
+            continue;
+        }
+
+        u16 heap = record.allocator;
+        HeapStats* stats = &chunk->heaps[heap];
+        FrameStats* frame = AnalyzerFrame(chunk, record.frame);
+        std::string_view site(record.fields[5].text != NULL ? record.fields[5].text : "", record.fields[5].length);
+
+        switch (record.action) {
+        case OGE_ACTION_ADD: {
+            stats->allocCount++;
+            stats->allocBytes += record.size;
+            frame->delta[heap] += (long long)record.size;
+            frame->allocCount++;
+            frame->allocBytes += record.size;
+
+            SiteStats* siteStats = &chunk->sites[site];
+            siteStats->count++;
+            siteStats->bytes += record.size;
+
+            PendingBlock block = { record.size, site, heap };
+            std::pair<std::unordered_map<u64, PendingBlock>::iterator, bool> inserted = chunk->pending.emplace(record.address, block);
+            if (inserted.second) {
+                ChunkEvent event = { record.address, chunk->memRecords, heap, OGE_ACTION_ADD };
+                chunk->unmatched.push_back(event);
+            }
+            else {
+                chunk->heaps[inserted.first->second.heap].doubleAdds++;
+                inserted.first->second = block;
+            }
+            break;
+        }
+        case OGE_ACTION_DEL:
+        case OGE_ACTION_REM: {
+            stats->freeCount++;
+            stats->freeBytes += record.size;
+            frame->delta[heap] -= (long long)record.size;
+            frame->freeCount++;
+
+            std::unordered_map<u64, PendingBlock>::iterator it = chunk->pending.find(record.address);
+            if (it != chunk->pending.end())
+                chunk->pending.erase(it);
+            else {
+                ChunkEvent event = { record.address, chunk->memRecords, heap, OGE_ACTION_DEL };
+                chunk->unmatched.push_back(event);
+            }
+            break;
+        }
+        case OGE_ACTION_COMMIT:
+            frame->delta[heap] += (long long)record.size;
+            break;
+        case OGE_ACTION_DECOMMIT:
+            frame->delta[heap] -= (long long)record.size;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+//--------------- Merge ---------------------
+
+typedef struct HeapSummary HeapSummary;
+
+struct HeapSummary
+{
+    HeapStats stats;
+    long long peakBytes;
+    u32 peakFrame;
+    long long finalBytes;
+    u64 leakCount;
+    u64 leakBytes;
+};
+
+typedef struct SiteEntry SiteEntry;
+
+struct SiteEntry
+{
+    std::string_view site;
+    SiteStats stats;
+};
+
+typedef struct Analysis Analysis;
+
+struct Analysis
+{
+    u64 records;
+    u64 memRecords;
+    u64 skipped;
+    u32 firstFrame;
+    long long baseBytes[ANALYZER_MAX_HEAPS]; // live bytes before the first record (--frames)
+    std::vector<FrameStats> frames;
+    HeapSummary heaps[ANALYZER_MAX_HEAPS];
+    u16 heapCount;      // highest heap id used + 1
+    std::vector<SiteEntry> sites;   // sorted by bytes
+    std::vector<SiteEntry> leakSites;
+};
+
+// The name breaks the ties so the order doesn't depend on the hash tables
+inline bool SiteByBytes(const SiteEntry& a, const SiteEntry& b)
+{
+    if (a.stats.bytes != b.stats.bytes)
+        return a.stats.bytes > b.stats.bytes;
+    if (a.stats.count != b.stats.count)
+        return a.stats.count > b.stats.count;
+    return a.site < b.site;
+}
+
+static void AnalyzerMerge(std::vector<ChunkResult>& chunks, Analysis* analysis)
+{
+    analysis->records = 0;
+    analysis->memRecords = 0;
+    analysis->skipped = 0;
+    analysis->heapCount = 0;
+    memset(analysis->heaps, 0, sizeof(analysis->heaps));
+
+    // Frame range
+    bool any = false;
+    u32 firstFrame = 0;
+    u32 lastFrame = 0;
+    for (ChunkResult& chunk : chunks) {
+        if (chunk.frames.empty())
+            continue;
+        u32 last = chunk.frameBase + (u32)chunk.frames.size() - 1;
+        firstFrame = any ? std::min(firstFrame, chunk.frameBase) : chunk.frameBase;
+        lastFrame = any ? std::max(lastFrame, last) : last;
+        any = true;
+    }
+    analysis->firstFrame = firstFrame;
+    for (int h = 0; h < ANALYZER_MAX_HEAPS; h++) {
+        analysis->heaps[h].peakBytes = analysis->baseBytes[h];
+        analysis->heaps[h].peakFrame = firstFrame;
+    }
+    analysis->frames.assign(any ? (size_t)(lastFrame - firstFrame) + 1 : 0, FrameStats());
+
+    std::unordered_map<std::string_view, SiteStats> sites;
+    std::unordered_map<u64, PendingBlock> pending;
+    for (ChunkResult& chunk : chunks) {
+        analysis->records += chunk.records;
+        analysis->memRecords += chunk.memRecords;
+        analysis->skipped += chunk.skipped;
+
+        for (size_t f = 0; f < chunk.frames.size(); f++) {
+            FrameStats* dst = &analysis->frames[chunk.frameBase - firstFrame + f];
+            const FrameStats* src = &chunk.frames[f];
+            for (int h = 0; h < ANALYZER_MAX_HEAPS; h++)
+                dst->delta[h] += src->delta[h];
+            dst->allocCount += src->allocCount;
+            dst->allocBytes += src->allocBytes;
+            dst->freeCount += src->freeCount;
+        }
+        for (int h = 0; h < ANALYZER_MAX_HEAPS; h++) {
+            HeapStats* dst = &analysis->heaps[h].stats;
+            const HeapStats* src = &chunk.heaps[h];
+            dst->allocCount += src->allocCount;
+            dst->allocBytes += src->allocBytes;
+            dst->freeCount += src->freeCount;
+            dst->freeBytes += src->freeBytes;
+            dst->doubleAdds += src->doubleAdds;
+        }
+        for (const std::pair<const std::string_view, SiteStats>& site : chunk.sites) {
+            SiteStats* stats = &sites[site.first];
+            stats->count += site.second.count;
+            stats->bytes += site.second.bytes;
+        }
+
+        // Same result as reading the records one after the other. The unmatched events are replayed
+        // in file order against the blocks live before the chunk. Each one ends the previous block
+        // of its address: a del frees it, an add replaces it by a block of the chunk. The blocks
+        // still live at the end of the chunk are then added.
+        for (const ChunkEvent& event : chunk.unmatched) {
+            std::unordered_map<u64, PendingBlock>::iterator it = pending.find(event.address);
+            if (it != pending.end()) {
+                if (event.action == OGE_ACTION_ADD)
+                    analysis->heaps[it->second.heap].stats.doubleAdds++;
+                pending.erase(it);
+            }
+            else if (event.action == OGE_ACTION_DEL)
+                analysis->heaps[event.heap].stats.unmatchedFrees++;
+        }
+        for (const std::pair<const u64, PendingBlock>& block : chunk.pending)
+            pending[block.first] = block.second;
+
+        // The chunk isn't needed anymore
+        std::vector<FrameStats>().swap(chunk.frames);
+        std::unordered_map<std::string_view, SiteStats>().swap(chunk.sites);
+        std::unordered_map<u64, PendingBlock>().swap(chunk.pending);
+        std::vector<ChunkEvent>().swap(chunk.unmatched);
+    }
+
+    // Timelines: running sum of the deltas
+    long long live[ANALYZER_MAX_HEAPS];
+    memcpy(live, analysis->baseBytes, sizeof(live));
+    for (size_t f = 0; f < analysis->frames.size(); f++) {
+        for (int h = 0; h < ANALYZER_MAX_HEAPS; h++) {
+            live[h] += analysis->frames[f].delta[h];
+            if (live[h] > analysis->heaps[h].peakBytes) {
+                analysis->heaps[h].peakBytes = live[h];
+                analysis->heaps[h].peakFrame = firstFrame + (u32)f;
+            }
+        }
+    }
+    for (int h = 0; h < ANALYZER_MAX_HEAPS; h++) {
+        analysis->heaps[h].finalBytes = live[h];
+        const HeapStats* stats = &analysis->heaps[h].stats;
+        if (stats->allocCount > 0 || stats->freeCount > 0 || live[h] != 0 || analysis->heaps[h].peakBytes > 0)
+            analysis->heapCount = (u16)(h + 1);
+    }
+
+    // Leaks: the adds never deleted, by site
+    std::unordered_map<std::string_view, SiteStats> leakSites;
+    for (const std::pair<const u64, PendingBlock>& block : pending) {
+        analysis->heaps[block.second.heap].leakCount++;
+        analysis->heaps[block.second.heap].leakBytes += block.second.size;
+        SiteStats* stats = &leakSites[block.second.site];
+        stats->count++;
+        stats->bytes += block.second.size;
+    }
+
+    analysis->sites.clear();
+    for (const std::pair<const std::string_view, SiteStats>& site : sites)
+        analysis->sites.push_back(SiteEntry{ site.first, site.second });
+    std::sort(analysis->sites.begin(), analysis->sites.end(), SiteByBytes);
+
+    analysis->leakSites.clear();
+    for (const std::pair<const std::string_view, SiteStats>& site : leakSites)
+        analysis->leakSites.push_back(SiteEntry{ site.first, site.second });
+    std::sort(analysis->leakSites.begin(), analysis->leakSites.end(), SiteByBytes);
+}
+
+//--------------- Output ---------------------
+
+typedef struct FrameRates FrameRates;
+
+struct FrameRates
+{
+    double meanCount;
+    double meanBytes;
+    u64 p50Count;
+    u64 p99Count;
+    u64 maxCount;
+    u32 maxFrame;
+    u64 maxBytes;
+};
+
+static FrameRates AnalyzerRates(const Analysis* analysis)
+{
+    FrameRates rates;
+    memset(&rates, 0, sizeof(rates));
+    if (analysis->frames.empty())
+        return rates;
+
+    std::vector<u64> counts;
+    counts.reserve(analysis->frames.size());
+    u64 totalCount = 0;
+    u64 totalBytes = 0;
+    for (size_t f = 0; f < analysis->frames.size(); f++) {
+        const FrameStats* frame = &analysis->frames[f];
+        counts.push_back(frame->allocCount);
+        totalCount += frame->allocCount;
+        totalBytes += frame->allocBytes;
+        if (frame->allocCount > rates.maxCount) {
+            rates.maxCount = frame->allocCount;
+            rates.maxFrame = analysis->firstFrame + (u32)f;
+        }
+        if (frame->allocBytes > rates.maxBytes)
+            rates.maxBytes = frame->allocBytes;
+    }
+    rates.meanCount = (double)totalCount / (double)counts.size();
+    rates.meanBytes = (double)totalBytes / (double)counts.size();
+
+    size_t p50 = (size_t)(0.50 * (double)(counts.size() - 1));
+    std::nth_element(counts.begin(), counts.begin() + p50, counts.end());
+    rates.p50Count = counts[p50];
+    size_t p99 = (size_t)(0.99 * (double)(counts.size() - 1));
+    std::nth_element(counts.begin(), counts.begin() + p99, counts.end());
+    rates.p99Count = counts[p99];
+    return rates;
+}
+
+// Live bytes of each heap downsampled to 'points' values. Each value is the max
+// of its frames so the peaks are kept.
+static void AnalyzerTimeline(const Analysis* analysis, int points, std::vector<u32>* frames, std::vector<long long>* values)
+{
+    size_t frameCount = analysis->frames.size();
+    size_t step = frameCount / (size_t)points + (frameCount % (size_t)points != 0 ? 1 : 0);
+    step = step > 0 ? step : 1;
+
+    frames->clear();
+    values->clear();
+    long long live[ANALYZER_MAX_HEAPS];
+    long long bucketMax[ANALYZER_MAX_HEAPS];
+    memcpy(live, analysis->baseBytes, sizeof(live));
+    for (size_t start = 0; start < frameCount; start += step) {
+        for (int h = 0; h < ANALYZER_MAX_HEAPS; h++)
+            bucketMax[h] = LLONG_MIN;
+        size_t end = std::min(start + step, frameCount);
+        for (size_t f = start; f < end; f++) {
+            for (int h = 0; h < ANALYZER_MAX_HEAPS; h++) {
+                live[h] += analysis->frames[f].delta[h];
+                bucketMax[h] = std::max(bucketMax[h], live[h]);
+            }
+        }
+        frames->push_back(analysis->firstFrame + (u32)start);
+        for (int h = 0; h < analysis->heapCount; h++)
+            values->push_back(bucketMax[h]);
+    }
+}
+
+// The sites are "file:line" written by the logger: only the quotes and backslashes need escaping
+static void AnalyzerJsonString(FILE* file, std::string_view text)
+{
+    fputc('"', file);
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            fputc('\\', file);
+        if ((unsigned char)c >= 0x20)
+            fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+static void AnalyzerWriteJson(FILE* file, const char* logFile, size_t fileSize, double seconds, const Analysis* analysis, int top, int points)
+{
+    FrameRates rates = AnalyzerRates(analysis);
+
+    fprintf(file, "{\"file\":");
+    AnalyzerJsonString(file, logFile);
+    fprintf(file, ",\"bytes\":%llu,\"seconds\":%.3f,\"records\":%llu,\"mem_records\":%llu,\"skipped\":%llu,\"first_frame\":%u,\"frames\":%llu,",
+        (unsigned long long)fileSize, seconds, (unsigned long long)analysis->records, (unsigned long long)analysis->memRecords,
+        (unsigned long long)analysis->skipped, analysis->firstFrame, (unsigned long long)analysis->frames.size());
+
+    fprintf(file, "\"heaps\":[");
+    for (int h = 0; h < analysis->heapCount; h++) {
+        const HeapSummary* heap = &analysis->heaps[h];
+        fprintf(file, "%s{\"heap\":%d,\"allocs\":%llu,\"alloc_bytes\":%llu,\"frees\":%llu,\"free_bytes\":%llu,\"peak_bytes\":%lld,\"peak_frame\":%u,"
+            "\"final_bytes\":%lld,\"leaks\":%llu,\"leak_bytes\":%llu,\"unmatched_frees\":%llu,\"double_adds\":%llu}",
+            h > 0 ? "," : "", h, (unsigned long long)heap->stats.allocCount, (unsigned long long)heap->stats.allocBytes,
+            (unsigned long long)heap->stats.freeCount, (unsigned long long)heap->stats.freeBytes,
+            heap->peakBytes, heap->peakFrame, heap->finalBytes, (unsigned long long)heap->leakCount,
+            (unsigned long long)heap->leakBytes, (unsigned long long)heap->stats.unmatchedFrees,
+            (unsigned long long)heap->stats.doubleAdds);
+    }
+
+    fprintf(file, "],\"rates\":{\"mean_allocs\":%.2f,\"mean_bytes\":%.0f,\"p50_allocs\":%llu,\"p99_allocs\":%llu,\"max_allocs\":%llu,\"max_frame\":%u,\"max_bytes\":%llu},",
+        rates.meanCount, rates.meanBytes, (unsigned long long)rates.p50Count, (unsigned long long)rates.p99Count,
+        (unsigned long long)rates.maxCount, rates.maxFrame, (unsigned long long)rates.maxBytes);
+
+    fprintf(file, "\"sites\":[");
+    for (int i = 0; i < top && i < (int)analysis->sites.size(); i++) {
+        fprintf(file, "%s{\"site\":", i > 0 ? "," : "");
+        AnalyzerJsonString(file, analysis->sites[i].site);
+        fprintf(file, ",\"count\":%llu,\"bytes\":%llu}", (unsigned long long)analysis->sites[i].stats.count, (unsigned long long)analysis->sites[i].stats.bytes);
+    }
+    fprintf(file, "],\"leak_sites\":[");
+    for (int i = 0; i < top && i < (int)analysis->leakSites.size(); i++) {
+        fprintf(file, "%s{\"site\":", i > 0 ? "," : "");
+        AnalyzerJsonString(file, analysis->leakSites[i].site);
+        fprintf(file, ",\"count\":%llu,\"bytes\":%llu}", (unsigned long long)analysis->leakSites[i].stats.count, (unsigned long long)analysis->leakSites[i].stats.bytes);
+    }
+
+    // "live"[point][heap]
+    std::vector<u32> frames;
+    std::vector<long long> values;
+    AnalyzerTimeline(analysis, points, &frames, &values);
+    fprintf(file, "],\"timeline\":{\"frames\":[");
+    for (size_t i = 0; i < frames.size(); i++)
+        fprintf(file, "%s%u", i > 0 ? "," : "", frames[i]);
+    fprintf(file, "],\"live\":[");
+    for (size_t i = 0; i < frames.size(); i++) {
+        fprintf(file, "%s[", i > 0 ? "," : "");
+        for (int h = 0; h < analysis->heapCount; h++)
+            fprintf(file, "%s%lld", h > 0 ? "," : "", values[i * analysis->heapCount + h]);
+        fprintf(file, "]");
+    }
+    fprintf(file, "]}}\n");
+}
+
+static void AnalyzerWriteText(const char* logFile, size_t fileSize, double seconds, const Analysis* analysis, int top, int points)
+{
+    FrameRates rates = AnalyzerRates(analysis);
+
+    printf("%s: %.1f MB, %llu records (%llu mem) in %.3f s, %.0f MB/s\n", logFile, (double)fileSize / (1024.0 * 1024.0),
+        (unsigned long long)analysis->records, (unsigned long long)analysis->memRecords, seconds,
+        seconds > 0 ? (double)fileSize / (1024.0 * 1024.0) / seconds : 0);
+    printf("frames %u to %u\n", analysis->firstFrame, analysis->firstFrame + (u32)(analysis->frames.empty() ? 0 : analysis->frames.size() - 1));
+    if (analysis->skipped > 0)
+        printf("%llu records skipped: heap id >= %d\n", (unsigned long long)analysis->skipped, ANALYZER_MAX_HEAPS);
+
+    printf("\n%4s %12s %16s %12s %16s %10s %16s %16s %10s %16s %10s %10s\n", "heap", "allocs", "alloc bytes", "frees", "free bytes",
+        "peak frame", "peak bytes", "final bytes", "leaks", "leak bytes", "bad frees", "dbl adds");
+    for (int h = 0; h < analysis->heapCount; h++) {
+        const HeapSummary* heap = &analysis->heaps[h];
+        printf("%4d %12llu %16llu %12llu %16llu %10u %16lld %16lld %10llu %16llu %10llu %10llu\n",
+            h, (unsigned long long)heap->stats.allocCount, (unsigned long long)heap->stats.allocBytes,
+            (unsigned long long)heap->stats.freeCount, (unsigned long long)heap->stats.freeBytes,
+            heap->peakFrame, heap->peakBytes, heap->finalBytes, (unsigned long long)heap->leakCount,
+            (unsigned long long)heap->leakBytes, (unsigned long long)heap->stats.unmatchedFrees,
+            (unsigned long long)heap->stats.doubleAdds);
+    }
+
+    printf("\nallocations per frame: mean %.1f (%.0f bytes), p50 %llu, p99 %llu, max %llu at frame %u\n",
+        rates.meanCount, rates.meanBytes, (unsigned long long)rates.p50Count, (unsigned long long)rates.p99Count,
+        (unsigned long long)rates.maxCount, rates.maxFrame);
+
+    printf("\n%16s %12s  %s\n", "bytes", "count", "top call sites");
+    for (int i = 0; i < top && i < (int)analysis->sites.size(); i++)
+        printf("%16llu %12llu  %.*s\n", (unsigned long long)analysis->sites[i].stats.bytes, (unsigned long long)analysis->sites[i].stats.count,
+            (int)analysis->sites[i].site.size(), analysis->sites[i].site.data());
+
+    if (!analysis->leakSites.empty()) {
+        printf("\n%16s %12s  %s\n", "bytes", "count", "leaks (add without del)");
+        for (int i = 0; i < top && i < (int)analysis->leakSites.size(); i++)
+            printf("%16llu %12llu  %.*s\n", (unsigned long long)analysis->leakSites[i].stats.bytes, (unsigned long long)analysis->leakSites[i].stats.count,
+                (int)analysis->leakSites[i].site.size(), analysis->leakSites[i].site.data());
+    }
+
+    std::vector<u32> frames;
+    std::vector<long long> values;
+    AnalyzerTimeline(analysis, points, &frames, &values);
+    printf("\nlive bytes (max over the frames of each line)\n%10s", "frame");
+    for (int h = 0; h < analysis->heapCount; h++)
+        printf("        heap %2d", h);
+    printf("\n");
+    for (size_t i = 0; i < frames.size(); i++) {
+        printf("%10u", frames[i]);
+        for (int h = 0; h < analysis->heapCount; h++)
+            printf(" %14lld", values[i * analysis->heapCount + h]);
+        printf("\n");
+    }
+}
+
+//--------------- Main ---------------------
+
+// Parses [begin, end[ with one chunk per thread and merges the chunks in 'analysis'
+static void AnalyzerRun(const char* data, size_t size, size_t begin, size_t end, int threadCount, Analysis* analysis)
+{
+    // Small files aren't worth a thread per core
+    size_t range = end > begin ? end - begin : 0;
+    if ((size_t)threadCount > range / (1024 * 1024) + 1)
+        threadCount = (int)(range / (1024 * 1024) + 1);
+
+    // The chunk limits can be anywhere: the reader starts at the next record
+    std::vector<ChunkResult> chunks(threadCount);
+    for (int t = 0; t < threadCount; t++) {
+        chunks[t].begin = begin + range / threadCount * t;
+        chunks[t].end = t + 1 < threadCount ? begin + range / threadCount * (t + 1) : end;
+        chunks[t].records = 0;
+        chunks[t].memRecords = 0;
+        chunks[t].skipped = 0;
+        chunks[t].frameBase = 0;
+        memset(chunks[t].heaps, 0, sizeof(chunks[t].heaps));
+    }
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threadCount; t++)
+        workers.emplace_back(AnalyzeChunk, data, size, &chunks[t]);
+    AnalyzeChunk(data, size, &chunks[0]);
+    for (std::thread& worker : workers)
+        worker.join();
+
+    AnalyzerMerge(chunks, analysis);
+}
+
+inline bool AnalyzerSameSites(const std::vector<SiteEntry>& a, const std::vector<SiteEntry>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].site != b[i].site || a[i].stats.count != b[i].stats.count || a[i].stats.bytes != b[i].stats.bytes)
+            return false;
+    }
+    return true;
+}
+
+// --check: the results must not depend on the nb of threads
+static bool AnalyzerSame(const Analysis* a, const Analysis* b)
+{
+    if (a->records != b->records || a->memRecords != b->memRecords || a->skipped != b->skipped
+        || a->firstFrame != b->firstFrame || a->frames.size() != b->frames.size() || a->heapCount != b->heapCount)
+        return false;
+    if (memcmp(a->heaps, b->heaps, sizeof(a->heaps)) != 0)
+        return false;
+    for (size_t f = 0; f < a->frames.size(); f++) {
+        if (memcmp(&a->frames[f], &b->frames[f], sizeof(FrameStats)) != 0)
+            return false;
+    }
+    return AnalyzerSameSites(a->sites, b->sites) && AnalyzerSameSites(a->leakSites, b->leakSites);
+}
+
+static void AnalyzerUsage()
+{
+    printf("Usage: LogAnalyzer LOG [--frames FIRST[:LAST]] [--threads N] [--top N] [--points N] [--json FILE] [--check]\n");
+    printf("  LOG          JSON log written by a OGE_LOGTYPE_JSON logger\n");
+    printf("  --frames FIRST[:LAST]  only these frames, found with the index of the log (LOG.idx)\n");
+    printf("  --threads N  nb of parsing threads (default: nb of cores)\n");
+    printf("  --top N      nb of call sites listed (default: 20)\n");
+    printf("  --points N   nb of points of the live bytes timelines (default: 20 in text, 200 in JSON)\n");
+    printf("  --json FILE  compact JSON instead of text, '-' for stdout\n");
+    printf("  --check      also analyze with 1 thread and fail if the results differ\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* logFile = NULL;
+    const char* jsonFile = NULL;
+    int threadCount = (int)std::thread::hardware_concurrency();
+    int top = 20;
+    int points = 0;
+    const char* frameRange = NULL;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+            top = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc)
+            points = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameRange = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonFile = argv[++i];
+        else if (strcmp(argv[i], "--check") == 0)
+            check = true;
+        else if (argv[i][0] != '-' && logFile == NULL)
+            logFile = argv[i];
+        else {
+            AnalyzerUsage();
+            return 1;
+        }
+    }
+    if (logFile == NULL) {
+        AnalyzerUsage();
+        return 1;
+    }
+    threadCount = threadCount < 1 ? 1 : (threadCount > ANALYZER_MAX_THREADS ? ANALYZER_MAX_THREADS : threadCount);
+    if (points <= 0)
+        points = jsonFile != NULL ? 200 : 20;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    size_t size;
+    const char* data = OgeLogMapFile(logFile, &size);
+    if (data == NULL) {
+        printf("Can't open %s\n", logFile);
+        return 1;
+    }
+
+    Analysis analysis;
+    memset(analysis.baseBytes, 0, sizeof(analysis.baseBytes));
+
+    // Only the bytes of the frames: the index gives their offsets and the live bytes before them
+    size_t begin = 0;
+    size_t end = size;
+    if (frameRange != NULL) {
+        unsigned int firstFrame = 0;
+        unsigned int lastFrame = 0xFFFFFFFE;
+        OgeLogIndex index;
+        if (sscanf(frameRange, "%u:%u", &firstFrame, &lastFrame) < 1 || firstFrame > lastFrame) {
+            AnalyzerUsage();
+            OgeLogUnmapFile(data, size);
+            return 1;
+        }
+        if (!OgeLogIndexLoad(&index, logFile)) {
+            printf("Can't read the index %s.idx\n", logFile);
+            OgeLogUnmapFile(data, size);
+            return 1;
+        }
+        const OgeLogIndexEntry* first = OgeLogIndexFindFrame(&index, firstFrame);
+        const OgeLogIndexEntry* next = OgeLogIndexFindFrame(&index, lastFrame + 1);
+        begin = first != NULL ? (size_t)first->offset : size;
+        end = next != NULL ? (size_t)next->offset : size;
+        if (first != NULL)
+            for (int h = 0; h < ANALYZER_MAX_HEAPS && h < OGE_LOG_INDEX_ALLOCATORS; h++)
+                analysis.baseBytes[h] = first->liveBytes[h];
+        OgeLogIndexFree(&index);
+    }
+
+    AnalyzerRun(data, size, begin, end, threadCount, &analysis);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (check) {
+        Analysis single;
+        memcpy(single.baseBytes, analysis.baseBytes, sizeof(single.baseBytes));
+        AnalyzerRun(data, size, begin, end, 1, &single);
+        if (!AnalyzerSame(&analysis, &single)) {
+            fprintf(stderr, "Check failed: %d threads and 1 thread give different results\n", threadCount);
+            OgeLogUnmapFile(data, size);
+            return 2;
+        }
+        fprintf(stderr, "Check: %d threads and 1 thread give the same results\n", threadCount);
+    }
+
+    // The site names point into the mapped file: write before unmapping
+    if (jsonFile != NULL) {
+        FILE* file = strcmp(jsonFile, "-") == 0 ? stdout : fopen(jsonFile, "w");
+        if (file == NULL) {
+            printf("Can't write %s\n", jsonFile);
+            OgeLogUnmapFile(data, size);
+            return 1;
+        }
+        AnalyzerWriteJson(file, logFile, size, seconds, &analysis, top, points);
+        if (file != stdout)
+            fclose(file);
+    }
+    else
+        AnalyzerWriteText(logFile, size, seconds, &analysis, top, points);
+
+    OgeLogUnmapFile(data, size);
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Follows a log while the game writes it, like "tail -f": the records appended since the last
+// read are parsed with a fixed buffer (OgeLogTail), so a log of any size is followed with
+// constant memory. The live bytes by allocator are kept from the mem records and a status line
+// is printed every second. Written for the OGE_LOGTYPE_NDJSON logger, flushed while the game runs.
+
+// The standard headers go first: Memory.h replaces malloc/calloc/realloc/free by macros
+#include <chrono>
+#include <thread>
+#include <string.h>
+
+#include "oge/Oge.h"
+#include "oge/utilities/Memory.h"
+#include "oge/utilities/LogReader.h"
+
+#define TAIL_MAX_HEAPS OGE_MEMORY_MAX_ALLOCATORS
+#define TAIL_MAX_TYPES 16
+
+typedef struct TailState TailState;
+
+struct TailState
+{
+    u32 frame;
+    u64 records;
+    u64 memRecords;
+    u64 allocCount;
+    long long liveBytes[TAIL_MAX_HEAPS];
+    int heapCount;
+};
+
+static void TailReset(TailState* state)
+{
+    memset(state, 0, sizeof(TailState));
+}
+
+static bool FieldIs(const OgeLogField* field, const char* text)
+{
+    size_t length = strlen(text);
+    return field->length == length && memcmp(field->text, text, length) == 0;
+}
+
+static void TailPrintRecord(const OgeLogRecord* record)
+{
+    if (record->type == OGE_RECORD_LOG) {
+        // p2 level, p3 file:line, p4 text
+        printf("[%u] %.*s %.*s: %.*s\n", record->frame, (int)record->fields[1].length, record->fields[1].text,
+            (int)record->fields[2].length, record->fields[2].text, (int)record->fields[3].length, record->fields[3].text);
+        return;
+    }
+    printf("[%u] %.*s", record->frame, (int)record->typeName.length, record->typeName.text);
+    for (int i = 1; i < OGE_LOG_RECORD_FIELDS; i++)
+        if (record->fields[i].text != NULL)
+            printf(" %.*s", (int)record->fields[i].length, record->fields[i].text);
+    printf("\n");
+}
+
+static void TailPrintStatus(const TailState* state, const TailState* previous, double seconds)
+{
+    long long live = 0;
+    for (int h = 0; h < state->heapCount; h++)
+        live += state->liveBytes[h];
+    double recordRate = seconds > 0.0 ? (double)(state->records - previous->records) / seconds : 0.0;
+    double allocRate = seconds > 0.0 ? (double)(state->allocCount - previous->allocCount) / seconds : 0.0;
+    printf("-- frame %u  records %llu (%.0f/s)  allocations %.0f/s  live %lld bytes",
+        state->frame, (unsigned long long)state->records, recordRate, allocRate, live);
+    for (int h = 0; h < state->heapCount; h++)
+        if (state->liveBytes[h] != 0)
+            printf("  heap %d: %lld", h, state->liveBytes[h]);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void TailUsage()
+{
+    printf("Usage: LogTail LOG [--from-end] [--once] [--interval MS] [--status S] [--print TYPE,...]\n");
+    printf("  LOG             log written by a OGE_LOGTYPE_NDJSON logger (a JSON log is read too)\n");
+    printf("  --from-end      skip the records already in the log\n");
+    printf("  --once          stop at the end of the log instead of waiting for new records\n");
+    printf("  --interval MS   wait between two reads at the end of the log (default: 100)\n");
+    printf("  --status S      seconds between two status lines, 0 = none (default: 1)\n");
+    printf("  --print TYPES   record types printed, 'all' for all (default: log,stop,start,end)\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* logFile = NULL;
+    const char* printList = "log,stop,start,end";
+    bool fromEnd = false;
+    bool once = false;
+    int interval = 100;
+    double statusSeconds = 1.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--from-end") == 0)
+            fromEnd = true;
+        else if (strcmp(argv[i], "--once") == 0)
+            once = true;
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+            interval = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--status") == 0 && i + 1 < argc)
+            statusSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--print") == 0 && i + 1 < argc)
+            printList = argv[++i];
+        else if (argv[i][0] != '-' && logFile == NULL)
+            logFile = argv[i];
+        else {
+            TailUsage();
+            return 1;
+        }
+    }
+    if (logFile == NULL) {
+        TailUsage();
+        return 1;
+    }
+    if (interval < 1)
+        interval = 1;
+
+    // "log,stop" -> { "log", "stop" }
+    char printBuffer[256];
+    const char* printTypes[TAIL_MAX_TYPES];
+    int printCount = 0;
+    bool printAll = strcmp(printList, "all") == 0;
+    snprintf(printBuffer, sizeof(printBuffer), "%s", printList);
+    for (char* type = strtok(printBuffer, ","); type != NULL && printCount < TAIL_MAX_TYPES; type = strtok(NULL, ","))
+        printTypes[printCount++] = type;
+
+    OgeLogTail tail;
+    if (!OgeLogTailOpen(&tail, logFile, fromEnd)) {
+        printf("Can't open %s\n", logFile);
+        return 1;
+    }
+
+    TailState state;
+    TailState previous;
+    TailReset(&state);
+    previous = state;
+    u32 restartCount = 0;
+    std::chrono::steady_clock::time_point statusTime = std::chrono::steady_clock::now();
+
+    for (;;) {
+        OgeLogRecord record;
+        while (OgeLogTailNext(&tail, &record)) {
+            // The logger opened the file again: a new run
+            if (tail.restartCount != restartCount) {
+                restartCount = tail.restartCount;
+                printf("-- %s was truncated: reading it again\n", logFile);
+                TailReset(&state);
+                previous = state;
+            }
+
+            state.records++;
+            if (record.frame > state.frame)
+                state.frame = record.frame;
+            if (record.type == OGE_RECORD_MEM) {
+                state.memRecords++;
+                int heap = record.allocator;
+                if (heap < TAIL_MAX_HEAPS) {
+                    if (heap + 1 > state.heapCount)
+                        state.heapCount = heap + 1;
+                    switch (record.action) {
+                    case OGE_ACTION_ADD:
+                        state.allocCount++;
+                        state.liveBytes[heap] += (long long)record.size;
+                        break;
+                    case OGE_ACTION_COMMIT:
+                        state.liveBytes[heap] += (long long)record.size;
+                        break;
+                    case OGE_ACTION_DEL:
+                    case OGE_ACTION_REM:
+                    case OGE_ACTION_DECOMMIT:
+                        state.liveBytes[heap] -= (long long)record.size;
+                        break;
+                    default:
+                        break;
+                    }
+                }
+            }
+            else if (FieldIs(&record.typeName, "start")) {
+                // A new run appended to the log
+                u64 records = state.records;
+                TailReset(&state);
+                state.records = records;
+                previous.allocCount = 0;
+            }
+
+            bool print = printAll;
+            for (int t = 0; t < printCount && !print; t++)
+                print = FieldIs(&record.typeName, printTypes[t]);
+            if (print)
+                TailPrintRecord(&record);
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - statusTime).count();
+        if (once) {
+            TailPrintStatus(&state, &previous, seconds);
+            break;
+        }
+        if (statusSeconds > 0.0 && seconds >= statusSeconds && state.records != previous.records) {
+            TailPrintStatus(&state, &previous, seconds);
+            previous = state;
+            statusTime = now;
+        }
+        fflush(stdout);
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+    }
+
+    if (tail.skippedLines > 0)
+        printf("%llu lines longer than %d bytes skipped\n", (unsigned long long)tail.skippedLines, OGE_LOG_TAIL_BUFFER);
+    OgeLogTailClose(&tail);
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Live monitor of a running game: reads the shared memory block published by OgeTelemetryOpen()
+// at each OgeLogUpdate(). The game isn't paused and writes no file; the monitor only maps the
+// block read only and copies it under the sequence lock.
+
+// The standard headers go first: Memory.h replaces malloc/calloc/realloc/free by macros
+#include <chrono>
+#include <thread>
+#include <string.h>
+
+#include "oge/Oge.h"
+#include "oge/utilities/Memory.h"
+#include "oge/utilities/Logger.h"
+
+static const char* _levelNames[OGE_TELEMETRY_LEVELS] = { "summary", "error", "release", "normal", "debug", "info", "verbose", "alloc" };
+
+static void MonitorPrint(const OgeTelemetryBlock* block, const OgeTelemetryStats* stats, const OgeTelemetryStats* previous, double seconds)
+{
+    double fps = 0.0;
+    if (previous != NULL && seconds > 0.0)
+        fps = (double)(stats->publishCount - previous->publishCount) / seconds;
+
+    printf("pid %u  frame %llu  %.2f ms  %.1f frames/s  records %llu  dropped %llu\n",
+        block->processId, (unsigned long long)stats->frame, stats->deltaTime, fps,
+        (unsigned long long)stats->logRecords, (unsigned long long)stats->droppedRecords);
+    printf("records:");
+    for (int l = 0; l < OGE_TELEMETRY_LEVELS; l++)
+        printf(" %s %llu", _levelNames[l], (unsigned long long)stats->levelRecords[l]);
+    printf("\n");
+
+    printf("%4s %-16s %16s %10s %16s %10s %12s %16s\n", "id", "name", "live bytes", "live nb", "peak bytes", "frame nb", "total nb", "budget");
+    for (u32 i = 0; i < stats->allocatorCount && i < OGE_TELEMETRY_ALLOCATORS; i++) {
+        const OgeTelemetryAllocator* a = &stats->allocators[i];
+        if (a->totalCount == 0 && a->name[0] == '\0')
+            continue;
+        printf("%4u %-16.16s %16llu %10llu %16llu %10llu %12llu %16llu%s\n", i, a->name,
+            (unsigned long long)a->liveBytes, (unsigned long long)a->liveCount, (unsigned long long)a->peakBytes,
+            (unsigned long long)a->frameCount, (unsigned long long)a->totalCount, (unsigned long long)a->budget,
+            a->budget != 0 && a->liveBytes > a->budget ? "  OVER BUDGET" : "");
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void MonitorUsage()
+{
+    printf("Usage: TelemetryMonitor [NAME] [--interval MS] [--count N]\n");
+    printf("  NAME           shared memory block given to OgeTelemetryOpen() (default: %s)\n", OGE_TELEMETRY_NAME);
+    printf("  --interval MS  time between two reads (default: 1000)\n");
+    printf("  --count N      stop after N reads (default: never)\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* name = OGE_TELEMETRY_NAME;
+    int interval = 1000;
+    long count = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+            interval = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            count = atol(argv[++i]);
+        else if (argv[i][0] != '-')
+            name = argv[i];
+        else {
+            MonitorUsage();
+            return 1;
+        }
+    }
+    if (interval < 1)
+        interval = 1;
+
+    const OgeTelemetryBlock* block = OgeTelemetryAttach(name);
+    if (block == NULL) {
+        printf("No telemetry block %s: is the game running with OgeTelemetryOpen()?\n", name);
+        return 1;
+    }
+
+    OgeTelemetryStats stats;
+    OgeTelemetryStats previous;
+    bool hasPrevious = false;
+    int staleReads = 0;
+    std::chrono::steady_clock::time_point previousTime = std::chrono::steady_clock::now();
+    for (long n = 0; count < 0 || n < count; n++) {
+        if (n > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!OgeTelemetryRead(block, &stats)) {
+            printf("The block is always being written: skipped\n");
+            continue;
+        }
+        double seconds = std::chrono::duration<double>(now - previousTime).count();
+        MonitorPrint(block, &stats, hasPrevious ? &previous : NULL, seconds);
+
+        // The game closed the block, crashed or is paused: the last stats stay readable
+        staleReads = hasPrevious && stats.publishCount == previous.publishCount ? staleReads + 1 : 0;
+        if (staleReads > 0)
+            printf("No new frame for %d reads\n\n", staleReads);
+        previous = stats;
+        previousTime = now;
+        hasPrevious = true;
+    }
+
+    OgeTelemetryDetach(block);
+    return 0;
+}
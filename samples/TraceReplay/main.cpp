@@ -0,0 +1,599 @@
+// Replays the allocations of a heap log (JSON) or of a binary trace against several back ends.
+// The same trace gives the same sequence of operations so the back ends can be compared.
+
+// The standard headers go first: Memory.h replaces malloc/calloc/realloc/free by macros
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <string.h>
+
+#include "oge/Oge.h"
+#include "oge/utilities/Memory.h"
+#include "oge/utilities/LogReader.h"
+
+#if defined(_MSC_VER)
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#   include <psapi.h> // GetProcessMemoryInfo
+#   pragma comment(lib, "psapi.lib")
+#endif
+
+#define REPLAY_PAGE_SIZE 4096
+#define REPLAY_RSS_SAMPLES 1000 // max nb of RSS reads per replay
+#define REPLAY_POOL_CHUNK (64 * 1024)
+#define REPLAY_POOL_MAX (64 * 1024) // bigger blocks go to libc
+#define REPLAY_POOL_CLASSES (64 + 6) // 16 bytes steps up to 1KB then powers of 2 up to 64KB
+
+#if UINTPTR_MAX > 0xFFFFFFFFu
+#   define REPLAY_ARENA_RESERVE (64ull << 30)
+#else
+#   define REPLAY_ARENA_RESERVE (1ull << 30)
+#endif
+
+//--------------- Operations ---------------------
+
+enum ReplayKind
+{
+    REPLAY_ALLOC = 0,
+    REPLAY_FREE,
+};
+
+typedef enum ReplayKind ReplayKind;
+
+typedef struct ReplayOp ReplayOp;
+
+// The trace addresses are replaced by slots (indices in the array of live pointers)
+struct ReplayOp
+{
+    u64 size;
+    u32 slot;
+    u32 frame;
+    u8  kind;
+};
+
+typedef struct ReplayTrace ReplayTrace;
+
+struct ReplayTrace
+{
+    std::vector<ReplayOp> ops;
+    u32 slotCount;
+    u32 frameCount;
+    u64 ignored;        // commit/decommit and unknown actions
+    u64 unknownFrees;   // del of an address never added
+    u64 doubleAdds;     // add of a live address, the old block is freed first
+    u64 leaked;         // still live at the end, freed after the timing
+};
+
+// Convert the trace to operations on slots. The slots are reused so there are
+// as many as the max nb of live blocks.
+static void ReplayPrepare(const OgeTrace* trace, int allocator, ReplayTrace* out)
+{
+    std::unordered_map<u64, u32> live;
+    std::vector<u32> freeSlots;
+    std::vector<u64> slotSizes;
+
+    out->ops.clear();
+    out->ops.reserve((size_t)trace->count);
+    out->slotCount = 0;
+    out->frameCount = 0;
+    out->ignored = 0;
+    out->unknownFrees = 0;
+    out->doubleAdds = 0;
+    out->leaked = 0;
+
+    u32 lastFrame = 0;
+    for (u64 i = 0; i < trace->count; i++) {
+        const OgeTraceRecord* r = &trace->records[i];
+        if (allocator >= 0 && r->allocator != allocator)
+            continue;
+
+        if (out->ops.empty() || r->frame != lastFrame) {
+            out->frameCount++;
+            lastFrame = r->frame;
+        }
+
+        ReplayOp op;
+        op.frame = r->frame;
+        if (r->action == OGE_ACTION_ADD) {
+            std::unordered_map<u64, u32>::iterator it = live.find(r->address);
+            if (it != live.end()) {
+                // The del was lost (i.e. log truncated): free the old block
+                op.kind = REPLAY_FREE;
+                op.slot = it->second;
+                op.size = slotSizes[it->second];
+                out->ops.push_back(op);
+                freeSlots.push_back(it->second);
+                live.erase(it);
+                out->doubleAdds++;
+            }
+
+            u32 slot;
+            if (!freeSlots.empty()) {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else {
+                slot = out->slotCount++;
+                slotSizes.push_back(0);
+            }
+            slotSizes[slot] = r->size;
+            live[r->address] = slot;
+
+            op.kind = REPLAY_ALLOC;
+            op.slot = slot;
+            op.size = r->size;
+            out->ops.push_back(op);
+        }
+        else if (r->action == OGE_ACTION_DEL || r->action == OGE_ACTION_REM) {
+            std::unordered_map<u64, u32>::iterator it = live.find(r->address);
+            if (it == live.end()) {
+                out->unknownFrees++;
+                continue;
+            }
+            op.kind = REPLAY_FREE;
+            op.slot = it->second;
+            op.size = slotSizes[it->second];
+            out->ops.push_back(op);
+            freeSlots.push_back(it->second);
+            live.erase(it);
+        }
+        else
+            out->ignored++;
+    }
+    out->leaked = live.size();
+}
+
+//--------------- Back ends ---------------------
+
+typedef struct ReplayBackend ReplayBackend;
+
+struct ReplayBackend
+{
+    const char* name;
+    void  (*init)(void);
+    void* (*allocFn)(size_t size);
+    void  (*freeFn)(void* obj, size_t size);
+    size_t (*footprint)(void);  // bytes taken from the system, NULL: use the RSS
+    void  (*shutdown)(void);
+};
+
+// The parentheses stop the expansion of the Memory.h macros: this is the C runtime
+static void* LibcAlloc(size_t size) { return (malloc)(size); }
+static void  LibcFree(void* obj, size_t size) { (void)size; (free)(obj); }
+
+static void* OgeAlloc(size_t size) { return malloc(size); }
+static void  OgeRelease(void* obj, size_t size) { (void)size; free(obj); }
+
+// Size class pool: one free list per class, blocks carved from 64KB chunks
+// that are only given back at the end.
+typedef struct ReplayPool ReplayPool;
+
+struct ReplayPool
+{
+    void* freeLists[REPLAY_POOL_CLASSES];
+    std::vector<void*> chunks;
+    char* current;
+    size_t currentLeft;
+    size_t chunkBytes;
+    size_t largeBytes;
+};
+
+static ReplayPool _pool;
+
+inline int PoolClass(size_t size, size_t* classSize)
+{
+    if (size <= 1024) {
+        size_t rounded = size < 16 ? 16 : (size + 15) & ~(size_t)15;
+        *classSize = rounded;
+        return (int)(rounded / 16) - 1;
+    }
+    int index = 64;
+    size_t bytes = 2048;
+    while (bytes < size) {
+        bytes *= 2;
+        index++;
+    }
+    *classSize = bytes;
+    return index;
+}
+
+static void PoolInit()
+{
+    memset(_pool.freeLists, 0, sizeof(_pool.freeLists));
+    _pool.chunks.clear();
+    _pool.current = NULL;
+    _pool.currentLeft = 0;
+    _pool.chunkBytes = 0;
+    _pool.largeBytes = 0;
+}
+
+static void* PoolAlloc(size_t size)
+{
+    if (size > REPLAY_POOL_MAX) {
+        _pool.largeBytes += size;
+        return (malloc)(size);
+    }
+
+    size_t classSize;
+    int index = PoolClass(size, &classSize);
+    void* obj = _pool.freeLists[index];
+    if (obj != NULL) {
+        _pool.freeLists[index] = *(void**)obj;
+        return obj;
+    }
+
+    if (_pool.currentLeft < classSize) {
+        // The tail of the previous chunk is lost, it counts as fragmentation
+        _pool.current = (char*)(malloc)(REPLAY_POOL_CHUNK);
+        if (_pool.current == NULL)
+            return NULL;
+        _pool.chunks.push_back(_pool.current);
+        _pool.currentLeft = REPLAY_POOL_CHUNK;
+        _pool.chunkBytes += REPLAY_POOL_CHUNK;
+    }
+    obj = _pool.current;
+    _pool.current += classSize;
+    _pool.currentLeft -= classSize;
+    return obj;
+}
+
+static void PoolFree(void* obj, size_t size)
+{
+    if (obj == NULL)
+        return;
+    if (size > REPLAY_POOL_MAX) {
+        _pool.largeBytes -= size;
+        (free)(obj);
+        return;
+    }
+    size_t classSize;
+    int index = PoolClass(size, &classSize);
+    *(void**)obj = _pool.freeLists[index];
+    _pool.freeLists[index] = obj;
+}
+
+static size_t PoolFootprint() { return _pool.chunkBytes + _pool.largeBytes; }
+
+static void PoolShutdown()
+{
+    for (void* chunk : _pool.chunks)
+        (free)(chunk);
+    PoolInit();
+}
+
+// Bump arena: a free only decrements the live count. The arena is rewound when
+// nothing is live, like a per level or per frame arena.
+static OgeVirtualArena _arena;
+static size_t _arenaLive;
+
+static void ArenaInit()
+{
+    OgeArenaCreate(&_arena, REPLAY_ARENA_RESERVE);
+    _arenaLive = 0;
+}
+
+static void* ArenaAlloc(size_t size)
+{
+    void* obj = OgeArenaPush(&_arena, size > 0 ? size : 1, OGE_MEMORY_ALIGNMENT);
+    if (obj != NULL)
+        _arenaLive++;
+    return obj;
+}
+
+static void ArenaFree(void* obj, size_t size)
+{
+    (void)size;
+    if (obj != NULL && --_arenaLive == 0)
+        OgeArenaSetUsed(&_arena, 0); // the pages stay committed
+}
+
+static size_t ArenaFootprint() { return _arena.committed; }
+static void ArenaShutdown() { OgeArenaDestroy(&_arena); }
+
+static void NoInit() {}
+static void NoShutdown() {}
+
+static const ReplayBackend _backends[] = {
+    { "libc",  NoInit,    LibcAlloc,  LibcFree,   NULL,           NoShutdown },
+    { "oge",   NoInit,    OgeAlloc,   OgeRelease, NULL,           NoShutdown },
+    { "pool",  PoolInit,  PoolAlloc,  PoolFree,   PoolFootprint,  PoolShutdown },
+    { "arena", ArenaInit, ArenaAlloc, ArenaFree,  ArenaFootprint, ArenaShutdown },
+};
+
+//--------------- Replay ---------------------
+
+typedef struct ReplayResult ReplayResult;
+
+struct ReplayResult
+{
+    const char* backend;
+    u64 ops;
+    u64 failures;       // allocations that returned NULL
+    double seconds;     // sum of the frame times
+    double opsPerSecond;
+    u64 peakLiveBytes;  // requested bytes
+    u64 peakFootprint;  // bytes taken by the back end, or RSS growth
+    double fragmentation; // 1 - peakLiveBytes / peakFootprint, -1 if unknown
+    size_t peakRss;
+    double frameP50, frameP99, frameMax; // us
+};
+
+inline u64 ReplayNow()
+{
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Resident set size of the process
+static size_t ReplayRss()
+{
+#if defined(_MSC_VER)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+#elif defined(__linux__)
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file == NULL)
+        return 0;
+    char line[256];
+    size_t rss = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long long kb;
+        if (sscanf(line, "VmRSS: %llu kB", &kb) == 1) {
+            rss = (size_t)kb * 1024;
+            break;
+        }
+    }
+    fclose(file);
+    return rss;
+#endif
+    return 0;
+}
+
+static double ReplayPercentile(std::vector<double>& values, double percentile)
+{
+    if (values.empty())
+        return 0;
+    size_t n = (size_t)(percentile * (double)(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+// Write one byte per page like a program filling its buffers: the RSS then
+// shows what the back end really maps.
+inline void ReplayTouch(void* obj, size_t size)
+{
+    char* c = (char*)obj;
+    for (size_t i = 0; i < size; i += REPLAY_PAGE_SIZE)
+        c[i] = 1;
+}
+
+static ReplayResult ReplayRun(const ReplayTrace* trace, const ReplayBackend* backend, bool touch)
+{
+    std::vector<void*> slots(trace->slotCount, (void*)NULL);
+    std::vector<u64> sizes(trace->slotCount, 0);
+    std::vector<double> frameTimes;
+    frameTimes.reserve(trace->frameCount);
+
+    ReplayResult result;
+    memset(&result, 0, sizeof(result));
+    result.backend = backend->name;
+    result.ops = trace->ops.size();
+
+    backend->init();
+    size_t baseRss = ReplayRss();
+    size_t peakRss = baseRss;
+    u64 live = 0;
+    u64 peakFootprint = 0;
+    u64 total = 0;
+
+    size_t sampleStride = trace->ops.size() / REPLAY_RSS_SAMPLES + 1;
+    size_t lastSample = 0;
+    size_t i = 0;
+    while (i < trace->ops.size()) {
+        u32 frame = trace->ops[i].frame;
+        size_t frameEnd = i;
+        while (frameEnd < trace->ops.size() && trace->ops[frameEnd].frame == frame)
+            frameEnd++;
+
+        u64 start = ReplayNow();
+        for (; i < frameEnd; i++) {
+            const ReplayOp* op = &trace->ops[i];
+            if (op->kind == REPLAY_ALLOC) {
+                void* obj = backend->allocFn((size_t)op->size);
+                if (obj == NULL)
+                    result.failures++;
+                else if (touch)
+                    ReplayTouch(obj, (size_t)op->size);
+                slots[op->slot] = obj;
+                sizes[op->slot] = op->size;
+                live += op->size;
+                if (live > result.peakLiveBytes)
+                    result.peakLiveBytes = live;
+            }
+            else {
+                backend->freeFn(slots[op->slot], (size_t)op->size);
+                slots[op->slot] = NULL;
+                live -= op->size;
+            }
+        }
+        u64 end = ReplayNow();
+        total += end - start;
+        frameTimes.push_back((double)(end - start) * 1e-3);
+
+        // Outside of the timing
+        if (backend->footprint != NULL) {
+            u64 bytes = backend->footprint();
+            if (bytes > peakFootprint)
+                peakFootprint = bytes;
+        }
+        if (i - lastSample >= sampleStride || i == trace->ops.size()) {
+            size_t rss = ReplayRss();
+            if (rss > peakRss)
+                peakRss = rss;
+            lastSample = i;
+        }
+    }
+
+    // The blocks still live at the end of the trace
+    for (u32 s = 0; s < trace->slotCount; s++)
+        if (slots[s] != NULL)
+            backend->freeFn(slots[s], (size_t)sizes[s]);
+    backend->shutdown();
+
+    if (backend->footprint == NULL)
+        peakFootprint = peakRss > baseRss ? peakRss - baseRss : 0;
+
+    result.seconds = (double)total * 1e-9;
+    result.opsPerSecond = result.seconds > 0 ? (double)result.ops / result.seconds : 0;
+    result.peakFootprint = peakFootprint;
+    // The RSS doesn't grow when the heap reuses the memory of a previous run: unknown
+    result.fragmentation = peakFootprint >= result.peakLiveBytes && peakFootprint > 0 ? 1.0 - (double)result.peakLiveBytes / (double)peakFootprint : -1;
+    result.peakRss = peakRss;
+    result.frameP50 = ReplayPercentile(frameTimes, 0.50);
+    result.frameP99 = ReplayPercentile(frameTimes, 0.99);
+    result.frameMax = frameTimes.empty() ? 0 : *std::max_element(frameTimes.begin(), frameTimes.end());
+    return result;
+}
+
+static void ReplayWriteJson(const char* filename, const char* traceFile, const ReplayTrace* trace, const std::vector<ReplayResult>& results)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Can't write %s\n", filename);
+        return;
+    }
+
+    fprintf(file, "{\n  \"trace\": {\"file\": \"%s\", \"ops\": %llu, \"frames\": %u, \"max_live_blocks\": %u, \"ignored\": %llu, \"unknown_frees\": %llu, \"double_adds\": %llu, \"leaked\": %llu},\n",
+        traceFile, (unsigned long long)trace->ops.size(), trace->frameCount, trace->slotCount,
+        (unsigned long long)trace->ignored, (unsigned long long)trace->unknownFrees,
+        (unsigned long long)trace->doubleAdds, (unsigned long long)trace->leaked);
+    fprintf(file, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const ReplayResult* r = &results[i];
+        fprintf(file, "    {\"backend\": \"%s\", \"ops\": %llu, \"failures\": %llu, \"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+            "\"peak_live_bytes\": %llu, \"peak_footprint_bytes\": %llu, \"fragmentation\": %.4f, \"peak_rss_bytes\": %llu, "
+            "\"frame_p50_us\": %.3f, \"frame_p99_us\": %.3f, \"frame_max_us\": %.3f}%s\n",
+            r->backend, (unsigned long long)r->ops, (unsigned long long)r->failures, r->seconds, r->opsPerSecond,
+            (unsigned long long)r->peakLiveBytes, (unsigned long long)r->peakFootprint, r->fragmentation,
+            (unsigned long long)r->peakRss, r->frameP50, r->frameP99, r->frameMax,
+            i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+static void ReplayUsage()
+{
+    printf("Usage: TraceReplay TRACE [--backend NAME] [--allocator N] [--repeat N] [--no-touch] [--frag] [--save FILE] [--json FILE]\n");
+    printf("  TRACE            JSON heap log or binary trace (see --save)\n");
+    printf("  --backend NAME   libc, oge, pool or arena (default: all)\n");
+    printf("  --allocator N    only replay the records of this allocator id\n");
+    printf("  --repeat N       replay N times per back end and keep the fastest (default: 1)\n");
+    printf("  --no-touch       don't write in the allocated blocks\n");
+    printf("  --frag           fragmentation of the logged heap at the end of the trace\n");
+    printf("  --save FILE      write the mem records as a binary trace, faster to load\n");
+    printf("  --json FILE      machine readable summary (default: trace_replay.json)\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* traceFile = NULL;
+    const char* backendName = NULL;
+    const char* saveFile = NULL;
+    const char* jsonFile = "trace_replay.json";
+    int allocator = -1;
+    int repeat = 1;
+    bool touch = true;
+    bool fragReport = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+            backendName = argv[++i];
+        else if (strcmp(argv[i], "--allocator") == 0 && i + 1 < argc)
+            allocator = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-touch") == 0)
+            touch = false;
+        else if (strcmp(argv[i], "--frag") == 0)
+            fragReport = true;
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+            saveFile = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonFile = argv[++i];
+        else if (argv[i][0] != '-' && traceFile == NULL)
+            traceFile = argv[i];
+        else {
+            ReplayUsage();
+            return 1;
+        }
+    }
+    if (traceFile == NULL) {
+        ReplayUsage();
+        return 1;
+    }
+    repeat = repeat < 1 ? 1 : repeat;
+
+    OgeTrace trace;
+    u64 loadStart = ReplayNow();
+    if (!OgeTraceLoad(&trace, traceFile)) {
+        printf("Can't load %s\n", traceFile);
+        return 1;
+    }
+    printf("Loaded %llu mem records from %s in %.3f s\n", (unsigned long long)trace.count, traceFile,
+        (double)(ReplayNow() - loadStart) * 1e-9);
+
+    if (saveFile != NULL) {
+        if (OgeTraceSave(&trace, saveFile))
+            printf("Binary trace written to %s\n", saveFile);
+        else
+            printf("Can't write %s\n", saveFile);
+    }
+
+    // Fragmentation of the heap that wrote the log, at the end of the trace
+    if (fragReport) {
+        OgeHeapSnapshot* snapshot = OgeTraceSnapshot(&trace, 0xFFFFFFFF);
+        OgeFragmentation* frag = (OgeFragmentation*)malloc(sizeof(OgeFragmentation));
+        for (int a = 0; snapshot != NULL && frag != NULL && a < OGE_MEMORY_MAX_ALLOCATORS; a++) {
+            if ((allocator < 0 || allocator == a) && OgeFragmentationCompute(snapshot, (u16)a, frag))
+                OgeFragmentationReport(frag, NULL);
+        }
+        free(frag);
+        OgeTraceSnapshotFree(snapshot);
+    }
+
+    ReplayTrace replay;
+    ReplayPrepare(&trace, allocator, &replay);
+    OgeTraceFree(&trace);
+    printf("%llu ops in %u frames, max %u live blocks (ignored %llu, unknown frees %llu, double adds %llu, leaked %llu)\n",
+        (unsigned long long)replay.ops.size(), replay.frameCount, replay.slotCount,
+        (unsigned long long)replay.ignored, (unsigned long long)replay.unknownFrees,
+        (unsigned long long)replay.doubleAdds, (unsigned long long)replay.leaked);
+
+    printf("%-6s %14s %12s %12s %7s %10s %12s %12s %12s\n",
+        "back", "ops/s", "live MB", "footprint MB", "frag", "rss MB", "frame p50 us", "frame p99 us", "frame max us");
+
+    std::vector<ReplayResult> results;
+    for (const ReplayBackend& backend : _backends) {
+        if (backendName != NULL && strcmp(backendName, backend.name) != 0)
+            continue;
+
+        ReplayResult best;
+        for (int r = 0; r < repeat; r++) {
+            ReplayResult result = ReplayRun(&replay, &backend, touch);
+            if (r == 0 || result.seconds < best.seconds)
+                best = result;
+        }
+        printf("%-6s %14.0f %12.1f %12.1f %7.3f %10.1f %12.1f %12.1f %12.1f\n",
+            best.backend, best.opsPerSecond, (double)best.peakLiveBytes / (1024.0 * 1024.0),
+            (double)best.peakFootprint / (1024.0 * 1024.0), best.fragmentation,
+            (double)best.peakRss / (1024.0 * 1024.0), best.frameP50, best.frameP99, best.frameMax);
+        if (best.failures > 0)
+            printf("       %llu allocations failed\n", (unsigned long long)best.failures);
+        results.push_back(best);
+    }
+
+    ReplayWriteJson(jsonFile, traceFile, &replay, results);
+    printf("Summary written to %s\n", jsonFile);
+    return 0;
+}